@@ -33,6 +33,8 @@ This version is for pigpio version 57+
 #include <string.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
 #include <ctype.h>
 
 #include "pigpio.h"
@@ -42,6 +44,8 @@ cmdInfo_t cmdInfo[]=
 {
    /* num          str    vfyt retv */
 
+   {PI_CMD_BATCH, "BATCH", 101, 10}, // batch_command, pigs only
+
    {PI_CMD_BC1,   "BC1",   111, 1}, // gpioWrite_Bits_0_31_Clear
    {PI_CMD_BC2,   "BC2",   111, 1}, // gpioWrite_Bits_32_53_Clear
 
@@ -68,6 +72,7 @@ cmdInfo_t cmdInfo[]=
    {PI_CMD_CSI,   "CSI",   111, 1}, // gpioCfgSetInternals
 
    {PI_CMD_EVM,   "EVM",   122, 1}, // eventMonitor
+   {PI_CMD_EVP,   "EVP",   135, 0}, // eventSetPattern
    {PI_CMD_EVT,   "EVT",   112, 0}, // eventTrigger
 
    {PI_CMD_FC,    "FC",    112, 0}, // fileClose
@@ -117,6 +122,8 @@ cmdInfo_t cmdInfo[]=
 
    {PI_CMD_I2CZ,  "I2CZ",  193, 6}, // i2cZip
 
+   {PI_CMD_LH,    "LH",    121, 9}, // gpioGetLatency
+
    {PI_CMD_MICS,  "MICS",  112, 0}, // gpioDelay
    {PI_CMD_MILS,  "MILS",  112, 0}, // gpioDelay
 
@@ -128,7 +135,12 @@ cmdInfo_t cmdInfo[]=
 
    {PI_CMD_NB,    "NB",    122, 0}, // gpioNotifyBegin
    {PI_CMD_NC,    "NC",    112, 0}, // gpioNotifyClose
+   {PI_CMD_NE,    "NE",    121, 0}, // gpioNotifyEncoding
+   {PI_CMD_NED,   "NED",   133, 0}, // gpioNotifyEdges
+   {PI_CMD_NG,    "NG",    121, 0}, // gpioNotifyGlitch
+   {PI_CMD_NL,    "NL",    121, 0}, // gpioNotifyLatency
    {PI_CMD_NO,    "NO",    101, 2}, // gpioNotifyOpen
+   {PI_CMD_NOS,   "NOS",   112, 2}, // gpioNotifyOpenShm
    {PI_CMD_NP,    "NP",    112, 0}, // gpioNotifyPause
 
    {PI_CMD_PADG,  "PADG",  112, 2}, // gpioGetPad
@@ -261,6 +273,8 @@ cmdInfo_t cmdInfo[]=
 
 
 char * cmdUsage = "\n\
+BATCH ...        Run the commands which follow as one batch\n\
+\n\
 BC1 bits         Clear GPIO in bank 1\n\
 BC2 bits         Clear GPIO in bank 2\n\
 BI2CC sda        Close bit bang I2C\n\
@@ -286,6 +300,7 @@ CGI              Configuration get internals\n\
 CSI v            Configuration set internals\n\
 \n\
 EVM h bits       Set events to monitor\n\
+EVP n mask pat   Set event level pattern\n\
 EVT n            Trigger event\n\
 \n\
 FC h             Close file handle\n\
@@ -324,6 +339,8 @@ I2CWS h b        SMBus Write Byte: write byte\n\
 I2CWW h r word   SMBus Write Word Data: write word to register\n\
 I2CZ  h ...      I2C multiple transactions\n\
 \n\
+LH type reset    Get latency histogram\n\
+\n\
 M/MODES g mode   Set GPIO mode\n\
 MG/MODEG g       Get GPIO mode\n\
 MICS n           Delay for microseconds\n\
@@ -331,7 +348,12 @@ MILS n           Delay for milliseconds\n\
 \n\
 NB h bits        Start notification\n\
 NC h             Close notification\n\
+NE h enc         Set notification encoding\n\
+NED h bits edge  Set notification edges\n\
+NG h stdy        Set notification glitch filter\n\
+NL h us          Set notification latency\n\
 NO               Request a notification\n\
+NOS n            Request a shared memory notification\n\
 NP h             Pause notification\n\
 \n\
 P/PWM g v        Set GPIO PWM value\n\
@@ -560,60 +582,146 @@ static errInfo_t errInfo[]=
    {PI_BAD_SPI_BAUD     , "bad SPI baud rate, not 50-500k"},
    {PI_NOT_SPI_GPIO     , "no bit bang SPI in progress on GPIO"},
    {PI_BAD_EVENT_ID     , "bad event id"},
+   {PI_BAD_ALERT_CFG    , "bad alert dispatch threads or ring size"},
+   {PI_BAD_PATTERN      , "bad pattern, bits outside mask"},
+   {PI_BAD_LATENCY      , "bad latency, not 0 or 100-1000000"},
+   {PI_BAD_SOCK_CFG     , "bad socket worker threads or connections"},
+   {PI_BAD_BATCH        , "bad batch, overrun or nested command"},
+   {PI_BAD_SOCK_PATH    , "bad socket path or group"},
+   {PI_BAD_LATENCY_TYPE , "bad latency histogram type"},
 
 };
 
 static char * fmtMdeStr="RW540123";
 static char * fmtPudStr="ODU";
 
-static int cmdMatch(char *str)
+/* command names hashed case insensitively, the slot holds the
+   cmdInfo index plus 1, 0 if empty */
+
+#define CMD_HASH_SIZE 512
+
+static int16_t cmdHash[CMD_HASH_SIZE];
+
+static unsigned cmdHashStr(char *str)
+{
+   unsigned h = 2166136261u;
+
+   while (*str) h = (h ^ toupper((unsigned char)*str++)) * 16777619u;
+
+   return h & (CMD_HASH_SIZE - 1);
+}
+
+/* built as the program or library loads, before any thread can
+   parse a command */
+
+static void __attribute__((constructor)) cmdHashInit(void)
 {
    int i;
+   unsigned h;
 
    for (i=0; i<(sizeof(cmdInfo)/sizeof(cmdInfo_t)); i++)
    {
-      if (strcasecmp(str, cmdInfo[i].name) == 0) return i;
+      h = cmdHashStr(cmdInfo[i].name);
+
+      while (cmdHash[h])
+      {
+         /* the first entry of a name is the one matched */
+
+         if (strcasecmp(cmdInfo[i].name, cmdInfo[cmdHash[h]-1].name) == 0)
+            break;
+
+         h = (h + 1) & (CMD_HASH_SIZE - 1);
+      }
+
+      if (!cmdHash[h]) cmdHash[h] = i + 1;
+   }
+}
+
+static int cmdMatch(char *str)
+{
+   unsigned h;
+
+   h = cmdHashStr(str);
+
+   while (cmdHash[h])
+   {
+      if (strcasecmp(str, cmdInfo[cmdHash[h]-1].name) == 0)
+         return cmdHash[h] - 1;
+
+      h = (h + 1) & (CMD_HASH_SIZE - 1);
    }
+
    return CMD_UNKNOWN_CMD;
 }
 
 static int getNum(char *str, uint32_t *val, int8_t *opt)
 {
-   int f, n;
+   char *s, *e;
+   int type;
    intmax_t v;
 
+   /* one pass equivalent of sscanf " %ji %n", " v%ji %n"
+      and " p%ji %n" */
+
    *opt = 0;
 
-   f = sscanf(str, " %ji %n", &v, &n);
+   s = str;
 
-   if (f == 1)
-   {
-      *val = v;
-      *opt = CMD_NUMERIC;
-      return n;
-   }
+   while (isspace((unsigned char)*s)) s++;
 
-   f = sscanf(str, " v%ji %n", &v, &n);
+   type = CMD_NUMERIC;
 
-   if (f == 1)
-   {
-      *val = v;
-      if (v < PI_MAX_SCRIPT_VARS) *opt = CMD_VAR;
-      else *opt = -CMD_VAR;
-      return n;
-   }
+   if      (*s == 'v') {type = CMD_VAR; s++;}
+   else if (*s == 'p') {type = CMD_PAR; s++;}
+
+   v = strtoimax(s, &e, 0);
+
+   if (e == s) return 0;
 
-   f = sscanf(str, " p%ji %n", &v, &n);
+   while (isspace((unsigned char)*e)) e++;
 
-   if (f == 1)
+   *val = v;
+
+   switch (type)
    {
-      *val = v;
-      if (v < PI_MAX_SCRIPT_PARAMS) *opt = CMD_PAR;
-      else *opt = -CMD_PAR;
-      return n;
+      case CMD_VAR:
+         if (v < PI_MAX_SCRIPT_VARS) *opt = CMD_VAR;
+         else *opt = -CMD_VAR;
+         break;
+
+      case CMD_PAR:
+         if (v < PI_MAX_SCRIPT_PARAMS) *opt = CMD_PAR;
+         else *opt = -CMD_PAR;
+         break;
+
+      default:
+         *opt = CMD_NUMERIC;
    }
 
-   return 0;
+   return e - str;
+}
+
+static int getWord(char *str, char *word, int size)
+{
+   char *s;
+   int n;
+
+   /* as sscanf " %<size-1>s %n" but an empty word if there is none */
+
+   s = str;
+
+   while (isspace((unsigned char)*s)) s++;
+
+   n = 0;
+
+   while (*s && !isspace((unsigned char)*s) && (n < (size-1)))
+      word[n++] = *s++;
+
+   word[n] = 0;
+
+   while (isspace((unsigned char)*s)) s++;
+
+   return s - str;
 }
 
 static char intCmdStr[32];
@@ -639,7 +747,7 @@ int cmdParse(
 
    bzero(&ctl->opt, sizeof(ctl->opt));
 
-   sscanf(buf+ctl->eaten, " %31s %n", intCmdStr, &pp);
+   pp = getWord(buf+ctl->eaten, intCmdStr, sizeof(intCmdStr));
 
    ctl->eaten += pp;
 
@@ -658,7 +766,7 @@ int cmdParse(
 
    switch (cmdInfo[idx].vt)
    {
-      case 101: /* BR1  BR2  CGI  H  HELP  HWVER
+      case 101: /* BATCH  BR1  BR2  CGI  H  HELP  HWVER
                    DCRA  HALT  INRA  NO
                    PIGPV  POPA  PUSHA  RET  T  TICK  WVBSY  WVCLR
                    WVCRE  WVGO  WVGOR  WVHLT  WVNEW
@@ -682,7 +790,7 @@ int cmdParse(
          break;
 
       case 112: /* BI2CC FC  GDC  GPW  I2CC  I2CRB
-                   MG  MICS  MILS  MODEG  NC  NP  PADG PFG  PRG
+                   MG  MICS  MILS  MODEG  NC  NOS  NP  PADG PFG  PRG
                    PROCD  PROCP  PROCS  PRRG  R  READ  SLRC  SPIC
                    WVDEL  WVSC  WVSM  WVSP  WVTX  WVTXR  BSPIC
 
@@ -742,7 +850,7 @@ int cmdParse(
 
       case 121: /* HC  FR  I2CRD  I2CRR  I2CRW  I2CWB I2CWQ  P
                    PADS  PFS  PRS  PWM  S  SERVO  SLR  SLRI  W
-                   WDOG  WRITE  WVTXM
+                   WDOG  WRITE  WVTXM  NE  NG  NL  LH
 
                    Two positive parameters.
                 */
@@ -925,7 +1033,7 @@ int cmdParse(
 
          break;
 
-      case 133: /* FS
+      case 133: /* FS  NED
 
                    Three parameters.  First and third positive.
                    Second may be negative when interpreted as an int.
@@ -975,6 +1083,25 @@ int cmdParse(
 
          break;
 
+      case 135: /* EVP
+
+                   Three parameters.  First positive.
+                   Second and third any value.
+                */
+         ctl->eaten += getNum(buf+ctl->eaten, &p[1], &ctl->opt[1]);
+         ctl->eaten += getNum(buf+ctl->eaten, &p[2], &ctl->opt[2]);
+         ctl->eaten += getNum(buf+ctl->eaten, &tp1, &to1);
+
+         if ((ctl->opt[1] > 0) && ((int)p[1] >= 0) &&
+             (ctl->opt[2] > 0) && (to1 == CMD_NUMERIC))
+         {
+            p[3] = 4;
+            memcpy(ext, &tp1, 4);
+            valid = 1;
+         }
+
+         break;
+
       case 191: /* PROCR
 
                    One to 11 parameters, first positive,
@@ -1401,3 +1528,177 @@ int cmdParseScript(char *script, cmdScript_t *s, int diags)
    return status;
 }
 
+
+static int putVarint(uint8_t *buf, uint32_t v)
+{
+   int n = 0;
+
+   while (v >= 0x80)
+   {
+      buf[n++] = (v & 0x7F) | 0x80;
+      v >>= 7;
+   }
+
+   buf[n++] = v;
+
+   return n;
+}
+
+static int getVarint(const uint8_t *buf, int len, uint32_t *v)
+{
+   int n;
+   uint32_t r = 0;
+
+   for (n=0; n<5; n++)
+   {
+      if (n >= len) return 0;
+
+      r |= (uint32_t)(buf[n] & 0x7F) << (7*n);
+
+      if (!(buf[n] & 0x80))
+      {
+         *v = r;
+         return n+1;
+      }
+   }
+
+   return -1;
+}
+
+static void put16(uint8_t *buf, uint16_t v)
+{
+   buf[0] = v;
+   buf[1] = v >> 8;
+}
+
+static void put32(uint8_t *buf, uint32_t v)
+{
+   buf[0] = v;
+   buf[1] = v >> 8;
+   buf[2] = v >> 16;
+   buf[3] = v >> 24;
+}
+
+static uint16_t get16(const uint8_t *buf)
+{
+   return buf[0] | (buf[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *buf)
+{
+   return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+int cmdNotifyEncode(cmdNotifyCodec_t *c, const gpioReport_t *r, uint8_t *buf)
+{
+   uint32_t changed;
+   int n;
+
+   if ((c->count < 0) || (c->count >= CMD_NOTIFY_KEYFRAME) ||
+       (r->seqno != (uint16_t)(c->seqno + 1)))
+   {
+      buf[0] = PI_NTFY_DELTA_KEY;
+      put16(buf+1, r->seqno);
+      put16(buf+3, r->flags);
+      put32(buf+5, r->tick);
+      put32(buf+9, r->level);
+
+      n = 13;
+
+      c->count = 0;
+   }
+   else
+   {
+      changed = r->level ^ c->level;
+
+      n = 1;
+
+      if (r->flags)
+      {
+         buf[0] = PI_NTFY_DELTA_FLAGS;
+         put16(buf+n, r->flags);
+         n += 2;
+      }
+      else buf[0] = 0;
+
+      if (changed && !(changed & (changed - 1)))
+      {
+         buf[0] |= __builtin_ctz(changed);
+      }
+      else
+      {
+         buf[0] |= PI_NTFY_DELTA_LEVEL;
+         n += putVarint(buf+n, changed);
+      }
+
+      n += putVarint(buf+n, r->tick - c->tick);
+
+      c->count++;
+   }
+
+   c->seqno = r->seqno;
+   c->tick  = r->tick;
+   c->level = r->level;
+
+   return n;
+}
+
+int cmdNotifyDecode(
+   cmdNotifyCodec_t *c, const uint8_t *buf, int len, gpioReport_t *r)
+{
+   uint32_t changed, delta;
+   int n, v;
+
+   if (len < 1) return 0;
+
+   if (buf[0] & PI_NTFY_DELTA_KEY)
+   {
+      if (len < 13) return 0;
+
+      c->seqno = get16(buf+1);
+      r->flags = get16(buf+3);
+      c->tick  = get32(buf+5);
+      c->level = get32(buf+9);
+      c->count = 0;
+
+      n = 13;
+   }
+   else
+   {
+      if (c->count < 0) return -1; /* no keyframe yet */
+
+      n = 1;
+
+      r->flags = 0;
+
+      if (buf[0] & PI_NTFY_DELTA_FLAGS)
+      {
+         if (len < 3) return 0;
+         r->flags = get16(buf+n);
+         n += 2;
+      }
+
+      if (buf[0] & PI_NTFY_DELTA_LEVEL)
+      {
+         v = getVarint(buf+n, len-n, &changed);
+         if (v <= 0) return v;
+         n += v;
+      }
+      else changed = 1 << (buf[0] & 0x1F);
+
+      v = getVarint(buf+n, len-n, &delta);
+      if (v <= 0) return v;
+      n += v;
+
+      c->seqno++;
+      c->tick  += delta;
+      c->level ^= changed;
+      c->count++;
+   }
+
+   r->seqno = c->seqno;
+   r->tick  = c->tick;
+   r->level = c->level;
+
+   return n;
+}
@@ -90,6 +90,17 @@ typedef struct
    int8_t opt[4];
 } cmdInstr_t;
 
+#define CMD_NOTIFY_KEYFRAME   256 /* delta records between keyframes */
+#define CMD_NOTIFY_MAX_RECORD 13  /* bytes in the longest delta record */
+
+typedef struct
+{
+   uint16_t seqno;
+   uint32_t tick;
+   uint32_t level;
+   int      count; /* records since the last keyframe, <0 if none yet */
+} cmdNotifyCodec_t;
+
 typedef struct
 {
    /*
@@ -118,5 +129,10 @@ char *cmdErrStr(int error);
 
 char *cmdStr(void);
 
+int cmdNotifyEncode(cmdNotifyCodec_t *c, const gpioReport_t *r, uint8_t *buf);
+
+int cmdNotifyDecode(
+   cmdNotifyCodec_t *c, const uint8_t *buf, int len, gpioReport_t *r);
+
 #endif
 
@@ -40,14 +40,19 @@ This version is for pigpio version 3+
 #include <fcntl.h>
 
 #include "pigpio.h"
+#include "command.h"
 
 /*
 This software converts pigpio notification reports
 into a VCD format understood by GTKWave.
+
+pig2vcd -d reads delta encoded reports (see gpioNotifyEncoding).
 */
 
 #define RS (sizeof(gpioReport_t))
 
+static int delta = 0;
+
 static char * timeStamp()
 {
    static char buf[32];
@@ -63,6 +68,41 @@ static char * timeStamp()
    return buf;
 }
 
+static int readReport(gpioReport_t *report)
+{
+   static uint8_t buf[4096];
+   static int got = 0, pos = 0;
+   static cmdNotifyCodec_t codec = {0, 0, 0, -1};
+   int r;
+
+   if (!delta) return (read(STDIN_FILENO, report, RS) == RS);
+
+   while (1)
+   {
+      r = cmdNotifyDecode(&codec, buf+pos, got-pos, report);
+
+      if (r > 0)
+      {
+         pos += r;
+         return 1;
+      }
+
+      if (r < 0) return 0;
+
+      /* incomplete record, read some more */
+
+      got -= pos;
+      memmove(buf, buf+pos, got);
+      pos = 0;
+
+      r = read(STDIN_FILENO, buf+got, sizeof(buf)-got);
+
+      if (r <= 0) return 0;
+
+      got += r;
+   }
+}
+
 int symbol(int bit)
 {
    if (bit < 26) return ('A' + bit);
@@ -71,15 +111,15 @@ int symbol(int bit)
 
 int main(int argc, char * argv[])
 {
-   int b, r, v;
+   int b, v;
    uint32_t t0;
    uint32_t lastLevel, changed;
 
    gpioReport_t report;
 
-   r=read(STDIN_FILENO, &report, RS);
+   if ((argc > 1) && (strcmp(argv[1], "-d") == 0)) delta = 1;
 
-   if (r != RS) exit(-1);
+   if (!readReport(&report)) exit(-1);
 
    printf("$date %s $end\n", timeStamp());
    printf("$version pig2vcd V1 $end\n");
@@ -95,7 +135,7 @@ int main(int argc, char * argv[])
    t0 = report.tick;
    lastLevel =0;
 
-   while ((r=read(STDIN_FILENO, &report, RS)) == RS)
+   while (readReport(&report))
    {
       if (report.level != lastLevel)
       {
@@ -49,17 +49,26 @@ For more information, please refer to <http://unlicense.org/>
 #include <sys/ioctl.h>
 #include <limits.h>
 #include <pthread.h>
+#include <semaphore.h>
 #include <sys/time.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/file.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <sys/select.h>
 #include <fnmatch.h>
 #include <glob.h>
+#include <pwd.h>
+#include <grp.h>
 
 #include "pigpio.h"
 
@@ -769,12 +778,35 @@ Assumes two counters per block.  Each counter 4 * 16 (16^4=65536)
 #define BPD 4
 
 #define MAX_REPORT 120
+
+#define SOCK_RX_BYTES (16 + CMD_MAX_EXTENSION)
+#define SOCK_TX_BYTES (16 * 256) /* response headers sent together */
+#define SOCK_MAX_WORKERS 64 /* most workers, the pool grows when all busy */
+#define SOCK_BACKOFF_MIN 10 /* ms to wait after running out of fds */
+#define SOCK_BACKOFF_MAX 1000
+
+#define FIFO_OUT_BYTES 16384
+
+/* script superinstructions, an instruction and the one after it */
+
+#define SCR_OP_W_MICS  1000
+#define SCR_OP_W_MILS  1001
+#define SCR_OP_R_JZ    1002
+#define SCR_OP_R_JNZ   1003
+#define SCR_OP_DCR_JNZ 1004
+#define SCR_OP_DCR_JP  1005
+#define SCR_OP_END     1006
+
+#define PI_LATENCY_TYPES 3
 #define MAX_SAMPLE 4000
 
 #define DEFAULT_PWM_IDX 5
 
 #define MAX_EMITS (PIPE_BUF / sizeof(gpioReport_t))
 
+#define NOTIFY_QUEUE_BYTES 65536 /* power of 2 */
+#define NOTIFY_STAMPS 1024 /* power of 2 */
+
 #define SRX_BUF_SIZE 8192
 
 #define PI_I2C_RETRIES 0x0701
@@ -914,27 +946,103 @@ typedef struct
 {
    callbk_t func;
    unsigned ex;
+   unsigned batch;
+   void *userdata;
+} alertFunc_t;
+
+typedef struct
+{
+   callbk_t func;
+   unsigned ex;
+   unsigned batch;
    void *userdata;
+   uint32_t seq; /* odd while func, ex, batch, and userdata change */
 
    int      wdSteadyUs;
    uint32_t wdTick;
    uint32_t wdLBitV;
 
-   int      nfSteadyUs;
-   int      nfActiveUs;
-   int      nfActive;
-   uint32_t nfTick1;
-   uint32_t nfTick2;
-   uint32_t nfLBitV;
-   uint32_t nfRBitV;
+   uint32_t dropped;
 
-   uint32_t gfSteadyUs;
-   uint32_t gfTick;
-   uint32_t gfLBitV;
-   uint32_t gfRBitV;
+   uint32_t latency; /* most us from a level change to its callback */
 
 } gpioAlert_t;
 
+typedef struct
+{
+   uint32_t head; /* written by the alert thread */
+   uint32_t tail; /* written by the dispatcher thread */
+   uint32_t *tick;
+   uint8_t  *level;
+} alertRing_t;
+
+typedef struct
+{
+   pthread_t pthId;
+   sem_t     sem;
+   uint32_t  bits; /* GPIO served */
+   int       patterns; /* also serves the pattern ring */
+   int       running;
+} alertDispatch_t;
+
+typedef struct
+{
+   int      fd;
+   char    *in;  /* partial command carried to the next read */
+   unsigned inLen;
+   char    *out; /* response the socket would not yet take */
+   unsigned outPos;
+   unsigned outLen;
+   time_t   opened;
+   uint32_t commands;
+   uint32_t rxBytes;
+   uint32_t txBytes;
+   uint32_t deferred;
+} sockConn_t;
+
+typedef struct
+{
+   pthread_t pthId;
+   int       running;
+} sockWorker_t;
+
+/*
+   Glitch filter state for all GPIO, kept as words plus per-GPIO arrays
+   so a sample costs a few word operations however many GPIO are
+   filtered.  Per-GPIO entries are only touched on an edge or when the
+   earliest steady deadline (nextTick) has passed.
+*/
+typedef struct
+{
+   uint32_t bits;      /* GPIO the alert thread is filtering */
+   uint32_t resetBits; /* GPIO (re)configured by gpioGlitchFilter */
+   uint32_t lLevel;    /* last seen level */
+   uint32_t rLevel;    /* last reported level */
+   uint32_t nextTick;  /* earliest deadline of a GPIO with lLevel!=rLevel */
+   uint32_t steadyUs[PI_MAX_USER_GPIO+1];
+   uint32_t setTick [PI_MAX_USER_GPIO+1];
+   uint32_t deadline[PI_MAX_USER_GPIO+1];
+} gpioGlitch_t;
+
+/*
+   Noise filter state, laid out like gpioGlitch_t.  A GPIO is either
+   waiting for its level to be steady (changes suppressed) or active
+   (changes reported until activeEnd).
+*/
+typedef struct
+{
+   uint32_t resetBits; /* GPIO (re)configured by gpioNoiseFilter */
+   uint32_t active;    /* GPIO currently reporting changes */
+   uint32_t lLevel;    /* last seen level */
+   uint32_t rLevel;    /* level reported while waiting */
+   uint32_t nextTick;  /* earliest activeEnd of an active GPIO */
+   int      steadyUs   [PI_MAX_USER_GPIO+1];
+   uint32_t activeUs   [PI_MAX_USER_GPIO+1];
+   uint32_t setTick    [PI_MAX_USER_GPIO+1];
+   uint32_t lastChange [PI_MAX_USER_GPIO+1];
+   uint32_t activeEnd  [PI_MAX_USER_GPIO+1];
+} gpioNoise_t;
+
 typedef struct
 {
    callbk_t func;
@@ -944,6 +1052,30 @@ typedef struct
    int fired;
 } eventAlert_t;
 
+typedef struct
+{
+   eventPatternFunc_t func;
+   void *userdata;
+} eventPattern_t;
+
+typedef struct
+{
+   uint32_t seq;    /* odd while being changed */
+   uint32_t events; /* events with a level pattern */
+   uint32_t bits;   /* GPIO in a level pattern */
+   uint32_t mask   [PI_MAX_EVENT+1];
+   uint32_t pattern[PI_MAX_EVENT+1];
+} eventPatternSet_t;
+
+typedef struct
+{
+   uint32_t head; /* written by the alert thread */
+   uint32_t tail; /* written by dispatcher 0 */
+   uint32_t *tick;
+   uint32_t *level;
+   uint8_t  *event;
+} patternRing_t;
+
 typedef struct
 {
    unsigned gpio;
@@ -983,6 +1115,18 @@ typedef struct
    pthread_t pthId;
 } gpioTimer_t;
 
+typedef struct scrOp_s
+{
+   void           *code;  /* handler, linked by the script thread */
+   int             kind;  /* command, or SCR_OP_ superinstruction */
+   int            *a1;    /* operand 1, a var, par, or k1         */
+   int            *a2;    /* operand 2, a var, par, or k2         */
+   int             k1;    /* numeric operand 1                    */
+   int             k2;    /* numeric operand 2                    */
+   struct scrOp_s *jump;  /* resolved jump target                 */
+   cmdInstr_t     *instr; /* source instruction                   */
+} scrOp_t;
+
 typedef struct
 {
    unsigned id;
@@ -996,6 +1140,7 @@ typedef struct
    pthread_mutex_t pthMutex;
    pthread_cond_t pthCond;
    cmdScript_t script;
+   scrOp_t *op;
 } gpioScript_t;
 
 
@@ -1005,6 +1150,12 @@ typedef struct
    uint16_t servoIdx;
 } clkCfg_t;
 
+typedef struct
+{
+   uint32_t end;  /* queue position after the report */
+   uint32_t tick; /* tick of the report */
+} notifyStamp_t;
+
 typedef struct
 {
    uint16_t seqno;
@@ -1014,7 +1165,30 @@ typedef struct
    uint32_t lastReportTick;
    int      fd;
    int      pipe;
+   int      closeFd; /* the notify thread closes a released socket */
    int      max_emits;
+   uint32_t qHead; /* bytes queued by the alert thread */
+   uint32_t qTail; /* bytes written by the notify thread */
+   uint32_t sHead; /* report stamps queued by the alert thread */
+   uint32_t sTail; /* report stamps counted by the notify thread */
+   uint32_t overflow;
+   gpioNotifyShm_t *shm; /* shared memory ring instead of fd */
+   size_t   shmLen;
+   uint32_t shmHead;     /* private copies, consumers can write the ring */
+   uint32_t shmSize;
+   int      efd;
+   int      encoding;
+   cmdNotifyCodec_t codec;
+   uint32_t risingBits;  /* GPIO reported on a rising edge */
+   uint32_t fallingBits; /* GPIO reported on a falling edge */
+   uint32_t steadyUs;    /* glitch filter, 0 for none */
+   uint32_t gReset;      /* set to restart the glitch filter */
+   uint32_t gBits;
+   uint32_t gLevel;      /* glitch filter last level */
+   uint32_t gReported;   /* glitch filter reported level */
+   uint32_t gNextTick;
+   uint32_t gDeadline[32];
+   uint32_t latency;     /* most us from a level change to its report */
 } gpioNotify_t;
 
 typedef struct
@@ -1050,6 +1224,7 @@ typedef struct
 typedef struct
 {
    uint32_t alertTicks;
+   uint32_t alertIdle;
    uint32_t lateTicks;
    uint32_t moreToDo;
    uint32_t diffTick[TICKSLOTS];
@@ -1064,6 +1239,14 @@ typedef struct
    uint32_t goodPipeWrite;
    uint32_t shortPipeWrite;
    uint32_t wouldBlockPipeWrite;
+   uint32_t alertDropped;
+   uint32_t notifyOverflow;
+   uint32_t sockAccepted;
+   uint32_t sockRejected;
+   uint32_t sockPeak;
+   uint32_t sockDeferred;
+   uint32_t sockPeakWorkers;
+   uint32_t latency[PI_LATENCY_TYPES][PI_LATENCY_BINS];
 } gpioStats_t;
 
 typedef struct
@@ -1083,6 +1266,11 @@ typedef struct
       0-3: dbgLevel
       4-7: alertFreq
       */
+   unsigned alertThreads;
+   unsigned alertRingSize;
+   unsigned sockThreads;
+   unsigned sockMaxConns;
+   int      sockGid;
 } gpioCfg_t;
 
 typedef struct
@@ -1211,6 +1399,8 @@ static uint32_t sockNetAddr[MAX_CONNECT_ADDRESSES];
 
 static int numSockNetAddr = 0;
 
+static char sockPath[PI_MAX_SOCKET_PATH+1] = PI_DEFAULT_SOCKET_PATH;
+
 static uint32_t reportedLevel = 0;
 
 static int waveClockInited = 0;
@@ -1249,6 +1439,7 @@ static int waveOutCount = 0;
 static uint32_t *waveEndPtr = NULL;
 
 static volatile uint32_t alertBits   = 0;
+static volatile uint32_t alertBatchBits = 0;
 static volatile uint32_t monitorBits = 0;
 static volatile uint32_t notifyBits  = 0;
 static volatile uint32_t scriptBits  = 0;
@@ -1258,15 +1449,53 @@ static volatile uint32_t wdogBits    = 0;
 
 static volatile uint32_t scriptEventBits  = 0;
 
+static volatile uint32_t patternBits   = 0; /* GPIO in a level pattern */
+static uint32_t          patternMatch  = 0; /* used by the alert thread */
+
 static volatile int runState = PI_STARTING;
 
 static int pthAlertRunning  = PI_THREAD_NONE;
 static int pthFifoRunning   = PI_THREAD_NONE;
 static int pthSocketRunning = PI_THREAD_NONE;
+static int pthNotifyRunning = PI_THREAD_NONE;
+
+static int notifyWakeFd = -1;
+static int notifySleeping = 0;
+
+static uint32_t notifyShmClosing = 0; /* shm handles for the alert thread
+                                         to unmap */
+
+static char notifyQueue[PI_NOTIFY_SLOTS][NOTIFY_QUEUE_BYTES];
+
+static notifyStamp_t notifyStamp[PI_NOTIFY_SLOTS][NOTIFY_STAMPS];
 
 static gpioAlert_t      gpioAlert  [PI_MAX_USER_GPIO+1];
 
+static gpioGlitch_t     gpioGlitch;
+
+/* edges collected for batch alert callbacks, +1 for a watchdog timeout */
+static int              alertBatchCount[PI_MAX_USER_GPIO+1];
+static uint32_t         alertBatchTick [PI_MAX_USER_GPIO+1][MAX_REPORT+1];
+static uint8_t          alertBatchLevel[PI_MAX_USER_GPIO+1][MAX_REPORT+1];
+
+static alertRing_t      alertRing[PI_MAX_USER_GPIO+1];
+static alertDispatch_t  alertDispatch[PI_MAX_ALERT_THREADS];
+static int              alertThreads = 0; /* dispatchers running */
+
+static sockWorker_t     sockWorker[SOCK_MAX_WORKERS];
+static int              sockConns = 0; /* connections open */
+static int              sockWorkers = 0; /* workers started */
+static int              sockIdle = 0; /* workers waiting for a command */
+static int              sockStopping = 0;
+static pthread_mutex_t  sockWorkerMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static gpioNoise_t      gpioNoise;
+
 static eventAlert_t     eventAlert [PI_MAX_EVENT+1];
+static eventPattern_t   eventPattern [PI_MAX_EVENT+1];
+static eventPatternSet_t patternSet;   /* written by eventSetPattern */
+static eventPatternSet_t patternLocal; /* alert thread copy of patternSet */
+static patternRing_t    patternRing;
 
 static gpioISR_t        gpioISR    [PI_MAX_GPIO+1];
 
@@ -1296,9 +1525,14 @@ static int pwmFreq[PWM_FREQS];
 static FILE * inpFifo = NULL;
 static FILE * outFifo = NULL;
 
+static char fifoOut[FIFO_OUT_BYTES];
+static int  fifoOutLen = 0;
+
 static int fdLock       = -1;
 static int fdMem        = -1;
 static int fdSock       = -1;
+static int fdSockUnix   = -1;
+static int sockEpfd     = -1;
 static int fdPmap       = -1;
 static int fdMbox       = -1;
 
@@ -1345,6 +1579,11 @@ static volatile gpioCfg_t gpioCfg =
    0, /* dbgLevel */
    0, /* alertFreq */
    0, /* internals */
+   PI_DEFAULT_ALERT_THREADS,
+   PI_DEFAULT_ALERT_RING,
+   PI_DEFAULT_SOCK_THREADS,
+   PI_DEFAULT_SOCK_CONNS,
+   PI_DEFAULT_SOCKET_GID,
 };
 
 /* no initialisation required */
@@ -1355,6 +1594,7 @@ static unsigned bufferCycles; /* number of cycles */
 static pthread_t pthAlert;
 static pthread_t pthFifo;
 static pthread_t pthSocket;
+static pthread_t pthNotify;
 
 static uint32_t spi_dummy;
 
@@ -1470,6 +1710,7 @@ static const uint16_t pwmRealRange[PWM_FREQS]=
 /* prototype ----------------------------------------------------- */
 
 static void intNotifyBits(void);
+static void notifyWake(void);
 
 static void intScriptBits(void);
 
@@ -1477,6 +1718,8 @@ static void intScriptEventBits(void);
 
 static int  gpioNotifyOpenInBand(int fd);
 
+static int myDoBatch(uint32_t *p, unsigned bufSize, char *buf);
+
 static void initHWClk
    (int clkCtl, int clkDiv, int clkSrc, int divI, int divF, int MASH);
 
@@ -1484,7 +1727,9 @@ static void initDMAgo(volatile uint32_t  *dmaAddr, uint32_t cbAddr);
 
 int gpioWaveTxStart(unsigned wave_mode); /* deprecated */
 
-static void closeOrphanedNotifications(int slot, int fd);
+static int closeOrphanedNotifications(int slot, int fd, int release);
+
+static void notifyMutex(int lock);
 
 
 /* ======================================================================= */
@@ -1855,6 +2100,8 @@ static int myDoCommand(uint32_t *p, unsigned bufSize, char *buf)
          }
          break;
 
+      case PI_CMD_BATCH: res = myDoBatch(p, bufSize, buf); break;
+
       case PI_CMD_BC2:
          mask = gpioMask>>32;
 
@@ -2001,6 +2248,11 @@ static int myDoCommand(uint32_t *p, unsigned bufSize, char *buf)
 
       case PI_CMD_EVT: res = eventTrigger(p[1]); break;
 
+      case PI_CMD_EVP:
+         memcpy(&p[4], buf, 4);
+         res = eventSetPattern(p[1], p[2], p[4]);
+         break;
+
       case PI_CMD_FC: res = fileClose(p[1]); break;
 
       case PI_CMD_FG:
@@ -2167,6 +2419,24 @@ static int myDoCommand(uint32_t *p, unsigned bufSize, char *buf)
 
       case PI_CMD_NO: res = gpioNotifyOpen();  break;
 
+      case PI_CMD_NOS: res = gpioNotifyOpenShm(p[1]);  break;
+
+      case PI_CMD_NE: res = gpioNotifyEncoding(p[1], p[2]); break;
+
+      case PI_CMD_NED:
+         memcpy(&p[4], buf, 4);
+         res = gpioNotifyEdges(p[1], p[2], p[4]);
+         break;
+
+      case PI_CMD_NG: res = gpioNotifyGlitch(p[1], p[2]); break;
+
+      case PI_CMD_NL: res = gpioNotifyLatency(p[1], p[2]); break;
+
+      case PI_CMD_LH:
+         res = gpioGetLatency(p[1], p[2], (uint32_t *)buf);
+         if (res > 0) res *= 4;
+         break;
+
       case PI_CMD_NP: res = gpioNotifyPause(p[1]); break;
 
       case PI_CMD_PADG: res = gpioGetPad(p[1]); break;
@@ -2465,6 +2735,61 @@ static int myDoCommand(uint32_t *p, unsigned bufSize, char *buf)
 
 /* ----------------------------------------------------------------------- */
 
+static int myDoBatch(uint32_t *p, unsigned bufSize, char *buf)
+{
+   uint32_t q[10];
+   unsigned pos, count;
+   int res;
+   char *ext;
+
+   /* buf holds p[3] bytes of commands, each a cmdCmd_t followed by
+      its own extension.  Check them all before running any. */
+
+   for (pos=0; pos<p[3]; pos+=16+q[3])
+   {
+      if ((p[3] - pos) < 16) return PI_BAD_BATCH;
+
+      memcpy(q, buf+pos, 16);
+
+      if ((q[3] >= CMD_MAX_EXTENSION) || ((p[3] - pos - 16) < q[3]))
+         return PI_BAD_BATCH;
+
+      if ((q[0] == PI_CMD_BATCH) || (q[0] == PI_CMD_NOIB))
+         return PI_BAD_BATCH;
+   }
+
+   ext = malloc(CMD_MAX_EXTENSION);
+
+   if (ext == NULL) return PI_NO_MEMORY;
+
+   /* each result is packed over the front of buf, 4 bytes for a
+      command of at least 16, so never overtakes the next command */
+
+   count = 0;
+
+   for (pos=0; pos<p[3]; pos+=16+q[3])
+   {
+      memcpy(q, buf+pos, 16);
+      memcpy(ext, buf+pos+16, q[3]);
+
+      /* add null terminator in case it's a string */
+
+      ext[q[3]] = 0;
+
+      res = myDoCommand(q, CMD_MAX_EXTENSION-1, ext);
+
+      memcpy(buf+(4*count), &res, 4);
+
+      count++;
+   }
+
+   free(ext);
+
+   return 4 * count;
+}
+
+/* ----------------------------------------------------------------------- */
+
 static void mySetGpioOff(unsigned gpio, int pos)
 {
    int page, slot;
@@ -5563,1210 +5888,3420 @@ unsigned alert_delays[]=
    400000, 450000, 514285, 600000, 720000, 900000, 1200000, 1800000
 };
 
+/*
+The delay above is used while level changes are flowing.  It doubles
+for each pass without a level change of a monitored GPIO, up to
+ALERT_MAX_BACKOFF times, and is never more than the smallest latency
+asked for by an alert or notification.
+*/
+
+#define ALERT_MAX_BACKOFF 8
+
 /* ======================================================================= */
 
 static void alertGlitchFilter(gpioSample_t *sample, int numSamples)
 {
-   int i, j, diff;
-   uint32_t steadyUs, changedTick, RBitV, LBitV;
-   uint32_t bit, bitV;
-
-   for (i=0; i<=PI_MAX_USER_GPIO; i++)
-   {
-      bit = (1<<i);
-
-      if (monitorBits & bit & gFilterBits)
-      {
-         steadyUs    = gpioAlert[i].gfSteadyUs;
-         RBitV       = gpioAlert[i].gfRBitV;
-         LBitV       = gpioAlert[i].gfLBitV;
-         changedTick = gpioAlert[i].gfTick;
+   int j, b;
+   uint32_t bits, newBits, todo;
+   uint32_t lLevel, rLevel, level, changes, pending;
+   uint32_t tick, nextTick;
 
-         for (j=0; j<numSamples; j++)
-         {
-            bitV = sample[j].level & bit;
+   bits = monitorBits & gFilterBits;
 
-            if (bitV != LBitV)
-            {
-               /* Difference between level and last level.
-                  Restart steady timer. */
+   newBits = (bits & ~gpioGlitch.bits) |
+             (__sync_fetch_and_and(&gpioGlitch.resetBits, 0) & bits);
 
-               changedTick = sample[j].tick;
-               LBitV = bitV;
-            }
+   gpioGlitch.bits = bits;
 
-            if (bitV != RBitV)
-            {
-               /* Difference between level and reported level. */
+   lLevel   = gpioGlitch.lLevel & bits;
+   rLevel   = gpioGlitch.rLevel & bits;
+   nextTick = gpioGlitch.nextTick;
 
-               diff = sample[j].tick - changedTick;
+   if (newBits)
+   {
+      /* As set up by gpioGlitchFilter the opposite level is reported
+         until the current level has been steady since the call. */
 
-               if (diff >= steadyUs)
-               {
-                  /* Level stable for steady period. */
-                  RBitV = bitV;
-               }
-               else
-               {
-                  /* Keep reporting old level. */
+      level  = sample[0].level & newBits;
+      lLevel = (lLevel & ~newBits) | level;
+      rLevel = (rLevel & ~newBits) | (level ^ newBits);
 
-                  sample[j].level ^= bit;
-               }
-            }
+      todo = newBits;
 
-         }
+      while (todo)
+      {
+         b = __builtin_ctz(todo);
+         todo &= (todo - 1);
 
-         gpioAlert[i].gfRBitV = RBitV;
-         gpioAlert[i].gfLBitV = LBitV;
-         gpioAlert[i].gfTick  = changedTick;
+         gpioGlitch.deadline[b] =
+            gpioGlitch.setTick[b] + gpioGlitch.steadyUs[b];
       }
-   }
-}
 
-static void alertNoiseFilter(gpioSample_t *sample, int numSamples)
-{
-   int i, j, diff;
-   uint32_t LBitV;
-   uint32_t bit, bitV;
-   uint32_t nowTick;
+      nextTick = sample[0].tick; /* force a deadline check */
+   }
 
-   for (i=0; i<=PI_MAX_USER_GPIO; i++)
+   for (j=0; j<numSamples; j++)
    {
-      bit = (1<<i);
+      tick  = sample[j].tick;
+      level = sample[j].level & bits;
+
+      changes = level ^ lLevel;
 
-      if (monitorBits & bit & nFilterBits)
+      if (changes)
       {
-         LBitV = gpioAlert[i].nfLBitV;
+         /* Difference between level and last level.
+            Restart steady timers. */
+
+         if (!(lLevel ^ rLevel)) nextTick = tick + 0x7FFFFFFF;
+
+         lLevel = level;
 
-         for (j=0; j<numSamples; j++)
+         todo = changes;
+
+         while (todo)
          {
-            bitV = sample[j].level & bit;
-            nowTick = sample[j].tick;
+            b = __builtin_ctz(todo);
+            todo &= (todo - 1);
 
-            if (gpioAlert[i].nfActive) /* reporting events */
-            {
-               diff = nowTick - gpioAlert[i].nfTick2;
+            gpioGlitch.deadline[b] = tick + gpioGlitch.steadyUs[b];
 
-               if (diff >= 0)
-               {
-                  /* Stop reporting gpio changes */
+            if ((int32_t)(gpioGlitch.deadline[b] - nextTick) < 0)
+               nextTick = gpioGlitch.deadline[b];
+         }
+      }
 
-                  gpioAlert[i].nfActive = 0;
-                  gpioAlert[i].nfTick1 = nowTick;
-               }
-            }
-            else /* waiting for steady us */
-            {
-               if (bitV != LBitV)
-               {
-                  diff = nowTick - gpioAlert[i].nfTick1;
-                  gpioAlert[i].nfTick1 = nowTick;
+      /* Difference between level and reported level. */
 
-                  if (diff >= gpioAlert[i].nfSteadyUs)
-                  {
-                     /* Start reporting gpio changes */
+      pending = lLevel ^ rLevel;
 
-                     gpioAlert[i].nfRBitV = LBitV;
-                     gpioAlert[i].nfActive = 1;
-                     gpioAlert[i].nfTick2 =
-                        nowTick + gpioAlert[i].nfActiveUs;
-                  }
-               }
-            }
+      if (pending)
+      {
+         if ((int32_t)(tick - nextTick) >= 0)
+         {
+            /* Some level may have been stable for its steady period. */
+
+            nextTick = tick + 0x7FFFFFFF;
 
-            if (!gpioAlert[i].nfActive)
+            todo = pending;
+
+            while (todo)
             {
-               if (bitV != gpioAlert[i].nfRBitV)
-                  sample[j].level ^= bit;
+               b = __builtin_ctz(todo);
+               todo &= (todo - 1);
+
+               if ((int32_t)(tick - gpioGlitch.deadline[b]) >= 0)
+                  rLevel ^= (1<<b);
+               else if ((int32_t)(gpioGlitch.deadline[b] - nextTick) < 0)
+                  nextTick = gpioGlitch.deadline[b];
             }
 
-            LBitV = bitV;
+            pending = lLevel ^ rLevel;
          }
 
-         gpioAlert[i].nfLBitV = LBitV;
+         /* Keep reporting old level. */
 
+         sample[j].level ^= pending;
       }
    }
+
+   gpioGlitch.lLevel   = lLevel;
+   gpioGlitch.rLevel   = rLevel;
+   gpioGlitch.nextTick = nextTick;
 }
 
-static void alertEmit(
-   gpioSample_t *sample, int numSamples, uint32_t changedBits, uint32_t eTick)
+static void alertNoiseFilter1(gpioSample_t *sample, int numSamples, int b)
 {
-   uint32_t oldLevel, newLevel;
-   int32_t diff;
-   int emit, seqno, emitted;
-   uint32_t changes, bits, timeoutBits, eventBits;
-   int d;
-   int b, n, v;
-   int err;
-   int max_emits;
-   char fifo[32];
-   gpioReport_t report[MAX_REPORT];
+   int j, steadyUs;
+   uint32_t bit, active, wasActive, lLevel, rLevel, level;
+   uint32_t tick, activeUs, activeEnd, lastChange;
 
-   if (changedBits)
+   bit = (1<<b);
+
+   active     = gpioNoise.active & bit;
+   lLevel     = gpioNoise.lLevel & bit;
+   rLevel     = gpioNoise.rLevel & bit;
+   steadyUs   = gpioNoise.steadyUs[b];
+   activeUs   = gpioNoise.activeUs[b];
+   activeEnd  = gpioNoise.activeEnd[b];
+   lastChange = gpioNoise.lastChange[b];
+
+   for (j=0; j<numSamples; j++)
    {
-      if (gpioGetSamples.func)
+      tick  = sample[j].tick;
+      level = sample[j].level & bit;
+
+      wasActive = active;
+
+      if (active && ((int32_t)(tick - activeEnd) >= 0))
       {
-         if (gpioGetSamples.ex)
-         {
-            (gpioGetSamples.func)
-               (sample, numSamples, gpioGetSamples.userdata);
-         }
-         else
+         /* Stop reporting gpio changes */
+
+         active = 0;
+         lastChange = tick;
+      }
+
+      if (!wasActive && (level != lLevel))
+      {
+         if ((int)(tick - lastChange) >= steadyUs)
          {
-            (gpioGetSamples.func)(sample, numSamples);
+            /* Start reporting gpio changes */
+
+            rLevel = lLevel;
+            activeEnd = tick + activeUs;
+            active = bit;
          }
+
+         lastChange = tick;
       }
-   }
 
-   eventBits = 0;
+      if (!active) sample[j].level ^= level ^ rLevel;
 
-   if (bscFR != (bscsReg[BSC_FR]&0xffff))
-   {
-      bscFR = bscsReg[BSC_FR]&0xffff;
-      eventAlert[PI_EVENT_BSC].fired = 1;
+      lLevel = level;
    }
 
-   for (b=0; b<=PI_MAX_EVENT; b++)
+   gpioNoise.active   = active;
+   gpioNoise.lLevel   = (gpioNoise.lLevel & ~bit) | lLevel;
+   gpioNoise.rLevel   = (gpioNoise.rLevel & ~bit) | rLevel;
+   gpioNoise.nextTick = activeEnd;
+
+   gpioNoise.activeEnd[b]  = activeEnd;
+   gpioNoise.lastChange[b] = lastChange;
+}
+
+static void alertNoiseFilter(gpioSample_t *sample, int numSamples)
+{
+   int j, b;
+   uint32_t bits, resetBits, todo, bit;
+   uint32_t active, wasActive, lLevel, rLevel, level, changes;
+   uint32_t tick, nextTick;
+
+   bits = monitorBits & nFilterBits;
+
+   active   = gpioNoise.active;
+   lLevel   = gpioNoise.lLevel;
+   rLevel   = gpioNoise.rLevel;
+   nextTick = gpioNoise.nextTick;
+
+   resetBits = __sync_fetch_and_and(&gpioNoise.resetBits, 0);
+
+   if (resetBits)
    {
-      if (eventAlert[b].fired && (!eventAlert[b].ignore))
+      /* Set up by gpioNoiseFilter, start waiting for steady us. */
+
+      active &= ~resetBits;
+
+      todo = resetBits;
+
+      while (todo)
       {
-         eventBits |= (1<<b);
+         b = __builtin_ctz(todo);
+         todo &= (todo - 1);
 
-         if (eventAlert[b].func)
-         {
-            if (eventAlert[b].ex)
-            {
-               (eventAlert[b].func)(b, eTick, eventAlert[b].userdata);
-            }
-            else
-            {
-               (eventAlert[b].func)(b, eTick);
-            }
-         }
+         gpioNoise.lastChange[b] = gpioNoise.setTick[b];
       }
-
-      eventAlert[b].fired = 0;
    }
 
-   /* call alert callbacks for each bit transition */
+   active &= bits;
 
-   if (changedBits & alertBits)
+   if (bits && !(bits & (bits - 1)))
    {
-      oldLevel = (reportedLevel & alertBits);
+      /* Only one GPIO filtered, the usual case, no bit scans needed */
 
-      for (d=0; d<numSamples; d++)
+      b = __builtin_ctz(bits);
+
+      gpioNoise.active   = active;
+      gpioNoise.lLevel   = lLevel;
+      gpioNoise.rLevel   = rLevel;
+
+      alertNoiseFilter1(sample, numSamples, b);
+
+      return;
+   }
+
+   for (j=0; j<numSamples; j++)
+   {
+      tick  = sample[j].tick;
+      level = sample[j].level & bits;
+
+      wasActive = active;
+
+      if (active && ((int32_t)(tick - nextTick) >= 0))
       {
-         newLevel = (sample[d].level & alertBits);
+         /* Stop reporting changes of GPIO whose active period is over */
 
-         if (newLevel != oldLevel)
+         nextTick = tick + 0x7FFFFFFF;
+
+         todo = active;
+
+         while (todo)
          {
-            changes = (newLevel ^ oldLevel);
+            b = __builtin_ctz(todo);
+            todo &= (todo - 1);
 
-            for (b=0; b<=PI_MAX_USER_GPIO; b++)
+            if ((int32_t)(tick - gpioNoise.activeEnd[b]) >= 0)
             {
-               if (changes & (1<<b))
-               {
-                  if (newLevel & (1<<b)) v = 1; else v = 0;
-
-                  if (gpioAlert[b].func)
-                  {
-                     if (gpioAlert[b].ex)
-                     {
-                        (gpioAlert[b].func)
-                           (b, v, sample[d].tick,
-                            gpioAlert[b].userdata);
-                     }
-                     else
-                     {
-                        (gpioAlert[b].func)(b, v, sample[d].tick);
-                     }
-                  }
-               }
+               active &= ~(1<<b);
+               gpioNoise.lastChange[b] = tick;
             }
-            oldLevel = newLevel;
+            else if ((int32_t)(gpioNoise.activeEnd[b] - nextTick) < 0)
+               nextTick = gpioNoise.activeEnd[b];
          }
       }
-   }
 
-   /* check for watchdog timeouts */
+      /* GPIO waiting for steady us which changed */
 
-   timeoutBits = 0;
+      changes = (level ^ lLevel) & ~wasActive;
 
-   if (wdogBits)
-   {
-      for (b=0; b<=PI_MAX_USER_GPIO; b++)
+      while (changes)
       {
-         if (gpioAlert[b].wdSteadyUs)
+         b = __builtin_ctz(changes);
+         changes &= (changes - 1);
+         bit = (1<<b);
+
+         if ((int)(tick - gpioNoise.lastChange[b]) >= gpioNoise.steadyUs[b])
          {
-            diff = eTick - gpioAlert[b].wdTick;
+            /* Start reporting gpio changes */
 
-            if (diff >= gpioAlert[b].wdSteadyUs)
-            {
-               timeoutBits |= (1<<b);
+            rLevel = (rLevel & ~bit) | (lLevel & bit);
 
-               gpioAlert[b].wdTick = eTick;
+            gpioNoise.activeEnd[b] = tick + gpioNoise.activeUs[b];
 
-               if (gpioAlert[b].func)
-               {
-                  if (gpioAlert[b].ex)
-                  {
-                     (gpioAlert[b].func)(b, PI_TIMEOUT, eTick,
-                                            gpioAlert[b].userdata);
-                  }
-                  else
-                  {
-                     (gpioAlert[b].func)(b, PI_TIMEOUT, eTick);
-                  }
-               }
-            }
+            if (!active ||
+               ((int32_t)(gpioNoise.activeEnd[b] - nextTick) < 0))
+               nextTick = gpioNoise.activeEnd[b];
+
+            active |= bit;
          }
+
+         gpioNoise.lastChange[b] = tick;
       }
-   }
 
-   for (n=0; n<PI_NOTIFY_SLOTS; n++)
-   {
-      if (gpioNotify[n].state == PI_NOTIFY_CLOSING)
-      {
-         if (gpioNotify[n].pipe)
-         {
-            DBG(DBG_INTERNAL, "close notify pipe %d", gpioNotify[n].fd);
-            close(gpioNotify[n].fd);
+      sample[j].level ^= (level ^ rLevel) & bits & ~active;
 
-            sprintf(fifo, "/dev/pigpio%d", n);
+      lLevel = (lLevel & ~bits) | level;
+   }
 
-            unlink(fifo);
-         }
+   gpioNoise.active   = active;
+   gpioNoise.lLevel   = lLevel;
+   gpioNoise.rLevel   = rLevel;
+   gpioNoise.nextTick = nextTick;
+}
 
-         gpioNotify[n].state = PI_NOTIFY_CLOSED;
-      }
-      else if (gpioNotify[n].state >= PI_NOTIFY_OPENED)
-      {
-         bits = gpioNotify[n].bits;
+static void statsLatency(int type, uint32_t now, uint32_t tick)
+{
+   /* bin n counts latencies of 2^n to 2^(n+1)-1 us, bin 0 also 0 us */
 
-         emit = 0;
+   uint32_t diff;
+   int bin;
 
-         seqno = gpioNotify[n].seqno;
+   diff = now - tick;
 
-         if (gpioNotify[n].state == PI_NOTIFY_RUNNING)
-         {
-            /* check to see if any bits have changed for this
-               notification.
+   if (diff > 1) bin = 31 - __builtin_clz(diff); else bin = 0;
 
-               bits         is the set of notification bits
-               changedBits is the set of changed bits
-            */
+   if (bin >= PI_LATENCY_BINS) bin = PI_LATENCY_BINS - 1;
 
-            if (changedBits & bits)
-            {
-               oldLevel = reportedLevel & bits;
+   __atomic_fetch_add(&gpioStats.latency[type][bin], 1, __ATOMIC_RELAXED);
+}
 
-               for (d=0; d<numSamples; d++)
-               {
-                  newLevel = sample[d].level & bits;
+static void alertPush(int gpio, uint32_t tick, int level)
+{
+   alertRing_t *ring = &alertRing[gpio];
+   uint32_t head, slot;
 
-                  if (newLevel != oldLevel)
-                  {
-                     report[emit].seqno = seqno;
-                     report[emit].flags = 0;
-                     report[emit].tick  = sample[d].tick;
-                     report[emit].level = sample[d].level;
+   head = ring->head;
 
-                     oldLevel = newLevel;
+   if ((head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) >=
+       gpioCfg.alertRingSize)
+   {
+      /* the dispatcher has fallen behind, drop the change */
 
-                     emit++;
-                     seqno++;
-                  }
-               }
-            }
+      gpioAlert[gpio].dropped++;
+      gpioStats.alertDropped++;
+      return;
+   }
 
-            /* check to see if any watchdogs are due for this
-               notification.
+   slot = head & (gpioCfg.alertRingSize - 1);
 
-               bits        is the set of notification bits
-               timeoutBits is the set of timed out bits
-            */
+   ring->tick [slot] = tick;
+   ring->level[slot] = level;
 
-            bits = gpioNotify[n].bits;
+   __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
 
-            if (timeoutBits & bits)
-            {
-               /* at least one watchdog has fired for this
-                  notification.
-               */
+static void alertGetFunc(int gpio, alertFunc_t *cb)
+{
+   gpioAlert_t *a = &gpioAlert[gpio];
+   uint32_t seq;
 
-               for (b=0; b<=PI_MAX_USER_GPIO; b++)
-               {
-                  if (timeoutBits & bits & (1<<b))
-                  {
-                     if (numSamples)
-                        newLevel = sample[numSamples-1].level;
-                     else
-                        newLevel = reportedLevel;
+   /* func and how to call it are read as one, retried if changed */
 
-                     report[emit].seqno = seqno;
-                     report[emit].flags =
-                        PI_NTFY_FLAGS_WDOG | PI_NTFY_FLAGS_BIT(b);
-                     report[emit].tick  = eTick;
-                     report[emit].level = newLevel;
+   do
+   {
+      seq = __atomic_load_n(&a->seq, __ATOMIC_ACQUIRE);
 
-                     emit++;
-                     seqno++;
-                  }
-               }
-            }
-         }
+      cb->func     = __atomic_load_n(&a->func,     __ATOMIC_RELAXED);
+      cb->ex       = __atomic_load_n(&a->ex,       __ATOMIC_RELAXED);
+      cb->batch    = __atomic_load_n(&a->batch,    __ATOMIC_RELAXED);
+      cb->userdata = __atomic_load_n(&a->userdata, __ATOMIC_RELAXED);
 
-         /* check to see if any events are due
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+   }
+   while ((seq & 1) || (seq != __atomic_load_n(&a->seq, __ATOMIC_RELAXED)));
+}
 
-            eventBits is the set of events
-         */
+static void alertCallEdge(int gpio, alertFunc_t *cb, int level, uint32_t tick)
+{
+   /* a GPIO just switched to batch callbacks misses this one */
 
-         if (eventBits & gpioNotify[n].eventBits)
-         {
-            for (b=0; b<=PI_MAX_EVENT; b++)
-            {
-               if (eventBits & gpioNotify[n].eventBits & (1<<b))
-               {
-                  if (numSamples)
-                     newLevel = sample[numSamples-1].level;
-                  else
-                     newLevel = reportedLevel;
+   if ((cb->func == NULL) || cb->batch) return;
 
-                  report[emit].seqno = seqno;
-                  report[emit].flags = 
-                     PI_NTFY_FLAGS_EVENT | PI_NTFY_FLAGS_BIT(b);
-                  report[emit].tick  = eTick;
-                  report[emit].level = newLevel;
+   if (cb->ex) (cb->func)(gpio, level, tick, cb->userdata);
+   else        (cb->func)(gpio, level, tick);
+}
 
-                  emit++;
-                  seqno++;
-               }
-            }
-         }
+static void alertDrain(int gpio)
+{
+   alertRing_t *ring = &alertRing[gpio];
+   alertFunc_t cb;
+   uint32_t head, tail, slot, count, now, i;
 
-         if (!emit)
-         {
-            if ((int)(eTick - gpioNotify[n].lastReportTick) > 60000000)
-            {
-               if (numSamples)
-                  newLevel = sample[numSamples-1].level;
-               else
-                  newLevel = reportedLevel;
+   tail = ring->tail;
+   head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
 
-               report[emit].seqno = seqno;
-               report[emit].flags = PI_NTFY_FLAGS_ALIVE;
-               report[emit].tick  = eTick;
-               report[emit].level = newLevel;
+   while (tail != head)
+   {
+      slot = tail & (gpioCfg.alertRingSize - 1);
 
-               emit++;
-               seqno++;
-            }
-         }
+      now = systReg[SYST_CLO];
 
-         if (emit)
-         {
-            DBG(DBG_FAST_TICK, "notification %d (%d reports, %x-%x)",
-               n, emit, report[0].seqno,  report[emit-1].seqno);
-            gpioNotify[n].lastReportTick = eTick;
-            max_emits = gpioNotify[n].max_emits;
+      alertGetFunc(gpio, &cb);
 
-            if (emit > gpioStats.maxEmit) gpioStats.maxEmit = emit;
+      if (cb.batch)
+      {
+         /* everything up to the end of the ring in one call */
 
-            emitted = 0;
+         count = head - tail;
 
-            while (emit > 0)
-            {
-               if (emit > max_emits)
-               {
-                  gpioStats.emitFrags++;
+         if (count > (gpioCfg.alertRingSize - slot))
+            count = gpioCfg.alertRingSize - slot;
 
-                  err = write(gpioNotify[n].fd,
-                           report+emitted,
-                           max_emits*sizeof(gpioReport_t));
+         for (i=0; i<count; i++)
+            statsLatency(PI_LATENCY_ALERT, now, ring->tick[slot+i]);
 
-                  if (err != (max_emits*sizeof(gpioReport_t)))
-                  {
-                     if (err < 0)
-                     {
-                        if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
-                        {
-                           /* serious error, no point continuing */
+         if (cb.func)
+         {
+            (cb.func)(gpio, count,
+               ring->tick+slot, ring->level+slot, cb.userdata);
+         }
+      }
+      else
+      {
+         count = 1;
 
-                           DBG(DBG_ALWAYS, "fd=%d err=%d errno=%d",
-                              gpioNotify[n].fd, err, errno);
+         statsLatency(PI_LATENCY_ALERT, now, ring->tick[slot]);
 
-                           DBG(DBG_ALWAYS, "%s", strerror(errno));
+         alertCallEdge(gpio, &cb, ring->level[slot], ring->tick[slot]);
+      }
 
-                           gpioNotify[n].bits  = 0;
-                           gpioNotify[n].state = PI_NOTIFY_CLOSING;
-                           intNotifyBits();
-                           break;
-                        }
-                        else gpioStats.wouldBlockPipeWrite++;
-                     }
-                     else
-                     {
-                        gpioStats.shortPipeWrite++;
-                        DBG(DBG_ALWAYS, "emitted %d, asked for %d",
-                           err/sizeof(gpioReport_t), max_emits);
-                     }
-                  }
-                  else
-                  {
-                     gpioStats.goodPipeWrite++;
-                  }
+      tail += count;
 
-                  emitted += max_emits;
-                  emit    -= max_emits;
-               }
-               else
-               {
-                  err = write(gpioNotify[n].fd,
-                           report+emitted,
-                           emit*sizeof(gpioReport_t));
+      __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+   }
+}
 
-                  if (err != (emit*sizeof(gpioReport_t)))
-                  {
-                     if (err < 0)
-                     {
-                        if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
-                        {
-                           DBG(DBG_ALWAYS, "fd=%d err=%d errno=%d",
-                              gpioNotify[n].fd, err, errno);
-
-                           DBG(DBG_ALWAYS, "%s", strerror(errno));
-
-                           /* serious error, no point continuing */
-                           gpioNotify[n].bits  = 0;
-                           gpioNotify[n].state = PI_NOTIFY_CLOSING;
-                           intNotifyBits();
-                           break;
-                        }
-                        else gpioStats.wouldBlockPipeWrite++;
-                     }
-                     else
-                     {
-                        gpioStats.shortPipeWrite++;
-                        DBG(DBG_ALWAYS, "emitted %d, asked for %d",
-                           err/sizeof(gpioReport_t), emit);
-                     }
-                  }
-                  else
-                  {
-                     gpioStats.goodPipeWrite++;
-                  }
+static void alertCallPattern(int event, uint32_t level, uint32_t tick)
+{
+   eventPatternFunc_t func;
 
-                  emitted += emit;
-                  emit = 0;
-               }
-            }
+   func = eventPattern[event].func;
 
-            gpioNotify[n].seqno = seqno;
-         }
-      }
-   }
+   if (func) (func)(event, level, tick, eventPattern[event].userdata);
 
-   if (changedBits & scriptBits)
+   if (eventAlert[event].func && (!eventAlert[event].ignore))
    {
-      for (n=0; n<PI_MAX_SCRIPTS; n++)
+      if (eventAlert[event].ex)
       {
-         if ((gpioScript[n].state     == PI_SCRIPT_IN_USE)  &&
-             (gpioScript[n].run_state == PI_SCRIPT_WAITING) &&
-             (gpioScript[n].waitBits & changedBits))
-         {
-            pthread_mutex_lock(&gpioScript[n].pthMutex);
-
-            if (gpioScript[n].run_state == PI_SCRIPT_WAITING)
-            {
-               gpioScript[n].changedBits =
-                  gpioScript[n].waitBits & changedBits;
-               pthread_cond_signal(&gpioScript[n].pthCond);
-            }
-
-            pthread_mutex_unlock(&gpioScript[n].pthMutex);
-         }
+         (eventAlert[event].func)(event, tick, eventAlert[event].userdata);
+      }
+      else
+      {
+         (eventAlert[event].func)(event, tick);
       }
    }
+}
 
-   if (eventBits & scriptEventBits)
-   {
-      for (n=0; n<PI_MAX_SCRIPTS; n++)
-      {
-         if ((gpioScript[n].state     == PI_SCRIPT_IN_USE)  &&
-             (gpioScript[n].run_state == PI_SCRIPT_WAITING) &&
-             (gpioScript[n].eventBits & eventBits))
-         {
-            pthread_mutex_lock(&gpioScript[n].pthMutex);
+static void alertPushPattern(int event, uint32_t level, uint32_t tick)
+{
+   patternRing_t *ring = &patternRing;
+   uint32_t head, slot;
 
-            if (gpioScript[n].run_state == PI_SCRIPT_WAITING)
-            {
-               gpioScript[n].changedBits =
-                  gpioScript[n].eventBits & eventBits;
-               pthread_cond_signal(&gpioScript[n].pthCond);
-            }
+   head = ring->head;
 
-            pthread_mutex_unlock(&gpioScript[n].pthMutex);
-         }
-      }
+   if ((head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) >=
+       gpioCfg.alertRingSize)
+   {
+      gpioStats.alertDropped++;
+      return;
    }
 
-   if (numSamples) reportedLevel = sample[numSamples-1].level;
+   slot = head & (gpioCfg.alertRingSize - 1);
+
+   ring->tick [slot] = tick;
+   ring->level[slot] = level;
+   ring->event[slot] = event;
+
+   __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
 }
 
-static void alertWdogCheck(gpioSample_t *sample, int numSamples)
+static void alertDrainPatterns(void)
 {
-   /*
-   Go through and set the last time each GPIO with a watchdog changed state.
-   */
+   patternRing_t *ring = &patternRing;
+   uint32_t head, tail, slot;
 
-   int i, j;
-   uint32_t LBitV;
-   uint32_t bit;
+   tail = ring->tail;
+   head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
 
-   for (i=0; i<=PI_MAX_USER_GPIO; i++)
+   while (tail != head)
    {
-      bit = (1<<i);
+      slot = tail & (gpioCfg.alertRingSize - 1);
 
-      if (monitorBits & bit & wdogBits)
-      {
-         LBitV = gpioAlert[i].wdLBitV;
+      alertCallPattern(ring->event[slot], ring->level[slot], ring->tick[slot]);
 
-         for (j=0; j<numSamples; j++)
-         {
-            if ((sample[j].level & bit) != LBitV)
-            {
-               LBitV = sample[j].level & bit;
-               gpioAlert[i].wdTick = sample[j].tick;
-            }
-         }
+      tail++;
 
-         gpioAlert[i].wdLBitV = LBitV;
-      }
+      __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
    }
 }
 
-static void * pthAlertThread(void *x)
+static void * pthAlertDispatchThread(void *x)
 {
-   struct timespec req, rem;
-   uint32_t oldLevel, newLevel, level;
-   uint32_t oldSlot,  newSlot;
-   uint32_t expected, ft, sTick;
-   uint32_t changedBits;
-   int32_t diff, minDiff, stickInited;
-   int cycle, pulse;
-   int numSamples, ticks, i;
-   int rp, reports, totalSamples;
-   int stopped;
-   int moreToDo;
-   gpioSample_t sample[MAX_SAMPLE];
+   alertDispatch_t *disp = x;
+   uint32_t todo;
+   int b;
 
-   req.tv_sec = 0;
+   while (1)
+   {
+      sem_wait(&disp->sem);
 
-   /* don't start until DMA started */
+      if (disp->patterns) alertDrainPatterns();
 
-   spinWhileStarting();
+      todo = disp->bits;
 
-   reportedLevel = gpioReg[GPLEV0];
+      while (todo)
+      {
+         b = __builtin_ctz(todo);
+         todo &= (todo - 1);
 
-   oldLevel = reportedLevel;
+         alertDrain(b);
+      }
+   }
 
-   oldSlot = dmaCurrentSlot(dmaNowAtICB());
+   return NULL;
+}
 
-   oldSlot = (oldSlot / PULSE_PER_CYCLE) * PULSE_PER_CYCLE;
+static void alertNotifyShmRelease(void)
+{
+   uint32_t todo;
+   int n;
 
-   cycle = (oldSlot/PULSE_PER_CYCLE);
+   /* only the alert thread writes to a shared memory ring so it
+      unmaps the rings of closed handles, between passes.  The notify
+      thread finishes the close once shm is NULL. */
 
-   pulse = 0;
+   todo = __atomic_exchange_n(&notifyShmClosing, 0, __ATOMIC_ACQUIRE);
 
-   stopped = 0;
+   while (todo)
+   {
+      n = __builtin_ctz(todo);
+      todo &= (todo - 1);
 
-   moreToDo = 0;
+      munmap(gpioNotify[n].shm, gpioNotify[n].shmLen);
 
-   stickInited = 0;
+      __atomic_store_n(&gpioNotify[n].shm, NULL, __ATOMIC_RELEASE);
+   }
 
-   sTick = 0;
+   notifyWake();
+}
 
-   minDiff = gpioCfg.clockMicros / 2;
+static void alertNotifyShm(int n, struct iovec *iov, int iovcnt)
+{
+   gpioNotifyShm_t *shm = gpioNotify[n].shm;
+   gpioReport_t *rp;
+   uint32_t head, mask, lag, readers, added, now;
+   uint64_t one = 1;
+   int i, j, count, r;
 
-   while (1)
+   /* write the reports straight into the shared ring, overwriting
+      the oldest if a consumer has fallen behind */
+
+   head  = gpioNotify[n].shmHead;
+   mask  = gpioNotify[n].shmSize - 1;
+   added = 0;
+
+   for (i=0; i<iovcnt; i++)
    {
-      /* Check that DMA is running okay */
+      rp    = iov[i].iov_base;
+      count = iov[i].iov_len / sizeof(gpioReport_t);
 
-      if (dmaIn[DMA_CONBLK_AD])
-      {
-         if (stopped)
-         {
-            DBG(DBG_STARTUP, "****** GOING ******");
-            stopped = 0;
-         }
-      }
-      else
-      {
-         stopped = 1;
+      for (j=0; j<count; j++) shm->report[(head + j) & mask] = rp[j];
 
-         myGpioDelay(5000);
+      /* the reports are delivered as soon as they are in the ring */
 
-         if (runState == PI_RUNNING)
-         {
-            /* should never be executed, leave code just in case */
+      now = systReg[SYST_CLO];
 
-            gpioCfg.internals |= PI_CFG_STATS;
+      for (j=0; j<count; j++) statsLatency(PI_LATENCY_NOTIFY, now, rp[j].tick);
 
-            dmaInitCbs();
-            flushMemory();
-            initDMAgo((uint32_t *)dmaIn, (uint32_t)dmaIBus[0]);
-            myGpioDelay(5000); /* let DMA run for a while */
-            oldSlot = dmaCurrentSlot(dmaNowAtICB());
-            gpioStats.DMARestarts++;
-         }
-      }
+      head  += count;
+      added += count;
+   }
 
-      newSlot = dmaCurrentSlot(dmaNowAtICB());
+   /* count the reports overwritten before the slowest consumer
+      read them */
 
-      newSlot = (newSlot / PULSE_PER_CYCLE) * PULSE_PER_CYCLE;
+   lag = 0;
 
-      numSamples = 0;
+   readers = __atomic_load_n(&shm->readers, __ATOMIC_ACQUIRE) &
+             ((1<<PI_NOTIFY_SHM_READERS) - 1);
 
-      /*
-      Extract samples from DMA ring buffer.
-      */
+   while (readers)
+   {
+      r = __builtin_ctz(readers);
+      readers &= (readers - 1);
 
-      while ((oldSlot != newSlot) && (numSamples < MAX_SAMPLE))
+      if ((head - shm->cursor[r]) > lag) lag = head - shm->cursor[r];
+   }
+
+   if (lag > gpioNotify[n].shmSize)
+   {
+      lag -= gpioNotify[n].shmSize;
+      if (lag > added) lag = added;
+
+      gpioNotify[n].overflow += lag;
+      gpioStats.notifyOverflow += lag;
+   }
+
+   gpioNotify[n].shmHead = head;
+
+   __atomic_store_n(&shm->head, head, __ATOMIC_SEQ_CST);
+
+   if (__atomic_load_n(&shm->waiters, __ATOMIC_SEQ_CST))
+   {
+      syscall(SYS_futex, &shm->head, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+
+      if (write(gpioNotify[n].efd, &one, sizeof(one)) != sizeof(one))
+         DBG(DBG_INTERNAL, "notify %d eventfd failed (%m)", n);
+   }
+}
+
+static void alertNotifyStamp(int n, uint32_t end, uint32_t tick)
+{
+   gpioNotify_t *p = &gpioNotify[n];
+   notifyStamp_t *s;
+   uint32_t head;
+
+   /* remembers the tick of a queued report so the notify thread can
+      time it once written, reports queued while NOTIFY_STAMPS are
+      waiting aren't timed */
+
+   head = p->sHead;
+
+   if ((head - __atomic_load_n(&p->sTail, __ATOMIC_ACQUIRE)) >= NOTIFY_STAMPS)
+      return;
+
+   s = &notifyStamp[n][head & (NOTIFY_STAMPS - 1)];
+
+   s->end  = end;
+   s->tick = tick;
+
+   __atomic_store_n(&p->sHead, head + 1, __ATOMIC_RELEASE);
+}
+
+static void alertNotifyQueue(int n, struct iovec *iov, int iovcnt)
+{
+   gpioNotify_t *p = &gpioNotify[n];
+   uint32_t head, space, len, off, part;
+   int i, j, k;
+   char *src;
+   gpioReport_t *rp;
+   cmdNotifyCodec_t codec;
+   uint8_t rec[CMD_NOTIFY_MAX_RECORD];
+
+   /* copy the reports to the handle's queue for the notify thread,
+      any which don't fit are counted and dropped */
+
+   head  = p->qHead;
+   space = NOTIFY_QUEUE_BYTES -
+      (head - __atomic_load_n(&p->qTail, __ATOMIC_ACQUIRE));
+
+   if (__atomic_load_n(&p->encoding, __ATOMIC_ACQUIRE) != PI_NOTIFY_ENC_RAW)
+   {
+      /* delta encode each report, after a dropped report the codec
+         starts again with a keyframe */
+
+      for (i=0; i<iovcnt; i++)
       {
-         level = myGetLevel(oldSlot++);
+         rp = iov[i].iov_base;
 
-         sample[numSamples].tick  = sTick;
-         sample[numSamples].level = level;
+         for (j=0; j<iov[i].iov_len/sizeof(gpioReport_t); j++)
+         {
+            codec = p->codec;
 
-         numSamples++;
+            len = cmdNotifyEncode(&codec, rp+j, rec);
 
-         sTick += gpioCfg.clockMicros;
+            if (len > space)
+            {
+               p->overflow++;
+               gpioStats.notifyOverflow++;
+               p->codec.count = -1;
+               continue;
+            }
 
-         if (++pulse >= PULSE_PER_CYCLE)
+            for (k=0; k<len; k++)
+               notifyQueue[n][(head + k) & (NOTIFY_QUEUE_BYTES - 1)] = rec[k];
+
+            p->codec = codec;
+
+            head  += len;
+            space -= len;
+
+            alertNotifyStamp(n, head, rp[j].tick);
+         }
+      }
+
+      __atomic_store_n(&p->qHead, head, __ATOMIC_RELEASE);
+
+      return;
+   }
+
+   for (i=0; i<iovcnt; i++)
+   {
+      src = iov[i].iov_base;
+      len = iov[i].iov_len;
+
+      if (len > space)
+      {
+         part = space - (space % sizeof(gpioReport_t));
+         p->overflow += (len - part) / sizeof(gpioReport_t);
+         gpioStats.notifyOverflow += (len - part) / sizeof(gpioReport_t);
+         len = part;
+      }
+
+      rp = (gpioReport_t *)src;
+
+      for (j=0; j<len/sizeof(gpioReport_t); j++)
+         alertNotifyStamp(n, head + (j+1)*sizeof(gpioReport_t), rp[j].tick);
+
+      while (len)
+      {
+         off  = head & (NOTIFY_QUEUE_BYTES - 1);
+         part = NOTIFY_QUEUE_BYTES - off;
+         if (part > len) part = len;
+
+         memcpy(notifyQueue[n] + off, src, part);
+
+         src   += part;
+         head  += part;
+         space -= part;
+         len   -= part;
+      }
+   }
+
+   __atomic_store_n(&p->qHead, head, __ATOMIC_RELEASE);
+}
+
+static uint32_t alertGetPatterns(void)
+{
+   eventPatternSet_t set;
+   uint32_t seq, changed;
+   int b;
+
+   /* copies patternSet once it has changed, retried if changed while
+      being copied.  Returns the events whose pattern is new. */
+
+   seq = __atomic_load_n(&patternSet.seq, __ATOMIC_ACQUIRE);
+
+   if (seq == patternLocal.seq) return 0;
+
+   do
+   {
+      seq = __atomic_load_n(&patternSet.seq, __ATOMIC_ACQUIRE);
+
+      set.events = __atomic_load_n(&patternSet.events, __ATOMIC_RELAXED);
+      set.bits   = __atomic_load_n(&patternSet.bits,   __ATOMIC_RELAXED);
+
+      for (b=0; b<=PI_MAX_EVENT; b++)
+      {
+         set.mask[b]    =
+            __atomic_load_n(&patternSet.mask[b],    __ATOMIC_RELAXED);
+         set.pattern[b] =
+            __atomic_load_n(&patternSet.pattern[b], __ATOMIC_RELAXED);
+      }
+
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+   }
+   while ((seq & 1) ||
+          (seq != __atomic_load_n(&patternSet.seq, __ATOMIC_RELAXED)));
+
+   set.seq = seq;
+
+   changed = set.events & ~patternLocal.events;
+
+   for (b=0; b<=PI_MAX_EVENT; b++)
+   {
+      if ((set.mask[b]    != patternLocal.mask[b]) ||
+          (set.pattern[b] != patternLocal.pattern[b])) changed |= (1<<b);
+   }
+
+   patternLocal = set;
+
+   return changed & set.events;
+}
+
+static uint32_t alertPatternMatch(uint32_t level, uint32_t events)
+{
+   /* the events whose pattern matches level, each pattern is
+      compared with all its GPIO at once */
+
+   uint32_t match = 0;
+   int b;
+
+   while (events)
+   {
+      b = __builtin_ctz(events);
+      events &= (events - 1);
+
+      if (!((level ^ patternLocal.pattern[b]) & patternLocal.mask[b]))
+         match |= (1<<b);
+   }
+
+   return match;
+}
+
+static int alertNotifyGlitch(
+   int n, gpioSample_t *sample, int numSamples, uint32_t eTick,
+   gpioReport_t *report, uint32_t *reportChanges)
+{
+   /* Builds the reports of a notification with its own glitch filter.
+      A level change is reported once it has been steady for steadyUs,
+      at the tick the steady period ended.  All the GPIO changed by a
+      sample share a deadline so there are at most numSamples reports
+      plus one per GPIO still pending from earlier passes.
+   */
+
+   gpioNotify_t *h;
+   uint32_t bits, newBits, lLevel, rLevel, level, baseLevel;
+   uint32_t changes, matured, todo, tick, nextTick, t;
+   int j, b, num;
+
+   h = &gpioNotify[n];
+
+   bits = h->bits;
+
+   newBits = bits & ~h->gBits;
+
+   if (__sync_fetch_and_and(&h->gReset, 0)) newBits = bits;
+
+   h->gBits = bits;
+
+   lLevel   = h->gLevel & bits;
+   rLevel   = h->gReported & bits;
+   nextTick = h->gNextTick;
+
+   if (newBits)
+   {
+      /* start from the current level, nothing pending */
+
+      level  = reportedLevel & newBits;
+      lLevel = (lLevel & ~newBits) | level;
+      rLevel = (rLevel & ~newBits) | level;
+   }
+
+   baseLevel = reportedLevel;
+
+   num = 0;
+
+   for (j=0; j<=numSamples; j++)
+   {
+      if (j < numSamples) tick = sample[j].tick;
+      else                tick = eTick;
+
+      /* report the levels which were steady before this sample */
+
+      while ((lLevel ^ rLevel) && ((int32_t)(tick - nextTick) >= 0))
+      {
+         t = nextTick;
+
+         nextTick = t + 0x7FFFFFFF;
+
+         matured = 0;
+
+         todo = lLevel ^ rLevel;
+
+         while (todo)
          {
-            pulse = 0;
+            b = __builtin_ctz(todo);
+            todo &= (todo - 1);
 
-            if (++cycle >= bufferCycles)
+            if ((int32_t)(h->gDeadline[b] - t) <= 0)
+               matured |= (1<<b);
+            else if ((int32_t)(h->gDeadline[b] - nextTick) < 0)
+               nextTick = h->gDeadline[b];
+         }
+
+         if (matured)
+         {
+            rLevel ^= matured;
+
+            report[num].flags = 0;
+            report[num].tick  = t;
+            report[num].level = (baseLevel & ~bits) | rLevel;
+            reportChanges[num] = matured;
+
+            num++;
+         }
+      }
+
+      if (j == numSamples) break;
+
+      level = sample[j].level & bits;
+
+      changes = level ^ lLevel;
+
+      if (changes)
+      {
+         /* restart the steady timers of the changed GPIO */
+
+         if (!(lLevel ^ rLevel)) nextTick = tick + 0x7FFFFFFF;
+
+         lLevel = level;
+
+         todo = changes;
+
+         while (todo)
+         {
+            b = __builtin_ctz(todo);
+            todo &= (todo - 1);
+
+            h->gDeadline[b] = tick + h->steadyUs;
+         }
+
+         if ((int32_t)(tick + h->steadyUs - nextTick) < 0)
+            nextTick = tick + h->steadyUs;
+      }
+
+      baseLevel = sample[j].level;
+   }
+
+   h->gLevel    = lLevel;
+   h->gReported = rLevel;
+   h->gNextTick = nextTick;
+
+   return num;
+}
+
+static void alertEmit(
+   gpioSample_t *sample, int numSamples, uint32_t changedBits, uint32_t eTick)
+{
+   uint32_t oldLevel, newLevel;
+   int32_t diff;
+   int emit, extra, seqno, numReports, iovcnt, queued;
+   uint32_t changes, bits, timeoutBits, eventBits;
+   uint32_t edgeBits, batchBits, queueBits, wakeBits, todo;
+   uint32_t notifyChanges, allChanges, hLevel, level;
+   uint32_t rising, falling, risingOnly, fallingOnly;
+   int d, num;
+   int b, n, v;
+   gpioReport_t report[MAX_REPORT];
+   uint32_t reportChanges[MAX_REPORT];
+   gpioReport_t gather[MAX_REPORT+32];
+   gpioReport_t glitchReport[MAX_REPORT+32];
+   uint32_t glitchChanges[MAX_REPORT+32];
+   gpioReport_t *src;
+   uint32_t *srcChanges;
+   gpioReport_t extraReport[PI_MAX_USER_GPIO+PI_MAX_EVENT+3];
+   uint32_t patternFired[MAX_REPORT], firedBits, events, match, now;
+   gpioReport_t patternReport[MAX_REPORT];
+   int pattern, wakePatterns;
+   struct iovec iov[3];
+   alertFunc_t cb;
+
+   if (changedBits)
+   {
+      if (gpioGetSamples.func)
+      {
+         if (gpioGetSamples.ex)
+         {
+            (gpioGetSamples.func)
+               (sample, numSamples, gpioGetSamples.userdata);
+         }
+         else
+         {
+            (gpioGetSamples.func)(sample, numSamples);
+         }
+      }
+   }
+
+   eventBits = 0;
+
+   if (bscFR != (bscsReg[BSC_FR]&0xffff))
+   {
+      bscFR = bscsReg[BSC_FR]&0xffff;
+      eventAlert[PI_EVENT_BSC].fired = 1;
+   }
+
+   for (b=0; b<=PI_MAX_EVENT; b++)
+   {
+      if (eventAlert[b].fired && (!eventAlert[b].ignore))
+      {
+         eventBits |= (1<<b);
+
+         if (eventAlert[b].func)
+         {
+            if (eventAlert[b].ex)
             {
-               cycle = 0;
-               oldSlot = 0;
+               (eventAlert[b].func)(b, eTick, eventAlert[b].userdata);
+            }
+            else
+            {
+               (eventAlert[b].func)(b, eTick);
+            }
+         }
+      }
+
+      eventAlert[b].fired = 0;
+   }
+
+   /* an event with a level pattern fires at each sample where
+      (level & mask) starts to equal its pattern */
+
+   firedBits = 0;
+
+   wakePatterns = 0;
+
+   /* the patterns are read once per pass */
+
+   todo = alertGetPatterns();
+
+   events = patternLocal.events;
+
+   if (events)
+   {
+
+      /* a new pattern starts from the current level without firing */
+
+      match = (patternMatch & events & ~todo) |
+              alertPatternMatch(reportedLevel, todo);
+
+      oldLevel = reportedLevel;
+
+      for (d=0; d<numSamples; d++)
+      {
+         patternFired[d] = 0;
+
+         if ((sample[d].level ^ oldLevel) & patternLocal.bits)
+         {
+            changes = alertPatternMatch(sample[d].level, events);
+
+            patternFired[d] = changes & ~match;
+
+            firedBits |= patternFired[d];
+
+            match = changes;
+         }
+
+         oldLevel = sample[d].level;
+
+         todo = patternFired[d];
+
+         while (todo)
+         {
+            b = __builtin_ctz(todo);
+            todo &= (todo - 1);
+
+            /* queued for dispatcher 0 like the alert callbacks */
+
+            if (alertThreads)
+            {
+               alertPushPattern(b, sample[d].level, sample[d].tick);
+               wakePatterns = 1;
             }
+            else alertCallPattern(b, sample[d].level, sample[d].tick);
+         }
+      }
+
+      patternMatch = match;
+   }
+   else patternMatch = 0;
+
+   /* call alert callbacks for each bit transition, or collect the
+      transitions of batch alert GPIO, or queue the transitions for
+      the dispatcher threads */
+
+   if (alertThreads)
+   {
+      queueBits = alertBits;
+      batchBits = 0;
+      edgeBits  = 0;
+   }
+   else
+   {
+      queueBits = 0;
+      batchBits = alertBits & alertBatchBits;
+      edgeBits  = alertBits & ~batchBits;
+   }
+
+   wakeBits = 0;
+
+   if (changedBits & alertBits)
+   {
+      oldLevel = (reportedLevel & alertBits);
+
+      for (d=0; d<numSamples; d++)
+      {
+         newLevel = (sample[d].level & alertBits);
+
+         if (newLevel != oldLevel)
+         {
+            changes = (newLevel ^ oldLevel);
+
+            todo = changes & edgeBits;
+
+            if (todo) now = systReg[SYST_CLO];
+
+            while (todo)
+            {
+               b = __builtin_ctz(todo);
+               todo &= (todo - 1);
+
+               v = (newLevel >> b) & 1;
+
+               statsLatency(PI_LATENCY_ALERT, now, sample[d].tick);
+
+               alertGetFunc(b, &cb);
+
+               alertCallEdge(b, &cb, v, sample[d].tick);
+            }
+
+            todo = changes & batchBits;
+
+            while (todo)
+            {
+               b = __builtin_ctz(todo);
+               todo &= (todo - 1);
+
+               n = alertBatchCount[b]++;
+               alertBatchTick [b][n] = sample[d].tick;
+               alertBatchLevel[b][n] = (newLevel >> b) & 1;
+            }
+
+            todo = changes & queueBits;
+
+            wakeBits |= todo;
+
+            while (todo)
+            {
+               b = __builtin_ctz(todo);
+               todo &= (todo - 1);
+
+               alertPush(b, sample[d].tick, (newLevel >> b) & 1);
+            }
+
+            oldLevel = newLevel;
+         }
+      }
+   }
+
+   /* check for watchdog timeouts */
+
+   timeoutBits = 0;
+
+   todo = wdogBits;
+
+   while (todo)
+   {
+      b = __builtin_ctz(todo);
+      todo &= (todo - 1);
+
+      if (gpioAlert[b].wdSteadyUs)
+      {
+         diff = eTick - gpioAlert[b].wdTick;
+
+         if (diff >= gpioAlert[b].wdSteadyUs)
+         {
+            timeoutBits |= (1<<b);
+
+            gpioAlert[b].wdTick = eTick;
+
+            if (queueBits & (1<<b))
+            {
+               alertPush(b, eTick, PI_TIMEOUT);
+
+               wakeBits |= (1<<b);
+            }
+            else if (batchBits & (1<<b))
+            {
+               n = alertBatchCount[b]++;
+               alertBatchTick [b][n] = eTick;
+               alertBatchLevel[b][n] = PI_TIMEOUT;
+            }
+            else
+            {
+               alertGetFunc(b, &cb);
+
+               alertCallEdge(b, &cb, PI_TIMEOUT, eTick);
+            }
+         }
+      }
+   }
+
+   /* one call per batch alert GPIO with all its transitions */
+
+   todo = batchBits;
+
+   while (todo)
+   {
+      b = __builtin_ctz(todo);
+      todo &= (todo - 1);
+
+      if (alertBatchCount[b])
+      {
+         now = systReg[SYST_CLO];
+
+         for (n=0; n<alertBatchCount[b]; n++)
+            statsLatency(PI_LATENCY_ALERT, now, alertBatchTick[b][n]);
+
+         alertGetFunc(b, &cb);
+
+         /* dropped if the GPIO has just left batch callbacks */
+
+         if (cb.func && cb.batch)
+         {
+            (cb.func)(b, alertBatchCount[b],
+               alertBatchTick[b], alertBatchLevel[b], cb.userdata);
+         }
+
+         alertBatchCount[b] = 0;
+      }
+   }
+
+   /* wake the dispatchers of the GPIO queued above */
+
+   if (wakeBits || wakePatterns)
+   {
+      for (n=0; n<alertThreads; n++)
+      {
+         if ((wakeBits & alertDispatch[n].bits) ||
+             (wakePatterns && alertDispatch[n].patterns))
+            sem_post(&alertDispatch[n].sem);
+      }
+   }
+
+   /* build the reports of the level changes of the notified GPIO once,
+      each notification then selects the reports of its own GPIO */
+
+   notifyChanges = 0;
+
+   for (n=0; n<PI_NOTIFY_SLOTS; n++)
+   {
+      if (gpioNotify[n].state == PI_NOTIFY_RUNNING)
+         notifyChanges |= gpioNotify[n].bits;
+   }
+
+   numReports = 0;
+   allChanges = 0;
+
+   if (changedBits & notifyChanges)
+   {
+      oldLevel = reportedLevel & notifyChanges;
+
+      for (d=0; d<numSamples; d++)
+      {
+         newLevel = sample[d].level & notifyChanges;
+
+         if (newLevel != oldLevel)
+         {
+            reportChanges[numReports] = newLevel ^ oldLevel;
+            allChanges |= reportChanges[numReports];
+
+            report[numReports].flags = 0;
+            report[numReports].tick  = sample[d].tick;
+            report[numReports].level = sample[d].level;
+
+            oldLevel = newLevel;
+
+            numReports++;
+         }
+      }
+   }
+
+   if (numSamples)
+      newLevel = sample[numSamples-1].level;
+   else
+      newLevel = reportedLevel;
+
+   queued = 0;
+
+   now = systReg[SYST_CLO];
+
+   if (notifyShmClosing) alertNotifyShmRelease();
+
+   for (n=0; n<PI_NOTIFY_SLOTS; n++)
+   {
+      if (gpioNotify[n].state >= PI_NOTIFY_OPENED)
+      {
+         bits = gpioNotify[n].bits;
+
+         emit = 0;
+         extra = 0;
+         iovcnt = 0;
+
+         seqno = gpioNotify[n].seqno;
+
+         hLevel = newLevel;
+
+         if (gpioNotify[n].state == PI_NOTIFY_RUNNING)
+         {
+            rising  = bits & gpioNotify[n].risingBits;
+            falling = bits & gpioNotify[n].fallingBits;
+
+            if (((rising & falling) != bits) || gpioNotify[n].steadyUs)
+            {
+               /* a notification with its own glitch filter or edge
+                  selection.  A GPIO reported on one edge only shows
+                  that edge as a level change, its level is reported
+                  as the level before the edge except in the report
+                  of the edge itself.
+               */
+
+               risingOnly  = rising & ~falling;
+               fallingOnly = falling & ~rising;
+
+               if (gpioNotify[n].steadyUs)
+               {
+                  num = alertNotifyGlitch(n, sample, numSamples, eTick,
+                     glitchReport, glitchChanges);
+
+                  src = glitchReport;
+                  srcChanges = glitchChanges;
+
+                  hLevel = (newLevel & ~bits) | gpioNotify[n].gReported;
+               }
+               else
+               {
+                  num = numReports;
+                  src = report;
+                  srcChanges = reportChanges;
+               }
+
+               for (d=0; d<num; d++)
+               {
+                  changes = srcChanges[d] & bits;
+                  level   = src[d].level;
+
+                  if ((changes & level & rising) | (changes & ~level & falling))
+                  {
+                     gather[emit] = src[d];
+                     gather[emit].seqno = seqno++;
+                     gather[emit].level = (level & ~(risingOnly & ~changes)) |
+                                          (fallingOnly & ~changes);
+                     emit++;
+                  }
+               }
+
+               if (emit)
+               {
+                  iov[iovcnt].iov_base = gather;
+                  iov[iovcnt].iov_len = emit * sizeof(gpioReport_t);
+                  iovcnt++;
+               }
+
+               hLevel = (hLevel & ~risingOnly) | fallingOnly;
+            }
+            else if (allChanges & bits)
+            {
+               /* select the shared reports which changed at least one
+                  of this notification's GPIO.  If every report is
+                  wanted they are sequence numbered and written in
+                  place, otherwise the wanted ones are gathered.
+               */
+
+               if (allChanges & ~bits)
+               {
+                  for (d=0; d<numReports; d++)
+                  {
+                     if (reportChanges[d] & bits)
+                     {
+                        gather[emit] = report[d];
+                        gather[emit].seqno = seqno++;
+                        emit++;
+                     }
+                  }
+
+                  iov[iovcnt].iov_base = gather;
+               }
+               else
+               {
+                  for (d=0; d<numReports; d++) report[d].seqno = seqno++;
+
+                  emit = numReports;
+
+                  iov[iovcnt].iov_base = report;
+               }
+
+               iov[iovcnt].iov_len = emit * sizeof(gpioReport_t);
+               iovcnt++;
+            }
+
+            /* check to see if any watchdogs are due for this
+               notification.
+
+               bits        is the set of notification bits
+               timeoutBits is the set of timed out bits
+            */
+
+            todo = timeoutBits & bits;
+
+            while (todo)
+            {
+               b = __builtin_ctz(todo);
+               todo &= (todo - 1);
+
+               extraReport[extra].seqno = seqno;
+               extraReport[extra].flags =
+                  PI_NTFY_FLAGS_WDOG | PI_NTFY_FLAGS_BIT(b);
+               extraReport[extra].tick  = eTick;
+               extraReport[extra].level = hLevel;
+
+               extra++;
+               seqno++;
+            }
+         }
+
+         /* check to see if any events are due
+
+            eventBits is the set of events
+         */
+
+         todo = eventBits & gpioNotify[n].eventBits;
+
+         while (todo)
+         {
+            b = __builtin_ctz(todo);
+            todo &= (todo - 1);
+
+            extraReport[extra].seqno = seqno;
+            extraReport[extra].flags = 
+               PI_NTFY_FLAGS_EVENT | PI_NTFY_FLAGS_BIT(b);
+            extraReport[extra].tick  = eTick;
+            extraReport[extra].level = hLevel;
+
+            extra++;
+            seqno++;
+         }
+
+         /* pattern events carry the tick and level of their sample */
+
+         pattern = 0;
+
+         todo = firedBits & gpioNotify[n].eventBits;
+
+         if (todo)
+         {
+            for (d=0; d<numSamples; d++)
+            {
+               events = patternFired[d] & todo;
+
+               while (events)
+               {
+                  b = __builtin_ctz(events);
+                  events &= (events - 1);
+
+                  if (pattern < MAX_REPORT)
+                  {
+                     patternReport[pattern].seqno = seqno++;
+                     patternReport[pattern].flags =
+                        PI_NTFY_FLAGS_EVENT | PI_NTFY_FLAGS_BIT(b);
+                     patternReport[pattern].tick  = sample[d].tick;
+                     patternReport[pattern].level = sample[d].level;
+
+                     pattern++;
+                  }
+                  else gpioNotify[n].overflow++;
+               }
+            }
+         }
+
+         if (!emit && !extra && !pattern)
+         {
+            if ((int)(eTick - gpioNotify[n].lastReportTick) > 60000000)
+            {
+               extraReport[extra].seqno = seqno;
+               extraReport[extra].flags = PI_NTFY_FLAGS_ALIVE;
+               extraReport[extra].tick  = eTick;
+               extraReport[extra].level = hLevel;
+
+               extra++;
+               seqno++;
+            }
+         }
+
+         if (extra)
+         {
+            iov[iovcnt].iov_base = extraReport;
+            iov[iovcnt].iov_len  = extra * sizeof(gpioReport_t);
+            iovcnt++;
+
+            emit += extra;
+         }
+
+         if (pattern)
+         {
+            iov[iovcnt].iov_base = patternReport;
+            iov[iovcnt].iov_len  = pattern * sizeof(gpioReport_t);
+            iovcnt++;
+
+            emit += pattern;
+         }
+
+         if (emit)
+         {
+            DBG(DBG_FAST_TICK, "notification %d (%d reports, %x-%x)",
+               n, emit, gpioNotify[n].seqno, (uint16_t)(seqno-1));
+
+            gpioNotify[n].lastReportTick = eTick;
+
+            if (emit > gpioStats.maxEmit) gpioStats.maxEmit = emit;
+
+            if (gpioNotify[n].shm)
+            {
+               alertNotifyShm(n, iov, iovcnt);
+            }
+            else
+            {
+               alertNotifyQueue(n, iov, iovcnt);
+
+               queued = 1;
+            }
+
+            gpioNotify[n].seqno = seqno;
+         }
+      }
+   }
+
+   if (queued) notifyWake();
+
+   if (changedBits & scriptBits)
+   {
+      for (n=0; n<PI_MAX_SCRIPTS; n++)
+      {
+         if ((gpioScript[n].state     == PI_SCRIPT_IN_USE)  &&
+             (gpioScript[n].run_state == PI_SCRIPT_WAITING) &&
+             (gpioScript[n].waitBits & changedBits))
+         {
+            pthread_mutex_lock(&gpioScript[n].pthMutex);
+
+            if (gpioScript[n].run_state == PI_SCRIPT_WAITING)
+            {
+               gpioScript[n].changedBits =
+                  gpioScript[n].waitBits & changedBits;
+               pthread_cond_signal(&gpioScript[n].pthCond);
+
+               if (numSamples)
+                  statsLatency(PI_LATENCY_SCRIPT, now, sample[0].tick);
+            }
+
+            pthread_mutex_unlock(&gpioScript[n].pthMutex);
+         }
+      }
+   }
+
+   eventBits |= firedBits;
+
+   if (eventBits & scriptEventBits)
+   {
+      for (n=0; n<PI_MAX_SCRIPTS; n++)
+      {
+         if ((gpioScript[n].state     == PI_SCRIPT_IN_USE)  &&
+             (gpioScript[n].run_state == PI_SCRIPT_WAITING) &&
+             (gpioScript[n].eventBits & eventBits))
+         {
+            pthread_mutex_lock(&gpioScript[n].pthMutex);
+
+            if (gpioScript[n].run_state == PI_SCRIPT_WAITING)
+            {
+               gpioScript[n].changedBits =
+                  gpioScript[n].eventBits & eventBits;
+               pthread_cond_signal(&gpioScript[n].pthCond);
+            }
+
+            pthread_mutex_unlock(&gpioScript[n].pthMutex);
+         }
+      }
+   }
+
+   if (numSamples) reportedLevel = sample[numSamples-1].level;
+}
+
+static void alertWdogCheck(gpioSample_t *sample, int numSamples)
+{
+   /*
+   Go through and set the last time each GPIO with a watchdog changed state.
+   */
+
+   int i, j;
+   uint32_t LBitV;
+   uint32_t bit, todo;
+
+   todo = monitorBits & wdogBits;
+
+   while (todo)
+   {
+      i = __builtin_ctz(todo);
+      todo &= (todo - 1);
+
+      bit = (1<<i);
+
+      LBitV = gpioAlert[i].wdLBitV;
+
+      for (j=0; j<numSamples; j++)
+      {
+         if ((sample[j].level & bit) != LBitV)
+         {
+            LBitV = sample[j].level & bit;
+            gpioAlert[i].wdTick = sample[j].tick;
+         }
+      }
+
+      gpioAlert[i].wdLBitV = LBitV;
+   }
+}
+
+static void notifyWake(void)
+{
+   uint64_t one = 1;
+
+   if (__atomic_exchange_n(&notifySleeping, 0, __ATOMIC_SEQ_CST))
+   {
+      if (write(notifyWakeFd, &one, sizeof(one)) != sizeof(one))
+         DBG(DBG_INTERNAL, "notify wake failed (%m)");
+   }
+}
+
+static void notifyCloseSlot(int n)
+{
+   char fifo[32];
+
+   if (gpioNotify[n].pipe)
+   {
+      DBG(DBG_INTERNAL, "close notify pipe %d", gpioNotify[n].fd);
+      close(gpioNotify[n].fd);
+
+      sprintf(fifo, "/dev/pigpio%d", n);
+
+      unlink(fifo);
+   }
+
+   if (gpioNotify[n].fd < 0) /* shared memory */
+   {
+      /* the alert thread may still be writing to it */
+
+      if (__atomic_load_n(&gpioNotify[n].shm, __ATOMIC_ACQUIRE)) return;
+
+      sprintf(fifo, "/pigpio%d", n);
+
+      shm_unlink(fifo);
+
+      close(gpioNotify[n].efd);
+   }
+
+   if (gpioNotify[n].overflow)
+      DBG(DBG_USER, "notify %d dropped %u reports",
+         n, gpioNotify[n].overflow);
+
+   /* a socket released by its closed connection, only closed here
+      so the fd can't be reused while this thread may write to it */
+
+   notifyMutex(1);
+
+   if (gpioNotify[n].closeFd)
+   {
+      DBG(DBG_INTERNAL, "close notify socket %d", gpioNotify[n].fd);
+      close(gpioNotify[n].fd);
+      gpioNotify[n].closeFd = 0;
+   }
+
+   gpioNotify[n].state = PI_NOTIFY_CLOSED;
+
+   notifyMutex(0);
+}
+
+static void notifyCountStamps(int n, uint32_t tail)
+{
+   gpioNotify_t *p = &gpioNotify[n];
+   notifyStamp_t *s;
+   uint32_t next, head, now;
+
+   /* a report's latency ends when its last byte has been written */
+
+   now  = systReg[SYST_CLO];
+   next = p->sTail;
+   head = __atomic_load_n(&p->sHead, __ATOMIC_ACQUIRE);
+
+   while (next != head)
+   {
+      s = &notifyStamp[n][next & (NOTIFY_STAMPS - 1)];
+
+      if ((int32_t)(tail - s->end) < 0) break;
+
+      statsLatency(PI_LATENCY_NOTIFY, now, s->tick);
+
+      next++;
+   }
+
+   __atomic_store_n(&p->sTail, next, __ATOMIC_RELEASE);
+}
+
+static int notifyFlush(int n)
+{
+   gpioNotify_t *p = &gpioNotify[n];
+   struct iovec iov[2];
+   struct msghdr msg;
+   uint32_t head, tail, len, off, maxLen;
+   int err, cnt;
+
+   /* write the queued reports, a partial write is retried from where
+      it stopped.  Returns 1 if the fd can't take any more for now. */
+
+   maxLen = p->max_emits * sizeof(gpioReport_t);
+
+   tail = p->qTail;
+   head = __atomic_load_n(&p->qHead, __ATOMIC_ACQUIRE);
+
+   while (tail != head)
+   {
+      len = head - tail;
+
+      if (len > maxLen)
+      {
+         gpioStats.emitFrags++;
+         len = maxLen;
+      }
+
+      off = tail & (NOTIFY_QUEUE_BYTES - 1);
+
+      iov[0].iov_base = notifyQueue[n] + off;
+      iov[0].iov_len  = len;
+      cnt = 1;
+
+      if (len > (NOTIFY_QUEUE_BYTES - off))
+      {
+         iov[0].iov_len  = NOTIFY_QUEUE_BYTES - off;
+         iov[1].iov_base = notifyQueue[n];
+         iov[1].iov_len  = len - iov[0].iov_len;
+         cnt = 2;
+      }
+
+      if (p->pipe)
+      {
+         err = writev(p->fd, iov, cnt);
+      }
+      else
+      {
+         /* the socket is shared with the command reader so must
+            stay blocking, don't wait here though */
+
+         memset(&msg, 0, sizeof(msg));
+         msg.msg_iov    = iov;
+         msg.msg_iovlen = cnt;
+
+         err = sendmsg(p->fd, &msg, MSG_DONTWAIT);
+      }
+
+      if (err < 0)
+      {
+         if (errno == EINTR) continue;
+
+         if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+         {
+            gpioStats.wouldBlockPipeWrite++;
+            return 1;
+         }
+
+         /* serious error, no point continuing */
+
+         DBG(DBG_ALWAYS, "fd=%d err=%d errno=%d", p->fd, err, errno);
+
+         DBG(DBG_ALWAYS, "%s", strerror(errno));
+
+         p->bits  = 0;
+         p->state = PI_NOTIFY_CLOSING;
+         intNotifyBits();
+         return 0;
+      }
+
+      tail += err;
+
+      __atomic_store_n(&p->qTail, tail, __ATOMIC_RELEASE);
+
+      notifyCountStamps(n, tail);
+
+      if (err != len)
+      {
+         gpioStats.shortPipeWrite++;
+         return 1;
+      }
+
+      gpioStats.goodPipeWrite++;
+   }
+
+   return 0;
+}
+
+static int notifyPending(uint32_t blocked)
+{
+   int n;
+
+   for (n=0; n<PI_NOTIFY_SLOTS; n++)
+   {
+      if ((gpioNotify[n].state == PI_NOTIFY_CLOSING) &&
+          (__atomic_load_n(&gpioNotify[n].shm, __ATOMIC_ACQUIRE) == NULL))
+         return 1;
+
+      if ((gpioNotify[n].state >= PI_NOTIFY_OPENED) &&
+          (!(blocked & (1<<n))) &&
+          (gpioNotify[n].qTail !=
+             __atomic_load_n(&gpioNotify[n].qHead, __ATOMIC_ACQUIRE)))
+         return 1;
+   }
+
+   return 0;
+}
+
+static void * pthNotifyThread(void *x)
+{
+   struct pollfd pfd[PI_NOTIFY_SLOTS+1];
+   uint64_t count;
+   uint32_t blocked;
+   int n, num;
+
+   /* writes the reports queued by the alert thread to the
+      notification pipes and sockets, and closes handles */
+
+   while (1)
+   {
+      pfd[0].fd     = notifyWakeFd;
+      pfd[0].events = POLLIN;
+      num = 1;
+
+      blocked = 0;
+
+      for (n=0; n<PI_NOTIFY_SLOTS; n++)
+      {
+         if (gpioNotify[n].state == PI_NOTIFY_CLOSING)
+         {
+            notifyCloseSlot(n);
+         }
+         else if (gpioNotify[n].state >= PI_NOTIFY_OPENED)
+         {
+            if (notifyFlush(n))
+            {
+               /* wait for the consumer to catch up */
+
+               pfd[num].fd     = gpioNotify[n].fd;
+               pfd[num].events = POLLOUT;
+               num++;
+
+               blocked |= (1<<n);
+            }
+         }
+      }
+
+      __atomic_store_n(&notifySleeping, 1, __ATOMIC_SEQ_CST);
+
+      if (notifyPending(blocked))
+      {
+         __atomic_store_n(&notifySleeping, 0, __ATOMIC_SEQ_CST);
+         continue;
+      }
+
+      /* time out to pick up closes of blocked handles */
+
+      if (poll(pfd, num, 1000) > 0)
+      {
+         if (pfd[0].revents & POLLIN)
+         {
+            if (read(notifyWakeFd, &count, sizeof(count)) < 0)
+               DBG(DBG_INTERNAL, "notify wake read failed (%m)");
+         }
+      }
+
+      __atomic_store_n(&notifySleeping, 0, __ATOMIC_SEQ_CST);
+   }
+
+   return NULL;
+}
+
+static uint32_t alertLatency(void)
+{
+   /* the smallest latency (us) of the active alerts and
+      notifications, 0 if none has one */
+
+   uint32_t latency, bits;
+   int b, n;
+
+   latency = 0xFFFFFFFF;
+
+   bits = alertBits;
+
+   while (bits)
+   {
+      b = __builtin_ctz(bits);
+      bits &= (bits - 1);
+
+      if (gpioAlert[b].latency && (gpioAlert[b].latency < latency))
+         latency = gpioAlert[b].latency;
+   }
+
+   for (n=0; n<PI_NOTIFY_SLOTS; n++)
+   {
+      if ((gpioNotify[n].state == PI_NOTIFY_RUNNING) &&
+          gpioNotify[n].latency && (gpioNotify[n].latency < latency))
+         latency = gpioNotify[n].latency;
+   }
+
+   if (latency == 0xFFFFFFFF) latency = 0;
+
+   return latency;
+}
+
+static void * pthAlertThread(void *x)
+{
+   struct timespec req, rem;
+   uint32_t oldLevel, newLevel, level;
+   uint32_t oldSlot,  newSlot;
+   uint32_t expected, ft, sTick;
+   uint32_t changedBits;
+   int32_t diff, minDiff, stickInited;
+   int cycle, pulse;
+   int numSamples, ticks, i;
+   int rp, reports, totalSamples;
+   int stopped;
+   int moreToDo;
+   uint32_t busyNs, idleNs, sleepNs, latency;
+   gpioSample_t sample[MAX_SAMPLE];
+
+   req.tv_sec = 0;
+
+   sleepNs = 0;
+
+   /* don't start until DMA started */
+
+   spinWhileStarting();
+
+   reportedLevel = gpioReg[GPLEV0];
+
+   oldLevel = reportedLevel;
+
+   oldSlot = dmaCurrentSlot(dmaNowAtICB());
+
+   oldSlot = (oldSlot / PULSE_PER_CYCLE) * PULSE_PER_CYCLE;
+
+   cycle = (oldSlot/PULSE_PER_CYCLE);
+
+   pulse = 0;
+
+   stopped = 0;
+
+   moreToDo = 0;
+
+   stickInited = 0;
+
+   sTick = 0;
+
+   minDiff = gpioCfg.clockMicros / 2;
+
+   while (1)
+   {
+      /* Check that DMA is running okay */
+
+      if (dmaIn[DMA_CONBLK_AD])
+      {
+         if (stopped)
+         {
+            DBG(DBG_STARTUP, "****** GOING ******");
+            stopped = 0;
+         }
+      }
+      else
+      {
+         stopped = 1;
+
+         myGpioDelay(5000);
+
+         if (runState == PI_RUNNING)
+         {
+            /* should never be executed, leave code just in case */
+
+            gpioCfg.internals |= PI_CFG_STATS;
+
+            dmaInitCbs();
+            flushMemory();
+            initDMAgo((uint32_t *)dmaIn, (uint32_t)dmaIBus[0]);
+            myGpioDelay(5000); /* let DMA run for a while */
+            oldSlot = dmaCurrentSlot(dmaNowAtICB());
+            gpioStats.DMARestarts++;
+         }
+      }
+
+      newSlot = dmaCurrentSlot(dmaNowAtICB());
+
+      newSlot = (newSlot / PULSE_PER_CYCLE) * PULSE_PER_CYCLE;
+
+      numSamples = 0;
+
+      /*
+      Extract samples from DMA ring buffer.
+      */
+
+      while ((oldSlot != newSlot) && (numSamples < MAX_SAMPLE))
+      {
+         level = myGetLevel(oldSlot++);
+
+         sample[numSamples].tick  = sTick;
+         sample[numSamples].level = level;
+
+         numSamples++;
+
+         sTick += gpioCfg.clockMicros;
+
+         if (++pulse >= PULSE_PER_CYCLE)
+         {
+            pulse = 0;
+
+            if (++cycle >= bufferCycles)
+            {
+               cycle = 0;
+               oldSlot = 0;
+            }
+
+            expected = sTick;
+
+            sTick = myGetTick(cycle);
+
+            if (stickInited)
+            {
+               diff = sTick - expected;
+
+               if (abs(diff) > minDiff)
+               {
+                  ft = sample[numSamples-PULSE_PER_CYCLE].tick;
+
+                  ticks = sTick - ft;
+
+                  for (i=1; i<PULSE_PER_CYCLE; i++)
+                  {
+                     sample[numSamples-PULSE_PER_CYCLE+i].tick =
+                        ((i*ticks)/PULSE_PER_CYCLE) + ft;
+                  }
+               }
+
+               diff += (TICKSLOTS/2);
+
+               if (diff < 0)
+               {
+                  gpioStats.diffTick[0]++;
+               }
+
+               else if (diff >= TICKSLOTS)
+               {
+                  gpioStats.diffTick[TICKSLOTS-1]++;
+               }
+
+               else gpioStats.diffTick[diff]++;
+            }
+            else
+            {
+               stickInited = 1;
+               numSamples = 0;
+               pthAlertRunning = PI_THREAD_RUNNING;
+            }
+         }
+      }
+
+      if (oldSlot == newSlot) moreToDo = 0; else moreToDo = 1;
+
+      /* Apply glitch filter */
+
+      if (numSamples && gFilterBits) alertGlitchFilter(sample, numSamples);
+
+      /* Apply noise filter */
+
+      if (numSamples && nFilterBits) alertNoiseFilter(sample, numSamples);
+
+      /* Compact samples */
+
+      changedBits = 0;
+      oldLevel &= monitorBits;
+      reports = 0;
+      totalSamples = 0;
+
+      for (rp=0; rp<numSamples; rp++)
+      {
+         newLevel = (sample[rp].level & monitorBits);
+
+         if (newLevel != oldLevel)
+         {
+            sample[reports].tick  = sample[rp].tick;
+            sample[reports].level = sample[rp].level;
+            changedBits |= (newLevel ^ oldLevel);
+            oldLevel = newLevel;
+
+            reports++;
+
+            if (reports >= MAX_REPORT)
+            {
+               totalSamples += reports;
+
+               /* Rebase watchdog timeouts */
+               if (wdogBits) alertWdogCheck(sample, reports);
+
+               gpioStats.numSamples += reports;
+
+               alertEmit(sample, reports, changedBits, sample[rp].tick);
+
+               changedBits = 0;
+               reports = 0;
+            }
+         }
+      }
+
+      if (reports)
+      {
+         totalSamples += reports;
+
+         /* Rebase watchdog timeouts */
+         if (wdogBits) alertWdogCheck(sample, reports);
+
+         gpioStats.numSamples += reports;
+      }
+
+      alertEmit(sample, reports, changedBits, sTick);
+
+      if (totalSamples > gpioStats.maxSamples)
+         gpioStats.maxSamples = numSamples;
+
+      /* choose the delay before the next pass */
+
+      busyNs = alert_delays[(gpioCfg.internals>>PI_CFG_ALERT_FREQ)&15];
+      idleNs = busyNs * ALERT_MAX_BACKOFF;
+
+      /* watchdogs time out at the end of a pass and the DMA ring
+         must be read before it wraps */
+
+      if (wdogBits) idleNs = busyNs;
+
+      if (idleNs > (gpioCfg.bufferMilliseconds * 250000))
+         idleNs = gpioCfg.bufferMilliseconds * 250000;
+
+      latency = alertLatency();
+
+      if (latency)
+      {
+         if ((latency * 1000) < busyNs) busyNs = latency * 1000;
+         if ((latency * 1000) < idleNs) idleNs = latency * 1000;
+      }
+
+      if (busyNs < (PULSE_PER_CYCLE * gpioCfg.clockMicros * 1000))
+         busyNs = PULSE_PER_CYCLE * gpioCfg.clockMicros * 1000;
+
+      if (idleNs < busyNs) idleNs = busyNs;
+
+      if (totalSamples || (sleepNs < busyNs))
+      {
+         sleepNs = busyNs;
+      }
+      else
+      {
+         sleepNs *= 2;
+
+         if (sleepNs > idleNs) sleepNs = idleNs;
+
+         if (sleepNs > busyNs) gpioStats.alertIdle++;
+      }
+
+      req.tv_sec = 0;
+      req.tv_nsec = sleepNs;
+
+      if (moreToDo)
+      {
+         gpioStats.moreToDo++;
+      }
+      else
+      {
+         gpioStats.alertTicks++;
+
+         while (nanosleep(&req, &rem))
+         {
+            req.tv_sec  = rem.tv_sec;
+            req.tv_nsec = rem.tv_nsec;
+         }
+      }
+   }
+
+   return 0;
+}
+
+/* ======================================================================= */
+
+static int scrPop(gpioScript_t *s, int *SP, int *S)
+{
+   if ((*SP) > 0)
+   {
+      return S[--(*SP)];
+   }
+   else
+   {
+      s->run_state = PI_SCRIPT_FAILED;
+      DBG(DBG_ALWAYS, "script %d too many pops", s->id);
+      return 0;
+   }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void scrPush(gpioScript_t *s, int *SP, int *S, int val)
+{
+   if ((*SP) < PI_SCRIPT_STACK_SIZE)
+   {
+      S[(*SP)++] = val;
+   }
+   else
+   {
+      s->run_state = PI_SCRIPT_FAILED;
+      DBG(DBG_ALWAYS, "script %d too many pushes", s->id);
+   }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void scrSwap(int *v1, int *v2)
+{
+   int t;
+
+   t=*v1; *v1=*v2; *v2= t;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int scrEvtWait(gpioScript_t *s, uint32_t bits)
+{
+   pthread_mutex_lock(&s->pthMutex);
+
+   if (s->request == PI_SCRIPT_RUN)
+   {
+      s->run_state = PI_SCRIPT_WAITING;
+      s->eventBits = bits;
+      intScriptEventBits();
+
+      pthread_cond_wait(&s->pthCond, &s->pthMutex);
+
+      s->waitBits = 0;
+      intScriptEventBits();
+      s->run_state = PI_SCRIPT_RUNNING;
+   }
+
+   pthread_mutex_unlock(&s->pthMutex);
+
+   return s->changedBits;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int scrWait(gpioScript_t *s, uint32_t bits)
+{
+   pthread_mutex_lock(&s->pthMutex);
+
+   if (s->request == PI_SCRIPT_RUN)
+   {
+      s->run_state = PI_SCRIPT_WAITING;
+      s->waitBits = bits;
+      intScriptBits();
+
+      pthread_cond_wait(&s->pthCond, &s->pthMutex);
+
+      s->waitBits = 0;
+      intScriptBits();
+      s->run_state = PI_SCRIPT_RUNNING;
+   }
+
+   pthread_mutex_unlock(&s->pthMutex);
+
+   return s->changedBits;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int scrSys(char *cmd, uint32_t p1, uint32_t p2)
+{
+   char buf[1024];
+   int status;
+
+   if (!myScriptNameValid(cmd))
+      SOFT_ERROR(PI_BAD_SCRIPT_NAME, "bad script name (%s)", cmd);
+
+   snprintf(buf, sizeof(buf), "/opt/pigpio/cgi/%s %u %u", cmd, p1, p2);
+
+   DBG(DBG_USER, "%s", buf);
+
+   status = system(buf);
+
+   if (status < 0) status = PI_BAD_SHELL_STATUS;
+
+   return status;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int scrPermitWrite(unsigned gpio, unsigned level)
+{
+   if (myPermit(gpio)) return gpioWrite(gpio, level);
+
+   DBG(DBG_USER, "gpioWrite: gpio %d, no permission to update", gpio);
+
+   return PI_NOT_PERMITTED;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int scrDelay(uint32_t delay, uint32_t max, uint32_t scale, int err)
+{
+   if (delay > max) return err;
+
+   myGpioDelay(delay * scale);
+
+   return 0;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int *scrOperand(cmdScript_t *sc, int opt, uint32_t p, int *k)
+{
+   if (opt == CMD_VAR) return &sc->var[p];
+   if (opt == CMD_PAR) return &sc->par[p];
+
+   *k = p;
+
+   return k;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int *scrRegister(cmdScript_t *sc, int opt, uint32_t p)
+{
+   /* a register operand given as a number is that variable */
+
+   if (opt == CMD_PAR) return &sc->par[p];
+
+   return &sc->var[p];
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int scrFuse(int kind, int next)
+{
+   /* pairs common in bit-banging loops run as one instruction */
+
+   switch (kind)
+   {
+      case PI_CMD_WRITE:
+         if (next == PI_CMD_MICS) return SCR_OP_W_MICS;
+         if (next == PI_CMD_MILS) return SCR_OP_W_MILS;
+         break;
+
+      case PI_CMD_READ:
+         if (next == PI_CMD_JZ)   return SCR_OP_R_JZ;
+         if (next == PI_CMD_JNZ)  return SCR_OP_R_JNZ;
+         break;
+
+      case PI_CMD_DCR:
+         if (next == PI_CMD_JNZ)  return SCR_OP_DCR_JNZ;
+         if (next == PI_CMD_JP)   return SCR_OP_DCR_JP;
+         break;
+   }
+
+   return kind;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static scrOp_t *scrCompile(cmdScript_t *sc)
+{
+   scrOp_t *op;
+   cmdInstr_t *in;
+   int i, n;
+
+   n = sc->instrs;
+
+   /* one op per instruction so any instruction may be jumped to,
+      plus one which ends the script */
+
+   op = calloc(n+1, sizeof(scrOp_t));
+
+   if (op == NULL) return NULL;
+
+   for (i=0; i<n; i++)
+   {
+      in = &sc->instr[i];
+
+      op[i].instr = in;
+      op[i].kind  = in->p[0];
+
+      op[i].a1 = scrOperand(sc, in->opt[1], in->p[1], &op[i].k1);
+      op[i].a2 = scrOperand(sc, in->opt[2], in->p[2], &op[i].k2);
+
+      switch (in->p[0])
+      {
+         case PI_CMD_X:
+            op[i].a2 = scrRegister(sc, in->opt[2], in->p[2]);
+            /* fall through */
+
+         case PI_CMD_DCR:
+         case PI_CMD_INR:
+         case PI_CMD_LD:
+         case PI_CMD_POP:
+         case PI_CMD_PUSH:
+         case PI_CMD_RL:
+         case PI_CMD_RR:
+         case PI_CMD_STA:
+         case PI_CMD_XA:
+            op[i].a1 = scrRegister(sc, in->opt[1], in->p[1]);
+            break;
+
+         case PI_CMD_CALL:
+         case PI_CMD_JM:
+         case PI_CMD_JMP:
+         case PI_CMD_JNZ:
+         case PI_CMD_JP:
+         case PI_CMD_JZ:
+            /* tags were resolved to steps by cmdParseScript */
+            if (in->p[1] < n) op[i].jump = &op[in->p[1]];
+            else              op[i].jump = &op[n];
+            break;
+      }
+
+      if (i < (n-1)) op[i].kind = scrFuse(in->p[0], sc->instr[i+1].p[0]);
+   }
+
+   op[n].kind = SCR_OP_END;
+
+   return op;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void *pthScript(void *x)
+{
+   gpioScript_t *s;
+   scrOp_t *op, *op0;
+   uint32_t p[5];
+   int i, A, F, SP;
+   int S[PI_SCRIPT_STACK_SIZE];
+   char buf[CMD_MAX_EXTENSION];
+
+
+   S[0] = 0; /* to prevent compiler warning */
+
+   s = x;
+
+   op0 = s->op;
+
+   /* link each op to its handler, labels only exist in this function */
+
+   for (i=0; i<=s->script.instrs; i++)
+   {
+      switch (op0[i].kind)
+      {
+         case PI_CMD_ADD:     op0[i].code = &&ADD;     break;
+         case PI_CMD_AND:     op0[i].code = &&AND;     break;
+         case PI_CMD_CALL:    op0[i].code = &&CALL;    break;
+         case PI_CMD_CMP:     op0[i].code = &&CMP;     break;
+         case PI_CMD_DCR:     op0[i].code = &&DCR;     break;
+         case PI_CMD_DCRA:    op0[i].code = &&DCRA;    break;
+         case PI_CMD_DIV:     op0[i].code = &&DIV;     break;
+         case PI_CMD_EVTWT:   op0[i].code = &&EVTWT;   break;
+         case PI_CMD_HALT:    op0[i].code = &&HALT;    break;
+         case PI_CMD_INR:     op0[i].code = &&INR;     break;
+         case PI_CMD_INRA:    op0[i].code = &&INRA;    break;
+         case PI_CMD_JM:      op0[i].code = &&JM;      break;
+         case PI_CMD_JMP:     op0[i].code = &&JMP;     break;
+         case PI_CMD_JNZ:     op0[i].code = &&JNZ;     break;
+         case PI_CMD_JP:      op0[i].code = &&JP;      break;
+         case PI_CMD_JZ:      op0[i].code = &&JZ;      break;
+         case PI_CMD_LD:      op0[i].code = &&LD;      break;
+         case PI_CMD_LDA:     op0[i].code = &&LDA;     break;
+         case PI_CMD_LDAB:    op0[i].code = &&LDAB;    break;
+         case PI_CMD_MLT:     op0[i].code = &&MLT;     break;
+         case PI_CMD_MOD:     op0[i].code = &&MOD;     break;
+         case PI_CMD_OR:      op0[i].code = &&OR;      break;
+         case PI_CMD_POP:     op0[i].code = &&POP;     break;
+         case PI_CMD_POPA:    op0[i].code = &&POPA;    break;
+         case PI_CMD_PUSH:    op0[i].code = &&PUSH;    break;
+         case PI_CMD_PUSHA:   op0[i].code = &&PUSHA;   break;
+         case PI_CMD_RET:     op0[i].code = &&RET;     break;
+         case PI_CMD_RL:      op0[i].code = &&RL;      break;
+         case PI_CMD_RLA:     op0[i].code = &&RLA;     break;
+         case PI_CMD_RR:      op0[i].code = &&RR;      break;
+         case PI_CMD_RRA:     op0[i].code = &&RRA;     break;
+         case PI_CMD_STA:     op0[i].code = &&STA;     break;
+         case PI_CMD_STAB:    op0[i].code = &&STAB;    break;
+         case PI_CMD_SUB:     op0[i].code = &&SUB;     break;
+         case PI_CMD_SYS:     op0[i].code = &&SYS;     break;
+         case PI_CMD_WAIT:    op0[i].code = &&WAIT;    break;
+         case PI_CMD_X:       op0[i].code = &&X;       break;
+         case PI_CMD_XA:      op0[i].code = &&XA;      break;
+         case PI_CMD_XOR:     op0[i].code = &&XOR;     break;
+
+         case PI_CMD_READ:    op0[i].code = &&READ;    break;
+         case PI_CMD_WRITE:   op0[i].code = &&WRITE;   break;
+         case PI_CMD_MICS:    op0[i].code = &&MICS;    break;
+         case PI_CMD_MILS:    op0[i].code = &&MILS;    break;
+
+         case SCR_OP_W_MICS:  op0[i].code = &&W_MICS;  break;
+         case SCR_OP_W_MILS:  op0[i].code = &&W_MILS;  break;
+         case SCR_OP_R_JZ:    op0[i].code = &&R_JZ;    break;
+         case SCR_OP_R_JNZ:   op0[i].code = &&R_JNZ;   break;
+         case SCR_OP_DCR_JNZ: op0[i].code = &&DCR_JNZ; break;
+         case SCR_OP_DCR_JP:  op0[i].code = &&DCR_JP;  break;
+
+         case SCR_OP_END:     op0[i].code = &&END;     break;
+
+         default:
+            if (op0[i].kind < PI_CMD_SCRIPT) op0[i].code = &&CMD;
+            else                             op0[i].code = &&NOP;
+      }
+   }
+
+   /* each handler runs its instruction then dispatches the next */
+
+   #define SCR_NEXT(next)                                         \
+      do                                                          \
+      {                                                           \
+         op = (next);                                             \
+         if (((*(volatile unsigned *)&s->request) != PI_SCRIPT_RUN) \
+            || (s->run_state != PI_SCRIPT_RUNNING)) goto STOP;    \
+         goto *op->code;                                          \
+      }                                                           \
+      while (0)
+
+   while ((volatile int)s->request != PI_SCRIPT_DELETE)
+   {
+      pthread_mutex_lock(&s->pthMutex);
+      s->run_state = PI_SCRIPT_HALTED;
+      pthread_cond_wait(&s->pthCond, &s->pthMutex);
+      pthread_mutex_unlock(&s->pthMutex);
+
+      s->run_state = PI_SCRIPT_RUNNING;
+
+      A  = 0;
+      F  = 0;
+      SP = 0;
+
+      SCR_NEXT(op0);
+
+CMD:
+      p[0] = op->kind;
+      p[1] = *op->a1;
+      p[2] = *op->a2;
+      p[3] = op->instr->p[3];
+      p[4] = op->instr->p[4];
+
+      if (p[3]) memcpy(buf, (char *)p[4], p[3]);
+
+      A = myDoCommand(p, sizeof(buf)-1, buf); F=A;
+      SCR_NEXT(op+1);
+
+READ:  A=gpioRead(*op->a1); F=A;                            SCR_NEXT(op+1);
+
+WRITE: A=scrPermitWrite(*op->a1, *op->a2); F=A;             SCR_NEXT(op+1);
+
+MICS:
+      A=scrDelay(*op->a1, PI_MAX_MICS_DELAY, 1, PI_BAD_MICS_DELAY); F=A;
+      SCR_NEXT(op+1);
+
+MILS:
+      A=scrDelay(*op->a1, PI_MAX_MILS_DELAY, 1000, PI_BAD_MILS_DELAY); F=A;
+      SCR_NEXT(op+1);
+
+W_MICS:
+      scrPermitWrite(*op->a1, *op->a2);
+      A=scrDelay(*op[1].a1, PI_MAX_MICS_DELAY, 1, PI_BAD_MICS_DELAY); F=A;
+      SCR_NEXT(op+2);
+
+W_MILS:
+      scrPermitWrite(*op->a1, *op->a2);
+      A=scrDelay(*op[1].a1, PI_MAX_MILS_DELAY, 1000, PI_BAD_MILS_DELAY); F=A;
+      SCR_NEXT(op+2);
+
+R_JZ:  A=gpioRead(*op->a1); F=A; SCR_NEXT(!F    ? op[1].jump : op+2);
+
+R_JNZ: A=gpioRead(*op->a1); F=A; SCR_NEXT(F     ? op[1].jump : op+2);
+
+DCR_JNZ:  F=--(*op->a1);         SCR_NEXT(F     ? op[1].jump : op+2);
+
+DCR_JP:   F=--(*op->a1);         SCR_NEXT(F>=0  ? op[1].jump : op+2);
+
+ADD:   A+=*op->a1; F=A;                                     SCR_NEXT(op+1);
+
+AND:   A&=*op->a1; F=A;                                     SCR_NEXT(op+1);
+
+CALL:  scrPush(s, &SP, S, op-op0+1);                        SCR_NEXT(op->jump);
+
+CMP:   F=A-*op->a1;                                         SCR_NEXT(op+1);
+
+DCR:   F=--(*op->a1);                                       SCR_NEXT(op+1);
+
+DCRA:  --A; F=A;                                            SCR_NEXT(op+1);
+
+DIV:   A/=*op->a1; F=A;                                     SCR_NEXT(op+1);
+
+EVTWT: A=scrEvtWait(s, *op->a1); F=A;                       SCR_NEXT(op+1);
+
+HALT:  s->run_state = PI_SCRIPT_HALTED;                     goto STOP;
+
+INR:   F=++(*op->a1);                                       SCR_NEXT(op+1);
+
+INRA:  ++A; F=A;                                            SCR_NEXT(op+1);
+
+JM:    SCR_NEXT(F<0  ? op->jump : op+1);
+
+JMP:   SCR_NEXT(op->jump);
+
+JNZ:   SCR_NEXT(F    ? op->jump : op+1);
+
+JP:    SCR_NEXT(F>=0 ? op->jump : op+1);
+
+JZ:    SCR_NEXT(!F   ? op->jump : op+1);
+
+LD:    *op->a1=*op->a2;                                     SCR_NEXT(op+1);
+
+LDA:   A=*op->a1;                                           SCR_NEXT(op+1);
+
+LDAB:
+      if ((*op->a1 >= 0) && (*op->a1 < sizeof(buf))) A = buf[*op->a1];
+      SCR_NEXT(op+1);
+
+MLT:   A*=*op->a1; F=A;                                     SCR_NEXT(op+1);
+
+MOD:   A%=*op->a1; F=A;                                     SCR_NEXT(op+1);
+
+NOP:                                                        SCR_NEXT(op+1);
+
+OR:    A|=*op->a1; F=A;                                     SCR_NEXT(op+1);
+
+POP:   *op->a1=scrPop(s, &SP, S);                           SCR_NEXT(op+1);
+
+POPA:  A=scrPop(s, &SP, S);                                 SCR_NEXT(op+1);
+
+PUSH:  scrPush(s, &SP, S, *op->a1);                         SCR_NEXT(op+1);
+
+PUSHA: scrPush(s, &SP, S, A);                               SCR_NEXT(op+1);
+
+RET:
+      i = scrPop(s, &SP, S);
+      if ((i < 0) || (i > s->script.instrs)) i = s->script.instrs;
+      SCR_NEXT(op0+i);
+
+RL:    F=(*op->a1<<=*op->a2);                               SCR_NEXT(op+1);
+
+RLA:   A<<=*op->a1; F=A;                                    SCR_NEXT(op+1);
+
+RR:    F=(*op->a1>>=*op->a2);                               SCR_NEXT(op+1);
+
+RRA:   A>>=*op->a1; F=A;                                    SCR_NEXT(op+1);
+
+STA:   *op->a1=A;                                           SCR_NEXT(op+1);
+
+STAB:
+      if ((*op->a1 >= 0) && (*op->a1 < sizeof(buf))) buf[*op->a1] = A;
+      SCR_NEXT(op+1);
+
+SUB:   A-=*op->a1; F=A;                                     SCR_NEXT(op+1);
+
+SYS:
+      A=scrSys((char*)op->instr->p[4], A, *(gpioReg + GPLEV0)); F=A;
+      SCR_NEXT(op+1);
+
+WAIT:  A=scrWait(s, *op->a1); F=A;                          SCR_NEXT(op+1);
+
+X:     scrSwap(op->a1, op->a2);                             SCR_NEXT(op+1);
+
+XA:    scrSwap(op->a1, &A);                                 SCR_NEXT(op+1);
+
+XOR:   A^=*op->a1; F=A;                                     SCR_NEXT(op+1);
+
+END:   s->run_state = PI_SCRIPT_HALTED;
+
+STOP:
+      if ((volatile int)s->request == PI_SCRIPT_HALT)
+         s->run_state = PI_SCRIPT_HALTED;
+   }
+
+   #undef SCR_NEXT
+
+   return 0;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void * pthTimerTick(void *x)
+{
+   gpioTimer_t *     tp;
+   struct timespec   req, rem, period;
+   char              buf[256];
+
+   tp = x;
+
+   clock_gettime(CLOCK_REALTIME, &tp->nextTick);
+
+   while (1)
+   {
+      clock_gettime(CLOCK_REALTIME, &rem);
+
+      period.tv_sec  = tp->millis / THOUSAND;
+      period.tv_nsec = (tp->millis % THOUSAND) * THOUSAND * THOUSAND;
+
+      do
+      {
+         TIMER_ADD(&tp->nextTick, &period, &tp->nextTick);
+
+         TIMER_SUB(&tp->nextTick, &rem, &req);
+      }
+      while (req.tv_sec < 0);
+
+      while (nanosleep(&req, &rem))
+      {
+         req.tv_sec  = rem.tv_sec;
+         req.tv_nsec = rem.tv_nsec;
+      }
+
+      if (gpioCfg.dbgLevel >= DBG_SLOW_TICK)
+      {
+         if ((tp->millis > 50) || (gpioCfg.dbgLevel >= DBG_FAST_TICK))
+         {
+            sprintf(buf, "pigpio: TIMER=%d @ %u %u\n",
+               tp->id,
+              (unsigned)tp->nextTick.tv_sec,
+              (unsigned)tp->nextTick.tv_nsec);
+            fprintf(stderr, buf);
+         }
+      }
+
+      if (tp->ex) (tp->func)(tp->userdata);
+      else        (tp->func)();
+   }
+
+   return 0;
+}
+
+/* ----------------------------------------------------------------------- */
+
+
+static void fifoPrintf(char *fmt, ...)
+{
+   va_list ap;
+   int n;
+
+   /* results are gathered and written once per batch of lines */
+
+   va_start(ap, fmt);
+   n = vsnprintf(fifoOut+fifoOutLen, sizeof(fifoOut)-fifoOutLen, fmt, ap);
+   va_end(ap);
+
+   if ((fifoOutLen + n) < sizeof(fifoOut))
+   {
+      fifoOutLen += n;
+      return;
+   }
+
+   /* no room, pass on what is gathered and try again */
+
+   fwrite(fifoOut, 1, fifoOutLen, outFifo);
+
+   fifoOutLen = 0;
+
+   va_start(ap, fmt);
+   n = vsnprintf(fifoOut, sizeof(fifoOut), fmt, ap);
+   va_end(ap);
+
+   if (n < sizeof(fifoOut)) fifoOutLen = n;
+   else
+   {
+      va_start(ap, fmt);
+      vfprintf(outFifo, fmt, ap);
+      va_end(ap);
+   }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int fifoBatch(char *line, int len, char *v, cmdCtlParse_t *ctl)
+{
+   uint32_t p[CMD_P_ARR];
+   unsigned size;
+   int res;
+   char *buf;
+
+   /* the rest of the line is run as one batch, as by pigs, each
+      command its header followed by its extension */
+
+   buf = malloc(CMD_MAX_EXTENSION);
+
+   if (buf == NULL) return PI_NO_MEMORY;
+
+   size = 0;
+   res = 0;
+
+   while (((ctl->eaten)<len) && (res == 0))
+   {
+      if (cmdParse(line, p, CMD_MAX_EXTENSION, v, ctl) < 0)
+         res = PI_BAD_FIFO_COMMAND;
+      else if ((size + 16 + p[3]) >= CMD_MAX_EXTENSION)
+         res = PI_BAD_BATCH;
+      else
+      {
+         memcpy(buf+size, p, 16);
+         memcpy(buf+size+16, v, p[3]);
+         size += 16 + p[3];
+      }
+   }
+
+   if (res == 0)
+   {
+      p[0] = PI_CMD_BATCH;
+      p[1] = 0;
+      p[2] = 0;
+      p[3] = size;
+
+      res = myDoCommand(p, CMD_MAX_EXTENSION-1, buf);
+
+      /* the results are packed at the start of buf */
+
+      if (res > 0) memcpy(v, buf, res);
+   }
+
+   free(buf);
+
+   return res;
+}
+
+static void fifoLine(char *line, int len, char *v)
+{
+   int idx, res, i;
+   uint32_t p[CMD_P_ARR];
+   cmdCtlParse_t ctl;
+   uint32_t *param;
+
+   ctl.eaten = 0;
+   idx = 0;
+
+   while (((ctl.eaten)<len) && (idx >= 0))
+   {
+      if ((idx=cmdParse(line, p, CMD_MAX_EXTENSION, v, &ctl)) >= 0)
+      {
+         /* make sure extensions are null terminated */
+
+         v[p[3]] = 0;
 
-            expected = sTick;
+         if (p[0] == PI_CMD_BATCH) res = fifoBatch(line, len, v, &ctl);
+         else res = myDoCommand(p, CMD_MAX_EXTENSION-1, v);
 
-            sTick = myGetTick(cycle);
+         switch (cmdInfo[idx].rv)
+         {
+            case 0:
+               fifoPrintf("%d\n", res);
+               break;
 
-            if (stickInited)
-            {
-               diff = sTick - expected;
+            case 1:
+               fifoPrintf("%d\n", res);
+               break;
 
-               if (abs(diff) > minDiff)
-               {
-                  ft = sample[numSamples-PULSE_PER_CYCLE].tick;
+            case 2:
+               fifoPrintf("%d\n", res);
+               break;
 
-                  ticks = sTick - ft;
+            case 3:
+               fifoPrintf("%08X\n", res);
+               break;
 
-                  for (i=1; i<PULSE_PER_CYCLE; i++)
+            case 4:
+               fifoPrintf("%u\n", res);
+               break;
+
+            case 5:
+               fifoPrintf("%s", cmdUsage);
+               break;
+
+            case 6:
+               fifoPrintf("%d", res);
+               if (res > 0)
+               {
+                  for (i=0; i<res; i++)
                   {
-                     sample[numSamples-PULSE_PER_CYCLE+i].tick =
-                        ((i*ticks)/PULSE_PER_CYCLE) + ft;
+                     fifoPrintf(" %d", v[i]);
                   }
                }
+               fifoPrintf("\n");
+               break;
 
-               diff += (TICKSLOTS/2);
-
-               if (diff < 0)
+            case 7:
+               if (res < 0) fifoPrintf("%d\n", res);
+               else
                {
-                  gpioStats.diffTick[0]++;
+                  fifoPrintf("%d", res);
+                  param = (uint32_t *)v;
+                  for (i=0; i<PI_MAX_SCRIPT_PARAMS; i++)
+                  {
+                     fifoPrintf(" %d", param[i]);
+                  }
+                  fifoPrintf("\n");
                }
+               break;
 
-               else if (diff >= TICKSLOTS)
+            case 9:
+               fifoPrintf("%d", res);
+               param = (uint32_t *)v;
+               for (i=0; i<res/4; i++)
                {
-                  gpioStats.diffTick[TICKSLOTS-1]++;
+                  fifoPrintf(" %u", param[i]);
                }
+               fifoPrintf("\n");
+               break;
 
-               else gpioStats.diffTick[diff]++;
-            }
-            else
-            {
-               stickInited = 1;
-               numSamples = 0;
-               pthAlertRunning = PI_THREAD_RUNNING;
-            }
+            case 10:
+               if (res < 0) fifoPrintf("%d\n", res);
+               else
+               {
+                  param = (uint32_t *)v;
+                  for (i=0; i<res/4; i++)
+                  {
+                     fifoPrintf(i ? " %d" : "%d", param[i]);
+                  }
+                  fifoPrintf("\n");
+               }
+               break;
          }
       }
+      else fifoPrintf("%d\n", PI_BAD_FIFO_COMMAND);
+   }
+}
 
-      if (oldSlot == newSlot) moreToDo = 0; else moreToDo = 1;
-
-      /* Apply glitch filter */
+/* ----------------------------------------------------------------------- */
 
-      if (numSamples && gFilterBits) alertGlitchFilter(sample, numSamples);
+static void * pthFifoThread(void *x)
+{
+   char buf[CMD_MAX_EXTENSION];
+   char v[CMD_MAX_EXTENSION];
+   char *nl;
+   int flags, got, start, n;
 
-      /* Apply noise filter */
+   myCreatePipe(PI_INPFIFO, 0662);
 
-      if (numSamples && nFilterBits) alertNoiseFilter(sample, numSamples);
+   if ((inpFifo = fopen(PI_INPFIFO, "r+")) == NULL)
+      SOFT_ERROR((void*)PI_INIT_FAILED, "fopen %s failed(%m)", PI_INPFIFO);
 
-      /* Compact samples */
+   myCreatePipe(PI_OUTFIFO, 0664);
 
-      changedBits = 0;
-      oldLevel &= monitorBits;
-      reports = 0;
-      totalSamples = 0;
+   if ((outFifo = fopen(PI_OUTFIFO, "w+")) == NULL)
+      SOFT_ERROR((void*)PI_INIT_FAILED, "fopen %s failed (%m)", PI_OUTFIFO);
 
-      for (rp=0; rp<numSamples; rp++)
-      {
-         newLevel = (sample[rp].level & monitorBits);
+   /* set outFifo non-blocking */
 
-         if (newLevel != oldLevel)
-         {
-            sample[reports].tick  = sample[rp].tick;
-            sample[reports].level = sample[rp].level;
-            changedBits |= (newLevel ^ oldLevel);
-            oldLevel = newLevel;
+   flags = fcntl(fileno(outFifo), F_GETFL, 0);
+   fcntl(fileno(outFifo), F_SETFL, flags | O_NONBLOCK);
 
-            reports++;
+   /* don't start until DMA started */
 
-            if (reports >= MAX_REPORT)
-            {
-               totalSamples += reports;
+   spinWhileStarting();
 
-               /* Rebase watchdog timeouts */
-               if (wdogBits) alertWdogCheck(sample, reports);
+   got = 0;
 
-               gpioStats.numSamples += reports;
+   while (1)
+   {
+      /* take whatever lines have been written, not one at a time */
 
-               alertEmit(sample, reports, changedBits, sample[rp].tick);
+      n = read(fileno(inpFifo), buf+got, sizeof(buf)-1-got);
 
-               changedBits = 0;
-               reports = 0;
-            }
-         }
+      if (n <= 0)
+      {
+         if ((n < 0) && (errno == EINTR)) continue;
+         SOFT_ERROR((void*)PI_INIT_FAILED, "fifo read failed (%m)");
       }
 
-      if (reports)
+      got += n;
+
+      start = 0;
+
+      while (start < got)
       {
-         totalSamples += reports;
+         nl = memchr(buf+start, '\n', got-start);
 
-         /* Rebase watchdog timeouts */
-         if (wdogBits) alertWdogCheck(sample, reports);
+         if (nl == NULL)
+         {
+            /* wait for the rest of the line unless it fills the
+               buffer, as fgets would it is then taken in pieces */
 
-         gpioStats.numSamples += reports;
-      }
+            if (start || (got < (sizeof(buf)-1))) break;
 
-      alertEmit(sample, reports, changedBits, sTick);
+            nl = buf + got;
+         }
 
-      if (totalSamples > gpioStats.maxSamples)
-         gpioStats.maxSamples = numSamples;
+         *nl = 0;
 
-      req.tv_sec = 0;
-      req.tv_nsec = alert_delays[(gpioCfg.internals>>PI_CFG_ALERT_FREQ)&15];
+         fifoLine(buf+start, nl-(buf+start), v);
 
-      if (moreToDo)
-      {
-         gpioStats.moreToDo++;
+         start = nl - buf + 1;
       }
-      else
-      {
-         gpioStats.alertTicks++;
 
-         while (nanosleep(&req, &rem))
-         {
-            req.tv_sec  = rem.tv_sec;
-            req.tv_nsec = rem.tv_nsec;
-         }
+      /* keep any partial line for the next read */
+
+      if (start < got)
+      {
+         if (start) memmove(buf, buf+start, got-start);
+         got -= start;
       }
-   }
+      else got = 0;
 
-   return 0;
-}
+      fwrite(fifoOut, 1, fifoOutLen, outFifo);
 
-/* ======================================================================= */
+      fifoOutLen = 0;
 
-static int scrPop(gpioScript_t *s, int *SP, int *S)
-{
-   if ((*SP) > 0)
-   {
-      return S[--(*SP)];
-   }
-   else
-   {
-      s->run_state = PI_SCRIPT_FAILED;
-      DBG(DBG_ALWAYS, "script %d too many pops", s->id);
-      return 0;
+      fflush(outFifo);
    }
+
+   return 0;
 }
 
 /* ----------------------------------------------------------------------- */
 
-static void scrPush(gpioScript_t *s, int *SP, int *S, int val)
+static void sockConnClose(sockConn_t *conn)
 {
-   if ((*SP) < PI_SCRIPT_STACK_SIZE)
-   {
-      S[(*SP)++] = val;
-   }
-   else
-   {
-      s->run_state = PI_SCRIPT_FAILED;
-      DBG(DBG_ALWAYS, "script %d too many pushes", s->id);
-   }
-}
+   DBG(DBG_USER,
+      "close sock=%d commands=%u rx=%u tx=%u deferred=%u secs=%d",
+      conn->fd, conn->commands, conn->rxBytes, conn->txBytes,
+      conn->deferred, (int)(time(NULL) - conn->opened));
 
-/* ----------------------------------------------------------------------- */
+   epoll_ctl(sockEpfd, EPOLL_CTL_DEL, conn->fd, NULL);
 
-static void scrSwap(int *v1, int *v2)
-{
-   int t;
+   /* a notification handle on the socket closes it when done */
 
-   t=*v1; *v1=*v2; *v2= t;
+   if (!closeOrphanedNotifications(-1, conn->fd, 1)) close(conn->fd);
+
+   free(conn->in);
+   free(conn->out);
+   free(conn);
+
+   __atomic_sub_fetch(&sockConns, 1, __ATOMIC_RELAXED);
 }
 
 /* ----------------------------------------------------------------------- */
 
-static int scrEvtWait(gpioScript_t *s, uint32_t bits)
+static int sockConnFlush(sockConn_t *conn)
 {
-   pthread_mutex_lock(&s->pthMutex);
+   int sent;
 
-   if (s->request == PI_SCRIPT_RUN)
+   /* send what is left of a response the socket would not take,
+      returns 1 once it has all gone */
+
+   sent = send(conn->fd, conn->out + conn->outPos,
+      conn->outLen - conn->outPos, MSG_DONTWAIT|MSG_NOSIGNAL);
+
+   if (sent < 0)
    {
-      s->run_state = PI_SCRIPT_WAITING;
-      s->eventBits = bits;
-      intScriptEventBits();
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+         return 0;
 
-      pthread_cond_wait(&s->pthCond, &s->pthMutex);
+      /* the peer has gone, the next read will find out */
 
-      s->waitBits = 0;
-      intScriptEventBits();
-      s->run_state = PI_SCRIPT_RUNNING;
+      sent = conn->outLen - conn->outPos;
    }
 
-   pthread_mutex_unlock(&s->pthMutex);
+   conn->txBytes += sent;
+   conn->outPos += sent;
 
-   return s->changedBits;
+   if (conn->outPos < conn->outLen) return 0;
+
+   free(conn->out);
+   conn->out = NULL;
+   conn->outPos = 0;
+   conn->outLen = 0;
+
+   return 1;
 }
 
 /* ----------------------------------------------------------------------- */
 
-static int scrWait(gpioScript_t *s, uint32_t bits)
+static void sockConnSend(sockConn_t *conn, struct iovec *iov, int iovcnt)
 {
-   pthread_mutex_lock(&s->pthMutex);
+   int i, len, sent, pos;
+   struct msghdr msg;
 
-   if (s->request == PI_SCRIPT_RUN)
-   {
-      s->run_state = PI_SCRIPT_WAITING;
-      s->waitBits = bits;
-      intScriptBits();
+   len = 0;
 
-      pthread_cond_wait(&s->pthCond, &s->pthMutex);
+   for (i=0; i<iovcnt; i++) len += iov[i].iov_len;
 
-      s->waitBits = 0;
-      intScriptBits();
-      s->run_state = PI_SCRIPT_RUNNING;
+   if (!len) return;
+
+   memset(&msg, 0, sizeof(msg));
+   msg.msg_iov = iov;
+   msg.msg_iovlen = iovcnt;
+
+   sent = sendmsg(conn->fd, &msg, MSG_DONTWAIT|MSG_NOSIGNAL);
+
+   if (sent < 0)
+   {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+         sent = 0;
+      else
+         sent = len; /* the peer has gone, the next read will find out */
    }
 
-   pthread_mutex_unlock(&s->pthMutex);
+   conn->txBytes += sent;
 
-   return s->changedBits;
-}
+   if (sent < len)
+   {
+      /* queue the rest until the socket drains */
 
-/* ----------------------------------------------------------------------- */
+      conn->out = malloc(len - sent);
 
-static int scrSys(char *cmd, uint32_t p1, uint32_t p2)
-{
-   char buf[1024];
-   int status;
+      if (conn->out == NULL)
+      {
+         DBG(DBG_ALWAYS, "response dropped, sock=%d", conn->fd);
+         return;
+      }
 
-   if (!myScriptNameValid(cmd))
-      SOFT_ERROR(PI_BAD_SCRIPT_NAME, "bad script name (%s)", cmd);
+      pos = 0;
 
-   snprintf(buf, sizeof(buf), "/opt/pigpio/cgi/%s %u %u", cmd, p1, p2);
+      for (i=0; i<iovcnt; i++)
+      {
+         if (sent >= iov[i].iov_len)
+         {
+            sent -= iov[i].iov_len;
+            continue;
+         }
 
-   DBG(DBG_USER, "%s", buf);
+         memcpy(conn->out + pos,
+            (char *)iov[i].iov_base + sent, iov[i].iov_len - sent);
 
-   status = system(buf);
+         pos += iov[i].iov_len - sent;
 
-   if (status < 0) status = PI_BAD_SHELL_STATUS;
+         sent = 0;
+      }
 
-   return status;
+      conn->outPos = 0;
+      conn->outLen = pos;
+
+      conn->deferred++;
+
+      gpioStats.sockDeferred++;
+   }
 }
 
 /* ----------------------------------------------------------------------- */
 
-static void *pthScript(void *x)
+static void sockConnCommand(
+   sockConn_t *conn, uint32_t *p, char *buf, char *tx, int *txLen)
 {
-   gpioScript_t *s;
-   cmdInstr_t instr;
-   int p1, p2, p1o, p2o, *t1, *t2;
-   int PC, A, F, SP;
-   int S[PI_SCRIPT_STACK_SIZE];
-   char buf[CMD_MAX_EXTENSION];
+   int opt;
+   struct iovec iov[2];
 
+   conn->commands++;
 
-   S[0] = 0; /* to prevent compiler warning */
+   switch (p[0])
+   {
+      case PI_CMD_NOIB:
 
-   s = x;
+         p[3] = gpioNotifyOpenInBand(conn->fd);
 
-   while ((volatile int)s->request != PI_SCRIPT_DELETE)
-   {
-      pthread_mutex_lock(&s->pthMutex);
-      s->run_state = PI_SCRIPT_HALTED;
-      pthread_cond_wait(&s->pthCond, &s->pthMutex);
-      pthread_mutex_unlock(&s->pthMutex);
+        /* Enable the Nagle algorithm. */
+         opt = 0;
+         setsockopt(
+            conn->fd, IPPROTO_TCP, TCP_NODELAY, (char*)&opt, sizeof(int));
 
-      s->run_state = PI_SCRIPT_RUNNING;
+         break;
 
-      A  = 0;
-      F  = 0;
-      PC = 0;
-      SP = 0;
+      case PI_CMD_PROCP:
+         p[3] = myDoCommand(p, CMD_MAX_EXTENSION-1, buf+sizeof(int));
+         if (((int)p[3]) >= 0)
+         {
+            memcpy(buf, &p[3], 4);
+            p[3] = 4 + (4*PI_MAX_SCRIPT_PARAMS);
+         }
+         break;
 
-      while (((volatile int)s->request   == PI_SCRIPT_RUN    ) &&
-                           (s->run_state == PI_SCRIPT_RUNNING))
-      {
-         instr = s->script.instr[PC];
+      default:
+         p[3] = myDoCommand(p, CMD_MAX_EXTENSION-1, buf);
+   }
+
+   /* the response header joins any not yet sent */
+
+   memcpy(tx + *txLen, p, 16);
+
+   *txLen += 16;
+
+   iov[0].iov_base = tx;
+   iov[0].iov_len  = *txLen;
+   iov[1].iov_base = buf;
+   iov[1].iov_len  = 0;
+
+   switch (p[0])
+   {
+      /* extensions */
 
-         p1o = instr.p[1];
-         p2o = instr.p[2];
+      case PI_CMD_BI2CZ:
+      case PI_CMD_BSCX:
+      case PI_CMD_CF2:
+      case PI_CMD_FL:
+      case PI_CMD_FR:
+      case PI_CMD_I2CPK:
+      case PI_CMD_I2CRD:
+      case PI_CMD_I2CRI:
+      case PI_CMD_I2CRK:
+      case PI_CMD_I2CZ:
+      case PI_CMD_LH:
+      case PI_CMD_PROCP:
+      case PI_CMD_SERR:
+      case PI_CMD_SLR:
+      case PI_CMD_SPIX:
+      case PI_CMD_SPIR:
+      case PI_CMD_BSPIX:
+      case PI_CMD_BATCH:
 
-         if      (instr.opt[1] == CMD_VAR) instr.p[1] = s->script.var[p1o];
-         else if (instr.opt[1] == CMD_PAR) instr.p[1] = s->script.par[p1o];
+         if (((int)p[3]) > 0) iov[1].iov_len = p[3];
+         break;
 
-         if      (instr.opt[2] == CMD_VAR) instr.p[2] = s->script.var[p2o];
-         else if (instr.opt[2] == CMD_PAR) instr.p[2] = s->script.par[p2o];
-/*
-         fprintf(stderr, "PC=%d cmd=%d p1o=%d p1=%d p2o=%d p2=%d\n",
-            PC, instr.p[0], p1o, instr.p[1], p2o, instr.p[2]);
-         fflush(stderr);
-*/
-         if (instr.p[0] < 100)
-         {
-            if (instr.p[3])
-            {
-               memcpy(buf, (char *)instr.p[4], instr.p[3]);
-            }
+      default:
+        break;
+   }
 
-            A = myDoCommand(instr.p, sizeof(buf)-1, buf);
+   /* an extension is in buf, which the next command reuses, and
+      notifications may follow a NOIB response at any time, so those
+      are sent now, otherwise the headers wait for the end of the
+      read batch */
 
-            F = A;
+   if (iov[1].iov_len || (p[0] == PI_CMD_NOIB) ||
+       (*txLen == SOCK_TX_BYTES))
+   {
+      sockConnSend(conn, iov, 2);
 
-            PC++;
-         }
-         else
-         {
-            p1 = instr.p[1];
-            p2 = instr.p[2];
+      *txLen = 0;
+   }
+}
 
-            switch (instr.p[0])
-            {
-               case PI_CMD_ADD:   A+=p1; F=A;                     PC++; break;
+/* ----------------------------------------------------------------------- */
 
-               case PI_CMD_AND:   A&=p1; F=A;                     PC++; break;
+static void sockConnService(sockConn_t *conn, char *rx, char *buf)
+{
+   uint32_t p[10];
+   int got, len, pos, txLen;
+   char tx[SOCK_TX_BYTES];
+   struct iovec iov;
+   struct epoll_event ev;
 
-               case PI_CMD_CALL:  scrPush(s, &SP, S, PC+1);    PC = p1; break;
+   /* a response still waiting holds back further commands */
 
-               case PI_CMD_CMP:   F=A-p1;                         PC++; break;
+   if (conn->outLen && !sockConnFlush(conn))
+   {
+      ev.events = EPOLLOUT | EPOLLONESHOT;
+      ev.data.ptr = conn;
+      epoll_ctl(sockEpfd, EPOLL_CTL_MOD, conn->fd, &ev);
+      return;
+   }
 
-               case PI_CMD_DCR:
-                  if (instr.opt[1] == CMD_PAR)
-                     {--s->script.par[p1o]; F=s->script.par[p1o];}
-                  else
-                     {--s->script.var[p1o]; F=s->script.var[p1o];}
-                  PC++;
-                  break;
+   /* carry on from any partial command left by the last read */
 
-               case PI_CMD_DCRA:  --A; F=A;                       PC++; break;
+   len = conn->inLen;
 
-               case PI_CMD_DIV:   A/=p1; F=A;                     PC++; break;
+   if (len)
+   {
+      memcpy(rx, conn->in, len);
+      free(conn->in);
+      conn->in = NULL;
+      conn->inLen = 0;
+   }
 
-               case PI_CMD_HALT:  s->run_state = PI_SCRIPT_HALTED;      break;
+   got = recv(conn->fd, rx+len, SOCK_RX_BYTES-len, MSG_DONTWAIT);
 
-               case PI_CMD_EVTWT: A=scrEvtWait(s, p1); F=A;       PC++; break;
+   if (got == 0)
+   {
+      sockConnClose(conn);
+      return;
+   }
 
-               case PI_CMD_INR:
-                  if (instr.opt[1] == CMD_PAR)
-                     {++s->script.par[p1o]; F=s->script.par[p1o];}
-                  else
-                     {++s->script.var[p1o]; F=s->script.var[p1o];}
-                  PC++;
-                  break;
+   if (got < 0)
+   {
+      if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+      {
+         sockConnClose(conn);
+         return;
+      }
+      got = 0;
+   }
 
-               case PI_CMD_INRA:  ++A; F=A;                       PC++; break;
+   conn->rxBytes += got;
 
-               case PI_CMD_JM:    if (F<0)  PC=p1; else PC++;           break;
+   len += got;
 
-               case PI_CMD_JMP:   PC=p1;                                break;
+   pos = 0;
 
-               case PI_CMD_JNZ:   if (F)    PC=p1; else PC++;           break;
+   txLen = 0;
 
-               case PI_CMD_JP:    if (F>=0) PC=p1; else PC++;           break;
+   while ((len - pos) >= 16)
+   {
+      memcpy(p, rx+pos, 16);
 
-               case PI_CMD_JZ:    if (!F)   PC=p1; else PC++;           break;
+      if (p[3] >= CMD_MAX_EXTENSION)
+      {
+         /* Serious error.  No point continuing. */
+         DBG(DBG_ALWAYS,
+            "ext too large %d(%d), sock=%d",
+            p[3], CMD_MAX_EXTENSION, conn->fd);
 
-               case PI_CMD_LD:
-                  if (instr.opt[1] == CMD_PAR) s->script.par[p1o]=p2;
-                  else                         s->script.var[p1o]=p2;
-                  PC++;
-                  break;
+         if (txLen)
+         {
+            iov.iov_base = tx;
+            iov.iov_len = txLen;
+            sockConnSend(conn, &iov, 1);
+         }
 
-               case PI_CMD_LDA:   A=p1;                           PC++; break;
+         sockConnClose(conn);
+         return;
+      }
 
-               case PI_CMD_LDAB:
-                  if ((p1 >= 0) && (p1 < sizeof(buf))) A = buf[p1];
-                  PC++;
-                  break;
+      if ((len - pos) < (16 + p[3])) break;
 
-               case PI_CMD_MLT:   A*=p1; F=A;                     PC++; break;
+      memcpy(buf, rx+pos+16, p[3]);
 
-               case PI_CMD_MOD:   A%=p1; F=A;                     PC++; break;
+      /* add null terminator in case it's a string */
 
-               case PI_CMD_OR:    A|=p1; F=A;                     PC++; break;
+      buf[p[3]] = 0;
 
-               case PI_CMD_POP:
-                  if (instr.opt[1] == CMD_PAR)
-                     s->script.par[p1o]=scrPop(s, &SP, S);
-                  else
-                     s->script.var[p1o]=scrPop(s, &SP, S);
-                  PC++;
-                  break;
+      pos += 16 + p[3];
 
-               case PI_CMD_POPA:  A=scrPop(s, &SP, S);            PC++; break;
+      sockConnCommand(conn, p, buf, tx, &txLen);
 
-               case PI_CMD_PUSH:
-                  if (instr.opt[1] == CMD_PAR)
-                     scrPush(s, &SP, S, s->script.par[p1o]);
-                  else
-                     scrPush(s, &SP, S, s->script.var[p1o]);
-                  PC++;
-                  break;
+      if (conn->outLen) break;
+   }
 
-               case PI_CMD_PUSHA: scrPush(s, &SP, S, A);          PC++; break;
+   /* answer the batch with one send */
 
-               case PI_CMD_RET:   PC=scrPop(s, &SP, S);                 break;
+   if (txLen)
+   {
+      iov.iov_base = tx;
+      iov.iov_len = txLen;
+      sockConnSend(conn, &iov, 1);
+   }
 
-               case PI_CMD_RL:
-                  if (instr.opt[1] == CMD_PAR)
-                     {s->script.par[p1o]<<=p2; F=s->script.par[p1o];}
-                  else
-                     {s->script.var[p1o]<<=p2; F=s->script.var[p1o];}
-                  PC++;
-                  break;
+   if (pos < len)
+   {
+      conn->in = malloc(len - pos);
 
-               case PI_CMD_RLA:   A<<=p1; F=A;                    PC++; break;
+      if (conn->in == NULL)
+      {
+         DBG(DBG_ALWAYS, "malloc failed, sock=%d", conn->fd);
+         sockConnClose(conn);
+         return;
+      }
 
-               case PI_CMD_RR:
-                  if (instr.opt[1] == CMD_PAR)
-                     {s->script.par[p1o]>>=p2; F=s->script.par[p1o];}
-                  else
-                     {s->script.var[p1o]>>=p2; F=s->script.var[p1o];}
-                  PC++;
-                  break;
+      memcpy(conn->in, rx+pos, len - pos);
+      conn->inLen = len - pos;
+   }
 
-               case PI_CMD_RRA:   A>>=p1; F=A;                    PC++; break;
+   ev.events = (conn->outLen ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT;
+   ev.data.ptr = conn;
+   epoll_ctl(sockEpfd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
 
-               case PI_CMD_STA:
-                  if (instr.opt[1] == CMD_PAR) s->script.par[p1o]=A;
-                  else                         s->script.var[p1o]=A;
-                  PC++;
-                  break;
+/* ----------------------------------------------------------------------- */
 
-               case PI_CMD_STAB:
-                  if ((p1 >= 0) && (p1 < sizeof(buf))) buf[p1] = A;
-                  PC++;
-                  break;
+static void *pthSocketWorker(void *x);
 
-               case PI_CMD_SUB:   A-=p1; F=A;                     PC++; break;
+static int sockWorkerStart(void)
+{
+   pthread_attr_t pthAttr;
+   int i, err;
 
-               case PI_CMD_SYS:
-                  A=scrSys((char*)instr.p[4], A, *(gpioReg + GPLEV0));
-                  F=A;
-                  PC++;
-                  break;
+   /* starts one more worker, returns 0 if OK */
 
-               case PI_CMD_WAIT:  A=scrWait(s, p1); F=A;          PC++; break;
+   pthread_mutex_lock(&sockWorkerMutex);
 
-               case PI_CMD_X:
-                  if (instr.opt[1] == CMD_PAR) t1 = &s->script.par[p1o];
-                  else                         t1 = &s->script.var[p1o];
+   i = sockWorkers;
 
-                  if (instr.opt[2] == CMD_PAR) t2 = &s->script.par[p2o];
-                  else                         t2 = &s->script.var[p2o];
+   err = sockStopping || (i >= SOCK_MAX_WORKERS);
 
-                  scrSwap(t1, t2);
-                  PC++;
-                  break;
+   if (!err) err = pthread_attr_init(&pthAttr);
 
-               case PI_CMD_XA:
-                  if (instr.opt[1] == CMD_PAR)
-                     scrSwap(&s->script.par[p1o], &A);
-                  else
-                     scrSwap(&s->script.var[p1o], &A);
-                  PC++;
-                  break;
+   if (!err)
+   {
+      pthread_attr_setstacksize(&pthAttr, STACK_SIZE);
 
-               case PI_CMD_XOR:   A^=p1; F=A;                     PC++; break;
+      __atomic_add_fetch(&sockIdle, 1, __ATOMIC_SEQ_CST);
 
-            }
-         }
+      err = pthread_create(&sockWorker[i].pthId, &pthAttr,
+         pthSocketWorker, &sockWorker[i]);
 
-         if (PC >= s->script.instrs) s->run_state = PI_SCRIPT_HALTED;
+      pthread_attr_destroy(&pthAttr);
 
+      if (err)
+      {
+         __atomic_sub_fetch(&sockIdle, 1, __ATOMIC_SEQ_CST);
+      }
+      else
+      {
+         sockWorker[i].running = 1;
+         sockWorkers = i + 1;
+         gpioStats.sockPeakWorkers = sockWorkers;
       }
-
-      if ((volatile int)s->request == PI_SCRIPT_HALT)
-         s->run_state = PI_SCRIPT_HALTED;
-
    }
 
-   return 0;
-}
+   pthread_mutex_unlock(&sockWorkerMutex);
 
-/* ----------------------------------------------------------------------- */
+   return err;
+}
 
-static void * pthTimerTick(void *x)
+static void *pthSocketWorker(void *x)
 {
-   gpioTimer_t *     tp;
-   struct timespec   req, rem, period;
-   char              buf[256];
+   struct epoll_event ev;
+   char rx[SOCK_RX_BYTES];
+   char buf[CMD_MAX_EXTENSION];
 
-   tp = x;
+   /* each connection is armed one shot so only one worker at a time
+      serves it, its commands are run and answered in order.
 
-   clock_gettime(CLOCK_REALTIME, &tp->nextTick);
+      A command may block for a long time (MILS, slow I2C or serial),
+      so when the last idle worker takes a command another is started,
+      connections then keep being served until SOCK_MAX_WORKERS are
+      busy.  The workers started stay for later bursts.
+   */
 
    while (1)
    {
-      clock_gettime(CLOCK_REALTIME, &rem);
-
-      period.tv_sec  = tp->millis / THOUSAND;
-      period.tv_nsec = (tp->millis % THOUSAND) * THOUSAND * THOUSAND;
+      if (epoll_wait(sockEpfd, &ev, 1, -1) != 1) continue;
 
-      do
-      {
-         TIMER_ADD(&tp->nextTick, &period, &tp->nextTick);
+      /* finish the command before honouring gpioTerminate */
 
-         TIMER_SUB(&tp->nextTick, &rem, &req);
-      }
-      while (req.tv_sec < 0);
+      pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
 
-      while (nanosleep(&req, &rem))
+      if (__atomic_sub_fetch(&sockIdle, 1, __ATOMIC_SEQ_CST) == 0)
       {
-         req.tv_sec  = rem.tv_sec;
-         req.tv_nsec = rem.tv_nsec;
+         if (sockWorkerStart())
+            DBG(DBG_ALWAYS, "no socket worker started (%d)", sockWorkers);
       }
 
-      if (gpioCfg.dbgLevel >= DBG_SLOW_TICK)
-      {
-         if ((tp->millis > 50) || (gpioCfg.dbgLevel >= DBG_FAST_TICK))
-         {
-            sprintf(buf, "pigpio: TIMER=%d @ %u %u\n",
-               tp->id,
-              (unsigned)tp->nextTick.tv_sec,
-              (unsigned)tp->nextTick.tv_nsec);
-            fprintf(stderr, buf);
-         }
-      }
+      sockConnService(ev.data.ptr, rx, buf);
 
-      if (tp->ex) (tp->func)(tp->userdata);
-      else        (tp->func)();
+      __atomic_add_fetch(&sockIdle, 1, __ATOMIC_SEQ_CST);
+
+      pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
    }
 
    return 0;
@@ -6774,317 +9309,280 @@ static void * pthTimerTick(void *x)
 
 /* ----------------------------------------------------------------------- */
 
-
-static void * pthFifoThread(void *x)
+static int addrAllowed(struct sockaddr *saddr)
 {
-   char buf[CMD_MAX_EXTENSION];
-   int idx, flags, len, res, i;
-   uint32_t p[CMD_P_ARR];
-   cmdCtlParse_t ctl;
-   uint32_t *param;
-   char v[CMD_MAX_EXTENSION];
+   int i;
+   uint32_t addr;
 
-   myCreatePipe(PI_INPFIFO, 0662);
+   if (!numSockNetAddr) return 1;
 
-   if ((inpFifo = fopen(PI_INPFIFO, "r+")) == NULL)
-      SOFT_ERROR((void*)PI_INIT_FAILED, "fopen %s failed(%m)", PI_INPFIFO);
+   // FIXME: add IPv6 whitelisting support
+   if (saddr->sa_family != AF_INET) return 0;
 
-   myCreatePipe(PI_OUTFIFO, 0664);
+   addr = ((struct sockaddr_in *) saddr)->sin_addr.s_addr;
 
-   if ((outFifo = fopen(PI_OUTFIFO, "w+")) == NULL)
-      SOFT_ERROR((void*)PI_INIT_FAILED, "fopen %s failed (%m)", PI_OUTFIFO);
+   for (i=0; i<numSockNetAddr; i++)
+   {
+      if (addr == sockNetAddr[i]) return 1;
+   }
+   return 0;
+}
 
-   /* set outFifo non-blocking */
+/* ----------------------------------------------------------------------- */
 
-   flags = fcntl(fileno(outFifo), F_GETFL, 0);
-   fcntl(fileno(outFifo), F_SETFL, flags | O_NONBLOCK);
+static int peerInGroup(uid_t uid, gid_t gid)
+{
+   struct passwd pw, *pwp;
+   char buf[1024];
+   gid_t list[64], *groups;
+   int i, n, found;
 
-   /* don't start until DMA started */
+   /* the group may be one of the user's supplementary groups */
 
-   spinWhileStarting();
+   if (getpwuid_r(uid, &pw, buf, sizeof(buf), &pwp) || (pwp == NULL))
+      return 0;
 
-   while (1)
+   groups = list;
+   n = 64;
+
+   if (getgrouplist(pw.pw_name, pw.pw_gid, groups, &n) < 0)
    {
-      if (fgets(buf, sizeof(buf), inpFifo) == NULL)
-         SOFT_ERROR((void*)PI_INIT_FAILED, "fifo fgets failed (%m)");
+      /* n is now the number of groups */
 
-      len = strlen(buf);
+      groups = malloc(n * sizeof(gid_t));
 
-      if (len)
+      if ((groups == NULL) ||
+          (getgrouplist(pw.pw_name, pw.pw_gid, groups, &n) < 0))
       {
-        --len;
-        buf[len] = 0; /* replace terminating */
+         free(groups);
+         return 0;
       }
+   }
 
-      ctl.eaten = 0;
-      idx = 0;
+   found = 0;
 
-      while (((ctl.eaten)<len) && (idx >= 0))
-      {
-         if ((idx=cmdParse(buf, p, CMD_MAX_EXTENSION, v, &ctl)) >= 0)
-         {
-            /* make sure extensions are null terminated */
+   for (i=0; i<n; i++)
+   {
+      if (groups[i] == gid) found = 1;
+   }
 
-            v[p[3]] = 0;
+   if (groups != list) free(groups);
 
-            res = myDoCommand(p, sizeof(v)-1, v);
+   return found;
+}
 
-            switch (cmdInfo[idx].rv)
-            {
-               case 0:
-                  fprintf(outFifo, "%d\n", res);
-                  break;
+/* ----------------------------------------------------------------------- */
 
-               case 1:
-                  fprintf(outFifo, "%d\n", res);
-                  break;
+static int peerAllowed(int fd)
+{
+   struct ucred cred;
+   struct sockaddr_in local;
+   socklen_t len;
 
-               case 2:
-                  fprintf(outFifo, "%d\n", res);
-                  break;
+   /* a local peer is 127.0.0.1 to the allowed network addresses */
 
-               case 3:
-                  fprintf(outFifo, "%08X\n", res);
-                  break;
+   memset(&local, 0, sizeof(local));
+   local.sin_family = AF_INET;
+   local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
 
-               case 4:
-                  fprintf(outFifo, "%u\n", res);
-                  break;
+   if (!addrAllowed((struct sockaddr *)&local)) return 0;
 
-               case 5:
-                  fprintf(outFifo, cmdUsage);
-                  break;
+   len = sizeof(cred);
 
-               case 6:
-                  fprintf(outFifo, "%d", res);
-                  if (res > 0)
-                  {
-                     for (i=0; i<res; i++)
-                     {
-                        fprintf(outFifo, " %d", v[i]);
-                     }
-                  }
-                  fprintf(outFifo, "\n");
-                  break;
+   if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) return 0;
 
-               case 7:
-                  if (res < 0) fprintf(outFifo, "%d\n", res);
-                  else
-                  {
-                     fprintf(outFifo, "%d", res);
-                     param = (uint32_t *)v;
-                     for (i=0; i<PI_MAX_SCRIPT_PARAMS; i++)
-                     {
-                        fprintf(outFifo, " %d", param[i]);
-                     }
-                     fprintf(outFifo, "\n");
-                  }
-                  break;
-            }
-         }
-         else fprintf(outFifo, "%d\n", PI_BAD_FIFO_COMMAND);
-      }
+   if ((cred.uid == 0) || (cred.uid == geteuid())) return 1;
 
-      fflush(outFifo);
-   }
+   if (gpioCfg.sockGid < 0) return 0;
 
-   return 0;
+   if (cred.gid == (gid_t)gpioCfg.sockGid) return 1;
+
+   return peerInGroup(cred.uid, gpioCfg.sockGid);
 }
 
 /* ----------------------------------------------------------------------- */
 
-static void *pthSocketThreadHandler(void *fdC)
+static int sockAccept(int fd)
 {
-   int sock = *(int*)fdC;
-   uint32_t p[10];
-   int opt;
-   char buf[CMD_MAX_EXTENSION];
-
-   free(fdC);
-
-   /* Disable the Nagle algorithm. */
-   opt = 1;
-   setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (char*)&opt, sizeof(int));
-
-   while (1)
-   {
-      if (recv(sock, p, 16, MSG_WAITALL) != 16) break;
-
-      if (p[3])
-      {
-         if (p[3] < sizeof(buf))
-         {
-            /* read extension into buf */
-            if (recv(sock, buf, p[3], MSG_WAITALL) != p[3])
-            {
-               /* Serious error.  No point continuing. */
-               DBG(DBG_ALWAYS,
-                  "recv failed for %d bytes, sock=%d", p[3], sock);
+   int fdC, c;
+   struct sockaddr_storage client;
 
-               closeOrphanedNotifications(-1, sock);
+   /* returns the accepted connection, -2 if the peer was refused */
 
-               close(sock);
+   c = sizeof(client);
 
-               return 0;
-            }
-         }
-         else
-         {
-            /* Serious error.  No point continuing. */
-            DBG(DBG_ALWAYS,
-               "ext too large %d(%d), sock=%d", p[3], sizeof(buf), sock);
+   fdC = accept(fd, (struct sockaddr *)&client, (socklen_t*)&c);
 
-            closeOrphanedNotifications(-1, sock);
+   if (fdC < 0) return fdC;
 
-            close(sock);
+   closeOrphanedNotifications(-1, fdC, 0);
 
-            return 0;
-         }
+   if (client.ss_family == AF_UNIX)
+   {
+      if (!peerAllowed(fdC))
+      {
+         DBG(DBG_ALWAYS, "peer refused, sock=%d", fdC);
+         gpioStats.sockRejected++;
+         close(fdC);
+         return -2;
       }
+   }
+   else if (!addrAllowed((struct sockaddr *)&client))
+   {
+      close(fdC);
+      return -2;
+   }
 
-      /* add null terminator in case it's a string */
+   return fdC;
+}
 
-      buf[p[3]] = 0;
+/* ----------------------------------------------------------------------- */
 
-      switch (p[0])
-      {
-         case PI_CMD_NOIB:
+static int sockAcceptRetry(int *backoff)
+{
+   int err = errno;
 
-            p[3] = gpioNotifyOpenInBand(sock);
+   /* returns 1 if accept failed for a reason which may pass.  Out of
+      descriptors or memory the listening socket stays readable, so
+      wait a while, longer each time, before trying again. */
 
-           /* Enable the Nagle algorithm. */
-            opt = 0;
-            setsockopt(
-               sock, IPPROTO_TCP, TCP_NODELAY, (char*)&opt, sizeof(int));
+   switch (err)
+   {
+      case EINTR:
+      case EAGAIN:
+      case ECONNABORTED:
+      case EPROTO:
+      case EPERM:
+         return 1;
 
-            break;
+      case EMFILE:
+      case ENFILE:
+      case ENOBUFS:
+      case ENOMEM:
+         if (*backoff < SOCK_BACKOFF_MIN) *backoff = SOCK_BACKOFF_MIN;
+         else if (*backoff < SOCK_BACKOFF_MAX) *backoff *= 2;
 
-         case PI_CMD_PROCP:
-            p[3] = myDoCommand(p, sizeof(buf)-1, buf+sizeof(int));
-            if (((int)p[3]) >= 0)
-            {
-               memcpy(buf, &p[3], 4);
-               p[3] = 4 + (4*PI_MAX_SCRIPT_PARAMS);
-            }
-            break;
+         if (*backoff > SOCK_BACKOFF_MAX) *backoff = SOCK_BACKOFF_MAX;
 
-         default:
-            p[3] = myDoCommand(p, sizeof(buf)-1, buf);
-      }
+         DBG(DBG_ALWAYS, "accept failed (%s), retry in %d ms",
+            strerror(err), *backoff);
 
-      write(sock, p, 16);
+         myGpioSleep(*backoff / 1000, (*backoff % 1000) * 1000);
 
-      switch (p[0])
-      {
-         /* extensions */
+         return 1;
+   }
 
-         case PI_CMD_BI2CZ:
-         case PI_CMD_BSCX:
-         case PI_CMD_CF2:
-         case PI_CMD_FL:
-         case PI_CMD_FR:
-         case PI_CMD_I2CPK:
-         case PI_CMD_I2CRD:
-         case PI_CMD_I2CRI:
-         case PI_CMD_I2CRK:
-         case PI_CMD_I2CZ:
-         case PI_CMD_PROCP:
-         case PI_CMD_SERR:
-         case PI_CMD_SLR:
-         case PI_CMD_SPIX:
-         case PI_CMD_SPIR:
-         case PI_CMD_BSPIX:
+   return 0;
+}
 
-            if (((int)p[3]) > 0)
-            {
-               write(sock, buf, p[3]);
-            }
-            break;
+/* ----------------------------------------------------------------------- */
 
-         default:
-           break;
-      }
-   }
+static void * pthSocketThread(void *x)
+{
+   int fdC=0, l, opt, conns, backoff=0;
+   struct pollfd pfd[2];
+   struct epoll_event ev;
+   sockConn_t *conn;
 
-   closeOrphanedNotifications(-1, sock);
+   /* fdSock and fdSockUnix opened in gpioInitialise so that we can
+      treat failure to bind as fatal. */
 
-   close(sock);
+   listen(fdSock, 100);
 
-   return 0;
-}
+   if (fdSockUnix != -1) listen(fdSockUnix, 100);
 
-static int addrAllowed(struct sockaddr *saddr)
-{
-   int i;
-   uint32_t addr;
+   pfd[0].fd = fdSock;
+   pfd[0].events = POLLIN;
 
-   if (!numSockNetAddr) return 1;
+   /* poll ignores a negative fd */
 
-   // FIXME: add IPv6 whitelisting support
-   if (saddr->sa_family != AF_INET) return 0;
+   pfd[1].fd = fdSockUnix;
+   pfd[1].events = POLLIN;
 
-   addr = ((struct sockaddr_in *) saddr)->sin_addr.s_addr;
+   /* don't start until DMA started */
 
-   for (i=0; i<numSockNetAddr; i++)
+   spinWhileStarting();
+
+   while (fdC >= 0)
    {
-      if (addr == sockNetAddr[i]) return 1;
-   }
-   return 0;
-}
+      if (poll(pfd, 2, -1) < 0)
+      {
+         if (errno == EINTR) continue;
+         fdC = -1;
+         break;
+      }
 
-/* ----------------------------------------------------------------------- */
+      for (l=0; l<2; l++)
+      {
+         if (!(pfd[l].revents & POLLIN)) continue;
 
-static void * pthSocketThread(void *x)
-{
-   int fdC=0, c, *sock;
-   struct sockaddr_storage client;
-   pthread_attr_t attr;
+         fdC = sockAccept(pfd[l].fd);
 
-   if (pthread_attr_init(&attr))
-      SOFT_ERROR((void*)PI_INIT_FAILED,
-         "pthread_attr_init failed (%m)");
+         if (fdC == -2)
+         {
+            fdC = 0;
+            continue;
+         }
 
-   if (pthread_attr_setstacksize(&attr, STACK_SIZE))
-      SOFT_ERROR((void*)PI_INIT_FAILED,
-         "pthread_attr_setstacksize failed (%m)");
+         if (fdC < 0)
+         {
+            if (sockAcceptRetry(&backoff))
+            {
+               fdC = 0;
+               continue;
+            }
+            break;
+         }
 
-   if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED))
-      SOFT_ERROR((void*)PI_INIT_FAILED,
-         "pthread_attr_setdetachstate failed (%m)");
+         backoff = 0;
 
-   /* fdSock opened in gpioInitialise so that we can treat
-      failure to bind as fatal. */
+         if (sockConns >= gpioCfg.sockMaxConns)
+         {
+            DBG(DBG_ALWAYS, "too many connections (%d), sock=%d",
+               sockConns, fdC);
 
-   listen(fdSock, 100);
+            gpioStats.sockRejected++;
 
-   c = sizeof(client);
+            close(fdC);
+            continue;
+         }
 
-   /* don't start until DMA started */
+         conn = calloc(1, sizeof(sockConn_t));
 
-   spinWhileStarting();
+         if (conn == NULL)
+         {
+            DBG(DBG_ALWAYS, "calloc failed, sock=%d", fdC);
+            close(fdC);
+            continue;
+         }
 
-   while (fdC >= 0)
-   {
-      pthread_t thr;
+         conn->fd = fdC;
+         conn->opened = time(NULL);
 
-      fdC = accept(fdSock, (struct sockaddr *)&client, (socklen_t*)&c);
+         /* Disable the Nagle algorithm. */
+         if (pfd[l].fd == fdSock)
+         {
+            opt = 1;
+            setsockopt(
+               fdC, IPPROTO_TCP, TCP_NODELAY, (char*)&opt, sizeof(int));
+         }
 
-      closeOrphanedNotifications(-1, fdC);
+         conns = __atomic_add_fetch(&sockConns, 1, __ATOMIC_RELAXED);
 
-      if (addrAllowed((struct sockaddr *)&client))
-      {
-         sock = malloc(sizeof(int));
+         if (conns > gpioStats.sockPeak) gpioStats.sockPeak = conns;
 
-         *sock = fdC;
+         gpioStats.sockAccepted++;
 
-         if (pthread_create
-            (&thr, &attr, pthSocketThreadHandler, (void*) sock) < 0)
-            SOFT_ERROR((void*)PI_INIT_FAILED,
-               "socket pthread_create failed (%m)");
-      }
-      else
-      {
-         close(fdC);
+         ev.events = EPOLLIN | EPOLLONESHOT;
+         ev.data.ptr = conn;
+
+         if (epoll_ctl(sockEpfd, EPOLL_CTL_ADD, fdC, &ev) < 0)
+         {
+            DBG(DBG_ALWAYS, "epoll_ctl failed (%m), sock=%d", fdC);
+            __atomic_sub_fetch(&sockConns, 1, __ATOMIC_RELAXED);
+            close(fdC);
+            free(conn);
+         }
       }
    }
 
@@ -7763,7 +10261,12 @@ static void initClearGlobals(void)
    DBG(DBG_STARTUP, "");
 
    alertBits   = 0;
+   alertBatchBits = 0;
    monitorBits = 0;
+   patternBits = 0;
+   patternMatch  = 0;
+   memset(&patternSet,   0, sizeof(patternSet));
+   memset(&patternLocal, 0, sizeof(patternLocal));
    notifyBits  = 0;
    scriptBits  = 0;
    gFilterBits = 0;
@@ -7773,6 +10276,7 @@ static void initClearGlobals(void)
    pthAlertRunning  = PI_THREAD_NONE;
    pthFifoRunning   = PI_THREAD_NONE;
    pthSocketRunning = PI_THREAD_NONE;
+   pthNotifyRunning = PI_THREAD_NONE;
 
    wfc[0] = 0;
    wfc[1] = 0;
@@ -7802,8 +10306,22 @@ static void initClearGlobals(void)
       wfRx[i].mode      = PI_WFRX_NONE;
       pthread_mutex_init(&wfRx[i].mutex, NULL);
       gpioAlert[i].func = NULL;
+      gpioAlert[i].batch = 0;
+      gpioAlert[i].dropped = 0;
+      gpioAlert[i].latency = 0;
+      alertRing[i].head = 0;
+      alertRing[i].tail = 0;
    }
 
+   patternRing.head = 0;
+   patternRing.tail = 0;
+
+   gpioGlitch.bits      = 0;
+   gpioGlitch.resetBits = 0;
+
+   gpioNoise.resetBits = 0;
+   gpioNoise.active    = 0;
+
    for (i=0; i<=PI_MAX_GPIO; i++)
    {
       gpioInfo [i].is      = GPIO_UNDEFINED;
@@ -7836,6 +10354,8 @@ static void initClearGlobals(void)
       eventAlert[i].func      = NULL;
       eventAlert[i].ignore    = 0;
       eventAlert[i].fired     = 0;
+
+      eventPattern[i].func    = NULL;
    }
 
    /* calculate the usable PWM frequencies */
@@ -7855,6 +10375,13 @@ static void initClearGlobals(void)
    fdLock       = -1;
    fdMem        = -1;
    fdSock       = -1;
+   fdSockUnix   = -1;
+   sockEpfd     = -1;
+
+   sockConns = 0;
+   sockWorkers = 0;
+   sockIdle = 0;
+   sockStopping = 0;
 
    dmaMboxBlk = MAP_FAILED;
    dmaPMapBlk = MAP_FAILED;
@@ -7910,6 +10437,47 @@ static void initReleaseResources(void)
       pthAlertRunning = PI_THREAD_NONE;
    }
 
+   if (pthNotifyRunning != PI_THREAD_NONE)
+   {
+      pthread_cancel(pthNotify);
+      pthread_join(pthNotify, NULL);
+      pthNotifyRunning = PI_THREAD_NONE;
+   }
+
+   if (notifyWakeFd >= 0)
+   {
+      close(notifyWakeFd);
+      notifyWakeFd = -1;
+   }
+
+   for (i=0; i<PI_MAX_ALERT_THREADS; i++)
+   {
+      if (alertDispatch[i].running)
+      {
+         pthread_cancel(alertDispatch[i].pthId);
+         pthread_join(alertDispatch[i].pthId, NULL);
+         sem_destroy(&alertDispatch[i].sem);
+         alertDispatch[i].running = 0;
+      }
+   }
+
+   alertThreads = 0;
+
+   for (i=0; i<=PI_MAX_USER_GPIO; i++)
+   {
+      free(alertRing[i].tick);
+      free(alertRing[i].level);
+      alertRing[i].tick  = NULL;
+      alertRing[i].level = NULL;
+   }
+
+   free(patternRing.tick);
+   free(patternRing.level);
+   free(patternRing.event);
+   patternRing.tick  = NULL;
+   patternRing.level = NULL;
+   patternRing.event = NULL;
+
    if (pthFifoRunning != PI_THREAD_NONE)
    {
       pthread_cancel(pthFifo);
@@ -7924,6 +10492,22 @@ static void initReleaseResources(void)
       pthSocketRunning = PI_THREAD_NONE;
    }
 
+   /* no more workers are started once stopping is set */
+
+   pthread_mutex_lock(&sockWorkerMutex);
+   sockStopping = 1;
+   pthread_mutex_unlock(&sockWorkerMutex);
+
+   for (i=0; i<SOCK_MAX_WORKERS; i++)
+   {
+      if (sockWorker[i].running)
+      {
+         pthread_cancel(sockWorker[i].pthId);
+         pthread_join(sockWorker[i].pthId, NULL);
+         sockWorker[i].running = 0;
+      }
+   }
+
    /* release mmap'd memory */
 
    if (auxReg  != MAP_FAILED) munmap((void *)auxReg,  AUX_LEN);
@@ -8028,6 +10612,19 @@ static void initReleaseResources(void)
       fdSock = -1;
    }
 
+   if (fdSockUnix != -1)
+   {
+      close(fdSockUnix);
+      unlink(sockPath);
+      fdSockUnix = -1;
+   }
+
+   if (sockEpfd != -1)
+   {
+      close(sockEpfd);
+      sockEpfd = -1;
+   }
+
    if (fdPmap != -1)
    {
       close(fdPmap);
@@ -8048,9 +10645,10 @@ static void initReleaseResources(void)
 
 int initInitialise(void)
 {
-   int rev, i, model;
+   int rev, i, j, model;
    struct sockaddr_in server;
    struct sockaddr_in6 server6;
+   struct sockaddr_un serverUnix;
    char * portStr;
    unsigned port;
    struct sched_param param;
@@ -8140,6 +10738,62 @@ int initInitialise(void)
    if (pthread_attr_setstacksize(&pthAttr, STACK_SIZE))
       SOFT_ERROR(PI_INIT_FAILED, "pthread_attr_setstacksize failed (%m)");
 
+   for (i=0; gpioCfg.alertThreads && (i<=PI_MAX_USER_GPIO); i++)
+   {
+      alertRing[i].tick  = malloc(gpioCfg.alertRingSize * sizeof(uint32_t));
+      alertRing[i].level = malloc(gpioCfg.alertRingSize);
+
+      if ((alertRing[i].tick == NULL) || (alertRing[i].level == NULL))
+         SOFT_ERROR(PI_INIT_FAILED, "malloc alert ring failed (%m)");
+   }
+
+   if (gpioCfg.alertThreads)
+   {
+      patternRing.tick  = malloc(gpioCfg.alertRingSize * sizeof(uint32_t));
+      patternRing.level = malloc(gpioCfg.alertRingSize * sizeof(uint32_t));
+      patternRing.event = malloc(gpioCfg.alertRingSize);
+
+      if ((patternRing.tick  == NULL) || (patternRing.level == NULL) ||
+          (patternRing.event == NULL))
+         SOFT_ERROR(PI_INIT_FAILED, "malloc pattern ring failed (%m)");
+   }
+
+   for (i=0; i<gpioCfg.alertThreads; i++)
+   {
+      alertDispatch[i].bits = 0;
+
+      alertDispatch[i].patterns = (i == 0);
+
+      for (j=i; j<=PI_MAX_USER_GPIO; j+=gpioCfg.alertThreads)
+      {
+         alertDispatch[i].bits |= (1<<j);
+      }
+
+      if (sem_init(&alertDispatch[i].sem, 0, 0))
+         SOFT_ERROR(PI_INIT_FAILED, "sem_init dispatch failed (%m)");
+
+      if (pthread_create(&alertDispatch[i].pthId, &pthAttr,
+            pthAlertDispatchThread, &alertDispatch[i]))
+      {
+         sem_destroy(&alertDispatch[i].sem);
+         SOFT_ERROR(PI_INIT_FAILED, "pthread_create dispatch failed (%m)");
+      }
+
+      alertDispatch[i].running = 1;
+
+      alertThreads = i + 1;
+   }
+
+   notifyWakeFd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+
+   if (notifyWakeFd < 0)
+      SOFT_ERROR(PI_INIT_FAILED, "eventfd failed (%m)");
+
+   if (pthread_create(&pthNotify, &pthAttr, pthNotifyThread, &i))
+      SOFT_ERROR(PI_INIT_FAILED, "pthread_create notify failed (%m)");
+
+   pthNotifyRunning = PI_THREAD_STARTED;
+
    if (pthread_create(&pthAlert, &pthAttr, pthAlertThread, &i))
       SOFT_ERROR(PI_INIT_FAILED, "pthread_create alert failed (%m)");
 
@@ -8204,6 +10858,51 @@ int initInitialise(void)
             SOFT_ERROR(PI_INIT_FAILED, "bind to port %d failed (%m)", port);
       }
 
+      if (sockPath[0])
+      {
+         fdSockUnix = socket(AF_UNIX, SOCK_STREAM, 0);
+
+         if (fdSockUnix == -1)
+            SOFT_ERROR(PI_INIT_FAILED, "socket failed (%m)");
+
+         memset(&serverUnix, 0, sizeof(serverUnix));
+         serverUnix.sun_family = AF_UNIX;
+         strcpy(serverUnix.sun_path, sockPath);
+
+         /* any file left by an earlier run, the lock file ensures
+            it is not in use */
+
+         unlink(sockPath);
+
+         if (bind(fdSockUnix, (struct sockaddr *)&serverUnix,
+               sizeof(serverUnix)) < 0)
+            SOFT_ERROR(PI_INIT_FAILED, "bind to %s failed (%m)", sockPath);
+
+         /* only the group may connect, access is also checked with
+            the peer credentials */
+
+         if (gpioCfg.sockGid >= 0)
+         {
+            if (chown(sockPath, -1, gpioCfg.sockGid) < 0)
+               SOFT_ERROR(PI_INIT_FAILED, "chown %s failed (%m)", sockPath);
+
+            chmod(sockPath, 0660);
+         }
+         else chmod(sockPath, 0600);
+      }
+
+      sockEpfd = epoll_create1(EPOLL_CLOEXEC);
+
+      if (sockEpfd < 0)
+         SOFT_ERROR(PI_INIT_FAILED, "epoll_create1 failed (%m)");
+
+      for (i=0; i<gpioCfg.sockThreads; i++)
+      {
+         if (sockWorkerStart())
+            SOFT_ERROR(PI_INIT_FAILED,
+               "pthread_create socket worker failed (%m)");
+      }
+
       if (pthread_create(&pthSocket, &pthAttr, pthSocketThread, &i))
          SOFT_ERROR(PI_INIT_FAILED, "pthread_create socket failed (%m)");
 
@@ -8520,12 +11219,49 @@ void gpioTerminate(void)
       fprintf(stderr, "cbTicks %d, cbCalls %u\n",
          gpioStats.cbTicks, gpioStats.cbCalls);
 
-      fprintf(stderr, "pipe: good %u, short %u, would block %u\n",
+      fprintf(stderr,
+         "pipe: good %u, short %u, would block %u, overflow %u\n",
          gpioStats.goodPipeWrite, gpioStats.shortPipeWrite,
-         gpioStats.wouldBlockPipeWrite);
+         gpioStats.wouldBlockPipeWrite, gpioStats.notifyOverflow);
+
+      fprintf(stderr,
+         "alertTicks %u, alertIdle %u, lateTicks %u, moreToDo %u\n",
+         gpioStats.alertTicks, gpioStats.alertIdle,
+         gpioStats.lateTicks, gpioStats.moreToDo);
+
+      if (gpioCfg.alertThreads)
+      {
+         fprintf(stderr, "alert dispatch: threads %u, dropped %u\n",
+            gpioCfg.alertThreads, gpioStats.alertDropped);
 
-      fprintf(stderr, "alertTicks %u, lateTicks %u, moreToDo %u\n",
-         gpioStats.alertTicks, gpioStats.lateTicks, gpioStats.moreToDo);
+         for (i=0; i<=PI_MAX_USER_GPIO; i++)
+         {
+            if (gpioAlert[i].dropped)
+               fprintf(stderr, "   gpio %d dropped %u\n",
+                  i, gpioAlert[i].dropped);
+         }
+      }
+
+      fprintf(stderr,
+         "sockets: accepted %u, rejected %u, peak %u, deferred %u, "
+         "workers %u\n",
+         gpioStats.sockAccepted, gpioStats.sockRejected,
+         gpioStats.sockPeak, gpioStats.sockDeferred,
+         gpioStats.sockPeakWorkers);
+
+      for (i=0; i<PI_LATENCY_BINS; i++)
+      {
+         if (gpioStats.latency[PI_LATENCY_ALERT][i]  ||
+             gpioStats.latency[PI_LATENCY_NOTIFY][i] ||
+             gpioStats.latency[PI_LATENCY_SCRIPT][i])
+         {
+            fprintf(stderr, "latency <%8u us: alert %u notify %u script %u\n",
+               2<<i,
+               gpioStats.latency[PI_LATENCY_ALERT][i],
+               gpioStats.latency[PI_LATENCY_NOTIFY][i],
+               gpioStats.latency[PI_LATENCY_SCRIPT][i]);
+         }
+      }
 
       for (i=0; i< TICKSLOTS; i++)
          fprintf(stderr, "%9u ", gpioStats.diffTick[i]);
@@ -11250,48 +13986,221 @@ int eventTrigger(unsigned event)
 }
 
 
+/* ----------------------------------------------------------------------- */
+
+int eventSetPattern(unsigned event, uint32_t mask, uint32_t pattern)
+{
+   static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+   uint32_t seq, events, bits;
+   int i;
+
+   DBG(DBG_USER, "event=%d mask=%08X pattern=%08X", event, mask, pattern);
+
+   CHECK_INITED;
+
+   if (event > PI_MAX_EVENT)
+      SOFT_ERROR(PI_BAD_EVENT_ID, "bad event (%d)", event);
+
+   if (pattern & ~mask)
+      SOFT_ERROR(PI_BAD_PATTERN, "bad pattern (%08X) for mask (%08X)",
+         pattern, mask);
+
+   /* the alert thread copies the whole set once per pass
+      (alertGetPatterns) so it never sees a mask without its pattern */
+
+   pthread_mutex_lock(&mutex);
+
+   if (mask) events = patternSet.events |  (1<<event);
+   else      events = patternSet.events & ~(1<<event);
+
+   bits = 0;
+
+   for (i=0; i<=PI_MAX_EVENT; i++)
+   {
+      if (i == event)           bits |= mask;
+      else if (events & (1<<i)) bits |= patternSet.mask[i];
+   }
+
+   seq = patternSet.seq;
+
+   __atomic_store_n(&patternSet.seq, seq + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+
+   __atomic_store_n(&patternSet.mask[event],    mask,    __ATOMIC_RELAXED);
+   __atomic_store_n(&patternSet.pattern[event], pattern, __ATOMIC_RELAXED);
+   __atomic_store_n(&patternSet.events,         events,  __ATOMIC_RELAXED);
+   __atomic_store_n(&patternSet.bits,           bits,    __ATOMIC_RELAXED);
+
+   __atomic_store_n(&patternSet.seq, seq + 2, __ATOMIC_RELEASE);
+
+   pthread_mutex_unlock(&mutex);
+
+   patternBits = bits;
+
+   monitorBits = alertBits | notifyBits | scriptBits | gpioGetSamples.bits |
+                 patternBits;
+
+   return 0;
+}
+
+
+/* ----------------------------------------------------------------------- */
+
+int eventSetPatternFunc(
+   unsigned event, eventPatternFunc_t f, void *userdata)
+{
+   DBG(DBG_USER, "event=%d function=%08X userdata=%08X",
+      event, (uint32_t)f, (uint32_t)userdata);
+
+   CHECK_INITED;
+
+   if (event > PI_MAX_EVENT)
+      SOFT_ERROR(PI_BAD_EVENT_ID, "bad event (%d)", event);
+
+   eventPattern[event].userdata = userdata;
+
+   eventPattern[event].func = f;
+
+   return 0;
+}
+
+
 /* ----------------------------------------------------------------------- */
 
 static int intGpioSetAlertFunc(
    unsigned gpio,
    void *   f,
    int      user,
+   int      batch,
    void *   userdata)
 {
-   DBG(DBG_INTERNAL, "gpio=%d function=%08X, user=%d, userdata=%08X",
-      gpio, (uint32_t)f, user, (uint32_t)userdata);
+   static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+   gpioAlert_t *a = &gpioAlert[gpio];
+   uint32_t seq;
+
+   DBG(DBG_INTERNAL, "gpio=%d function=%08X, user=%d, batch=%d, userdata=%08X",
+      gpio, (uint32_t)f, user, batch, (uint32_t)userdata);
+
+   pthread_mutex_lock(&mutex);
+
+   alertBits &= ~BIT;
+
+   /* the alert and dispatcher threads read func together with how to
+      call it (alertGetFunc), so a mode change can't call a function
+      with the wrong arguments */
+
+   seq = a->seq;
+
+   __atomic_store_n(&a->seq, seq + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+
+   __atomic_store_n(&a->func,     f,        __ATOMIC_RELAXED);
+   __atomic_store_n(&a->ex,       user,     __ATOMIC_RELAXED);
+   __atomic_store_n(&a->batch,    batch,    __ATOMIC_RELAXED);
+   __atomic_store_n(&a->userdata, userdata, __ATOMIC_RELAXED);
+
+   __atomic_store_n(&a->seq, seq + 2, __ATOMIC_RELEASE);
 
-   gpioAlert[gpio].ex = user;
-   gpioAlert[gpio].userdata = userdata;
+   if (batch) alertBatchBits |= BIT;
+   else       alertBatchBits &= ~BIT;
 
-   gpioAlert[gpio].func = f;
+   pthread_mutex_unlock(&mutex);
 
    if (f)
    {
       alertBits |= BIT;
    }
-   else
-   {
-      alertBits &= ~BIT;
-   }
 
-   monitorBits = alertBits | notifyBits | scriptBits | gpioGetSamples.bits;
+   monitorBits = alertBits | notifyBits | scriptBits | gpioGetSamples.bits |
+                 patternBits;
+
+   return 0;
+}
+
+/* ----------------------------------------------------------------------- */
+
+int gpioSetAlertFunc(unsigned gpio, gpioAlertFunc_t f)
+{
+   DBG(DBG_USER, "gpio=%d function=%08X", gpio, (uint32_t)f);
+
+   CHECK_INITED;
+
+   if (gpio > PI_MAX_USER_GPIO)
+      SOFT_ERROR(PI_BAD_USER_GPIO, "bad gpio (%d)", gpio);
+
+   intGpioSetAlertFunc(gpio, f, 0, 0, NULL);
+
+   return 0;
+}
+
+
+/* ----------------------------------------------------------------------- */
+
+int gpioSetAlertFuncEx(unsigned gpio, gpioAlertFuncEx_t f, void *userdata)
+{
+   DBG(DBG_USER, "gpio=%d function=%08X userdata=%08X",
+      gpio, (uint32_t)f, (uint32_t)userdata);
+
+   CHECK_INITED;
+
+   if (gpio > PI_MAX_USER_GPIO)
+      SOFT_ERROR(PI_BAD_USER_GPIO, "bad gpio (%d)", gpio);
+
+   intGpioSetAlertFunc(gpio, f, 1, 0, userdata);
+
+   return 0;
+}
+
+/* ----------------------------------------------------------------------- */
+
+int gpioSetAlertBatchFunc(
+   unsigned gpio, gpioAlertBatchFunc_t f, void *userdata)
+{
+   DBG(DBG_USER, "gpio=%d function=%08X userdata=%08X",
+      gpio, (uint32_t)f, (uint32_t)userdata);
+
+   CHECK_INITED;
+
+   if (gpio > PI_MAX_USER_GPIO)
+      SOFT_ERROR(PI_BAD_USER_GPIO, "bad gpio (%d)", gpio);
+
+   intGpioSetAlertFunc(gpio, f, 1, 1, userdata);
 
    return 0;
 }
 
+
+/* ----------------------------------------------------------------------- */
+
+int gpioGetAlertDropped(unsigned gpio)
+{
+   DBG(DBG_USER, "gpio=%d", gpio);
+
+   CHECK_INITED;
+
+   if (gpio > PI_MAX_USER_GPIO)
+      SOFT_ERROR(PI_BAD_USER_GPIO, "bad gpio (%d)", gpio);
+
+   return gpioAlert[gpio].dropped & 0x7FFFFFFF;
+}
+
+
 /* ----------------------------------------------------------------------- */
 
-int gpioSetAlertFunc(unsigned gpio, gpioAlertFunc_t f)
+int gpioSetAlertLatency(unsigned gpio, unsigned latency)
 {
-   DBG(DBG_USER, "gpio=%d function=%08X", gpio, (uint32_t)f);
+   DBG(DBG_USER, "gpio=%d latency=%d", gpio, latency);
 
    CHECK_INITED;
 
    if (gpio > PI_MAX_USER_GPIO)
       SOFT_ERROR(PI_BAD_USER_GPIO, "bad gpio (%d)", gpio);
 
-   intGpioSetAlertFunc(gpio, f, 0, NULL);
+   if (latency &&
+      ((latency < PI_MIN_LATENCY) || (latency > PI_MAX_LATENCY)))
+      SOFT_ERROR(PI_BAD_LATENCY, "bad latency (%d)", latency);
+
+   gpioAlert[gpio].latency = latency;
 
    return 0;
 }
@@ -11299,19 +14208,28 @@ int gpioSetAlertFunc(unsigned gpio, gpioAlertFunc_t f)
 
 /* ----------------------------------------------------------------------- */
 
-int gpioSetAlertFuncEx(unsigned gpio, gpioAlertFuncEx_t f, void *userdata)
+int gpioGetLatency(unsigned type, unsigned reset, uint32_t *bins)
 {
-   DBG(DBG_USER, "gpio=%d function=%08X userdata=%08X",
-      gpio, (uint32_t)f, (uint32_t)userdata);
+   int i;
+
+   DBG(DBG_USER, "type=%d reset=%d bins=%08X", type, reset, (uint32_t)bins);
 
    CHECK_INITED;
 
-   if (gpio > PI_MAX_USER_GPIO)
-      SOFT_ERROR(PI_BAD_USER_GPIO, "bad gpio (%d)", gpio);
+   if (type >= PI_LATENCY_TYPES)
+      SOFT_ERROR(PI_BAD_LATENCY_TYPE, "bad type (%d)", type);
 
-   intGpioSetAlertFunc(gpio, f, 1, userdata);
+   for (i=0; i<PI_LATENCY_BINS; i++)
+   {
+      if (reset)
+         bins[i] = __atomic_exchange_n(
+            &gpioStats.latency[type][i], 0, __ATOMIC_RELAXED);
+      else
+         bins[i] = __atomic_load_n(
+            &gpioStats.latency[type][i], __ATOMIC_RELAXED);
+   }
 
-   return 0;
+   return PI_LATENCY_BINS;
 }
 
 static void *pthISRThread(void *x)
@@ -11521,23 +14439,48 @@ int gpioSetISRFuncEx(
    return intGpioSetISRFunc(gpio, edge, timeout, f, 1, userdata);
 }
 
-static void closeOrphanedNotifications(int slot, int fd)
+static int closeOrphanedNotifications(int slot, int fd, int release)
 {
-   int i;
+   int i, closing = 0, owned = 0;
 
-   /* Check for and close any orphaned notifications. */
+   /*
+   Check for and close any orphaned notifications.  The notify thread
+   finishes the close.  If release is set fd is being closed, it is
+   then left to the notify thread if a handle is still using it.
+   Returns 1 if so.
+   */
+
+   notifyMutex(1);
 
    for (i=0; i<PI_NOTIFY_SLOTS; i++)
    {
       if ((i != slot) &&
-          (gpioNotify[i].state >= PI_NOTIFY_OPENED) &&
+          (gpioNotify[i].state >= PI_NOTIFY_CLOSING) &&
           (gpioNotify[i].fd == fd))
       {
-         DBG(DBG_USER, "closed orphaned fd=%d (handle=%d)", fd, i);
-         gpioNotify[i].state = PI_NOTIFY_CLOSED;
-         intNotifyBits();
+         if (gpioNotify[i].state >= PI_NOTIFY_OPENED)
+         {
+            DBG(DBG_USER, "closed orphaned fd=%d (handle=%d)", fd, i);
+            gpioNotify[i].bits  = 0;
+            gpioNotify[i].state = PI_NOTIFY_CLOSING;
+            closing = 1;
+         }
+
+         if (release && !owned)
+         {
+            gpioNotify[i].closeFd = 1;
+            owned = 1;
+         }
       }
    }
+
+   notifyMutex(0);
+
+   if (closing) intNotifyBits();
+
+   if (owned) notifyWake();
+
+   return owned;
 }
 
 /* ----------------------------------------------------------------------- */
@@ -11605,11 +14548,23 @@ int gpioNotifyOpenWithSize(int bufSize)
    gpioNotify[slot].bits  = 0;
    gpioNotify[slot].fd    = fd;
    gpioNotify[slot].pipe  = 1;
+   gpioNotify[slot].closeFd = 0;
    gpioNotify[slot].max_emits  = MAX_EMITS;
+   gpioNotify[slot].qHead = 0;
+   gpioNotify[slot].qTail = 0;
+   gpioNotify[slot].sHead = 0;
+   gpioNotify[slot].sTail = 0;
+   gpioNotify[slot].overflow = 0;
+   gpioNotify[slot].shm   = NULL;
+   gpioNotify[slot].encoding = PI_NOTIFY_ENC_RAW;
+   gpioNotify[slot].risingBits  = 0xFFFFFFFF;
+   gpioNotify[slot].fallingBits = 0xFFFFFFFF;
+   gpioNotify[slot].steadyUs = 0;
+   gpioNotify[slot].latency  = 0;
    gpioNotify[slot].lastReportTick = gpioTick();
    gpioNotify[i].state = PI_NOTIFY_OPENED;
 
-   closeOrphanedNotifications(slot, fd);
+   closeOrphanedNotifications(slot, fd, 0);
 
    return slot;
 }
@@ -11621,6 +14576,142 @@ int gpioNotifyOpen(void)
 
 /* ----------------------------------------------------------------------- */
 
+int gpioNotifyOpenShm(unsigned reports)
+{
+   int i, slot, fd, efd;
+   char name[32];
+   size_t len;
+   gpioNotifyShm_t *shm;
+
+   DBG(DBG_USER, "reports=%d", reports);
+
+   CHECK_INITED;
+
+   if ((reports < PI_MIN_NOTIFY_SHM) || (reports > PI_MAX_NOTIFY_SHM) ||
+       (reports & (reports - 1)))
+      SOFT_ERROR(PI_BAD_PARAM, "bad reports (%d)", reports);
+
+   slot = -1;
+
+   notifyMutex(1);
+
+   for (i=0; i<PI_NOTIFY_SLOTS; i++)
+   {
+      if (gpioNotify[i].state == PI_NOTIFY_CLOSED)
+      {
+         slot = i;
+         gpioNotify[slot].state = PI_NOTIFY_RESERVED;
+         break;
+      }
+   }
+
+   notifyMutex(0);
+
+   if (slot < 0) SOFT_ERROR(PI_NO_HANDLE, "no handle");
+
+   sprintf(name, "/pigpio%d", slot);
+
+   len = sizeof(gpioNotifyShm_t) + (reports * sizeof(gpioReport_t));
+
+   /* a fresh object each time, never one somebody else created */
+
+   shm_unlink(name);
+
+   fd = shm_open(name, O_RDWR|O_CREAT|O_EXCL, PI_NOTIFY_SHM_MODE);
+
+   if (fd < 0)
+   {
+      gpioNotify[slot].state = PI_NOTIFY_CLOSED;
+      SOFT_ERROR(PI_BAD_PATHNAME, "shm_open %s failed (%m)", name);
+   }
+
+   /* consumers write their cursors so must be able to map it
+      read/write, despite the umask */
+
+   if (fchmod(fd, PI_NOTIFY_SHM_MODE) < 0)
+      DBG(DBG_ALWAYS, "Can't set permissions (%o) for %s, %m",
+         PI_NOTIFY_SHM_MODE, name);
+
+   if (ftruncate(fd, len) < 0)
+   {
+      close(fd);
+      shm_unlink(name);
+      gpioNotify[slot].state = PI_NOTIFY_CLOSED;
+      SOFT_ERROR(PI_BAD_PATHNAME, "ftruncate %s failed (%m)", name);
+   }
+
+   shm = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+
+   close(fd);
+
+   if (shm == MAP_FAILED)
+   {
+      shm_unlink(name);
+      gpioNotify[slot].state = PI_NOTIFY_CLOSED;
+      SOFT_ERROR(PI_BAD_PATHNAME, "mmap %s failed (%m)", name);
+   }
+
+   efd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+
+   if (efd < 0)
+   {
+      munmap(shm, len);
+      shm_unlink(name);
+      gpioNotify[slot].state = PI_NOTIFY_CLOSED;
+      SOFT_ERROR(PI_BAD_PATHNAME, "eventfd failed (%m)");
+   }
+
+   shm->size  = reports;
+   shm->head  = 0;
+   __atomic_store_n(&shm->magic, PI_NOTIFY_SHM_MAGIC, __ATOMIC_RELEASE);
+
+   gpioNotify[slot].seqno = 0;
+   gpioNotify[slot].bits  = 0;
+   gpioNotify[slot].fd    = -1;
+   gpioNotify[slot].pipe  = 0;
+   gpioNotify[slot].closeFd = 0;
+   gpioNotify[slot].max_emits  = MAX_EMITS;
+   gpioNotify[slot].qHead = 0;
+   gpioNotify[slot].qTail = 0;
+   gpioNotify[slot].sHead = 0;
+   gpioNotify[slot].sTail = 0;
+   gpioNotify[slot].overflow = 0;
+   gpioNotify[slot].shm   = shm;
+   gpioNotify[slot].shmLen = len;
+   gpioNotify[slot].shmHead = 0;
+   gpioNotify[slot].shmSize = reports;
+   gpioNotify[slot].efd   = efd;
+   gpioNotify[slot].encoding = PI_NOTIFY_ENC_RAW;
+   gpioNotify[slot].risingBits  = 0xFFFFFFFF;
+   gpioNotify[slot].fallingBits = 0xFFFFFFFF;
+   gpioNotify[slot].steadyUs = 0;
+   gpioNotify[slot].latency  = 0;
+   gpioNotify[slot].lastReportTick = gpioTick();
+   gpioNotify[slot].state = PI_NOTIFY_OPENED;
+
+   return slot;
+}
+
+/* ----------------------------------------------------------------------- */
+
+int gpioNotifyGetEventFd(unsigned handle)
+{
+   DBG(DBG_USER, "handle=%d", handle);
+
+   CHECK_INITED;
+
+   if (handle >= PI_NOTIFY_SLOTS)
+      SOFT_ERROR(PI_BAD_HANDLE, "bad handle (%d)", handle);
+
+   if ((gpioNotify[handle].state < PI_NOTIFY_OPENED) ||
+       (gpioNotify[handle].shm == NULL))
+      SOFT_ERROR(PI_BAD_HANDLE, "bad handle (%d)", handle);
+
+   return gpioNotify[handle].efd;
+}
+
+/* ----------------------------------------------------------------------- */
+
 static int gpioNotifyOpenInBand(int fd)
 {
    int i, slot;
@@ -11651,11 +14742,23 @@ static int gpioNotifyOpenInBand(int fd)
    gpioNotify[slot].bits  = 0;
    gpioNotify[slot].fd    = fd;
    gpioNotify[slot].pipe  = 0;
+   gpioNotify[slot].closeFd = 0;
    gpioNotify[slot].max_emits  = MAX_EMITS;
+   gpioNotify[slot].qHead = 0;
+   gpioNotify[slot].qTail = 0;
+   gpioNotify[slot].sHead = 0;
+   gpioNotify[slot].sTail = 0;
+   gpioNotify[slot].overflow = 0;
+   gpioNotify[slot].shm   = NULL;
+   gpioNotify[slot].encoding = PI_NOTIFY_ENC_RAW;
+   gpioNotify[slot].risingBits  = 0xFFFFFFFF;
+   gpioNotify[slot].fallingBits = 0xFFFFFFFF;
+   gpioNotify[slot].steadyUs = 0;
+   gpioNotify[slot].latency  = 0;
    gpioNotify[slot].lastReportTick = gpioTick();
    gpioNotify[slot].state = PI_NOTIFY_OPENED;
 
-   closeOrphanedNotifications(slot, fd);
+   closeOrphanedNotifications(slot, fd, 0);
 
    return slot;
 }
@@ -11680,7 +14783,8 @@ static void intScriptBits(void)
 
    scriptBits = bits;
 
-   monitorBits = alertBits | notifyBits | scriptBits | gpioGetSamples.bits;
+   monitorBits = alertBits | notifyBits | scriptBits | gpioGetSamples.bits |
+                 patternBits;
 }
 
 
@@ -11720,7 +14824,8 @@ static void intNotifyBits(void)
 
    notifyBits = bits;
 
-   monitorBits = alertBits | notifyBits | scriptBits | gpioGetSamples.bits;
+   monitorBits = alertBits | notifyBits | scriptBits | gpioGetSamples.bits |
+                 patternBits;
 }
 
 
@@ -11740,6 +14845,8 @@ int gpioNotifyBegin(unsigned handle, uint32_t bits)
 
    gpioNotify[handle].bits  = bits;
 
+   gpioNotify[handle].gReset = 1;
+
    gpioNotify[handle].state = PI_NOTIFY_RUNNING;
 
    intNotifyBits();
@@ -11772,6 +14879,125 @@ int gpioNotifyPause (unsigned handle)
 }
 
 
+/* ----------------------------------------------------------------------- */
+
+int gpioNotifyEncoding(unsigned handle, unsigned encoding)
+{
+   DBG(DBG_USER, "handle=%d encoding=%d", handle, encoding);
+
+   CHECK_INITED;
+
+   if (handle >= PI_NOTIFY_SLOTS)
+      SOFT_ERROR(PI_BAD_HANDLE, "bad handle (%d)", handle);
+
+   if ((gpioNotify[handle].state <= PI_NOTIFY_CLOSING) ||
+       (gpioNotify[handle].shm != NULL))
+      SOFT_ERROR(PI_BAD_HANDLE, "bad handle (%d)", handle);
+
+   if (encoding > PI_NOTIFY_ENC_DELTA)
+      SOFT_ERROR(PI_BAD_PARAM, "bad encoding (%d)", encoding);
+
+   /* the stream restarts with a keyframe */
+
+   gpioNotify[handle].codec.count = -1;
+
+   __atomic_store_n(
+      &gpioNotify[handle].encoding, encoding, __ATOMIC_RELEASE);
+
+   return 0;
+}
+
+
+/* ----------------------------------------------------------------------- */
+
+int gpioNotifyEdges(unsigned handle, uint32_t bits, unsigned edge)
+{
+   DBG(DBG_USER, "handle=%d bits=%08X edge=%d", handle, bits, edge);
+
+   CHECK_INITED;
+
+   if (handle >= PI_NOTIFY_SLOTS)
+      SOFT_ERROR(PI_BAD_HANDLE, "bad handle (%d)", handle);
+
+   if (gpioNotify[handle].state <= PI_NOTIFY_CLOSING)
+      SOFT_ERROR(PI_BAD_HANDLE, "bad handle (%d)", handle);
+
+   switch (edge)
+   {
+      case RISING_EDGE:
+         __sync_fetch_and_or (&gpioNotify[handle].risingBits,   bits);
+         __sync_fetch_and_and(&gpioNotify[handle].fallingBits, ~bits);
+         break;
+
+      case FALLING_EDGE:
+         __sync_fetch_and_and(&gpioNotify[handle].risingBits,  ~bits);
+         __sync_fetch_and_or (&gpioNotify[handle].fallingBits,  bits);
+         break;
+
+      case EITHER_EDGE:
+         __sync_fetch_and_or (&gpioNotify[handle].risingBits,   bits);
+         __sync_fetch_and_or (&gpioNotify[handle].fallingBits,  bits);
+         break;
+
+      default:
+         SOFT_ERROR(PI_BAD_EDGE, "bad edge (%d)", edge);
+   }
+
+   return 0;
+}
+
+
+/* ----------------------------------------------------------------------- */
+
+int gpioNotifyGlitch(unsigned handle, unsigned steady)
+{
+   DBG(DBG_USER, "handle=%d steady=%d", handle, steady);
+
+   CHECK_INITED;
+
+   if (handle >= PI_NOTIFY_SLOTS)
+      SOFT_ERROR(PI_BAD_HANDLE, "bad handle (%d)", handle);
+
+   if (gpioNotify[handle].state <= PI_NOTIFY_CLOSING)
+      SOFT_ERROR(PI_BAD_HANDLE, "bad handle (%d)", handle);
+
+   if (steady > PI_MAX_STEADY)
+      SOFT_ERROR(PI_BAD_FILTER, "bad steady (%d)", steady);
+
+   /* the alert thread restarts the filter state on its next pass */
+
+   gpioNotify[handle].gReset = 1;
+
+   __atomic_store_n(&gpioNotify[handle].steadyUs, steady, __ATOMIC_RELEASE);
+
+   return 0;
+}
+
+
+/* ----------------------------------------------------------------------- */
+
+int gpioNotifyLatency(unsigned handle, unsigned latency)
+{
+   DBG(DBG_USER, "handle=%d latency=%d", handle, latency);
+
+   CHECK_INITED;
+
+   if (handle >= PI_NOTIFY_SLOTS)
+      SOFT_ERROR(PI_BAD_HANDLE, "bad handle (%d)", handle);
+
+   if (gpioNotify[handle].state <= PI_NOTIFY_CLOSING)
+      SOFT_ERROR(PI_BAD_HANDLE, "bad handle (%d)", handle);
+
+   if (latency &&
+      ((latency < PI_MIN_LATENCY) || (latency > PI_MAX_LATENCY)))
+      SOFT_ERROR(PI_BAD_LATENCY, "bad latency (%d)", latency);
+
+   gpioNotify[handle].latency = latency;
+
+   return 0;
+}
+
+
 /* ----------------------------------------------------------------------- */
 
 int gpioNotifyClose(unsigned handle)
@@ -11792,7 +15018,13 @@ int gpioNotifyClose(unsigned handle)
 
    intNotifyBits();
 
-   /* actual close done in alert thread */
+   /* a shared memory ring is unmapped by the alert thread which
+      writes it, the rest of the close is done in the notify thread */
+
+   if (gpioNotify[handle].shm)
+      __atomic_fetch_or(&notifyShmClosing, 1<<handle, __ATOMIC_RELEASE);
+
+   notifyWake();
 
    return 0;
 }
@@ -11868,11 +15100,13 @@ int gpioNoiseFilter(unsigned gpio, unsigned steady, unsigned active)
    if (active > PI_MAX_ACTIVE)
       SOFT_ERROR(PI_BAD_FILTER, "bad active (%d)", active);
 
-   gpioAlert[gpio].nfTick1  = systReg[SYST_CLO];
-   gpioAlert[gpio].nfTick2  = gpioAlert[gpio].nfTick1;
-   gpioAlert[gpio].nfSteadyUs = steady;
-   gpioAlert[gpio].nfActiveUs = active;
-   gpioAlert[gpio].nfActive   = 0;
+   /* the alert thread restarts the filter state on its next pass */
+
+   gpioNoise.setTick [gpio] = systReg[SYST_CLO];
+   gpioNoise.steadyUs[gpio] = steady;
+   gpioNoise.activeUs[gpio] = active;
+
+   __sync_fetch_and_or(&gpioNoise.resetBits, (1<<gpio));
 
    if (steady) nFilterBits |= (1<<gpio);
    else        nFilterBits &= (~(1<<gpio));
@@ -11897,21 +15131,13 @@ int gpioGlitchFilter(unsigned gpio, unsigned steady)
 
    if (steady)
    {
-      gpioAlert[gpio].gfTick  = systReg[SYST_CLO];
+      /* the alert thread restarts the filter state on its next pass */
 
-      if (gpioRead_Bits_0_31() & (1<<gpio))
-      {
-         gpioAlert[gpio].gfLBitV = (1<<gpio);
-         gpioAlert[gpio].gfRBitV = 0 ;
-      }
-      else
-      {
-         gpioAlert[gpio].gfLBitV = 0 ;
-         gpioAlert[gpio].gfRBitV = (1<<gpio);
-      }
-   }
+      gpioGlitch.setTick[gpio]  = systReg[SYST_CLO];
+      gpioGlitch.steadyUs[gpio] = steady;
 
-   gpioAlert[gpio].gfSteadyUs = steady;
+      __sync_fetch_and_or(&gpioGlitch.resetBits, (1<<gpio));
+   }
 
    if (steady) gFilterBits |= (1<<gpio);
    else        gFilterBits &= (~(1<<gpio));
@@ -11934,7 +15160,8 @@ int gpioSetGetSamplesFunc(gpioGetSamplesFunc_t f, uint32_t bits)
    if (f) gpioGetSamples.bits = bits;
    else   gpioGetSamples.bits = 0;
 
-   monitorBits = alertBits | notifyBits | scriptBits | gpioGetSamples.bits;
+   monitorBits = alertBits | notifyBits | scriptBits | gpioGetSamples.bits |
+                 patternBits;
 
    return 0;
 }
@@ -11957,7 +15184,8 @@ int gpioSetGetSamplesFuncEx(gpioGetSamplesFuncEx_t f,
    if (f) gpioGetSamples.bits = bits;
    else   gpioGetSamples.bits = 0;
 
-   monitorBits = alertBits | notifyBits | scriptBits | gpioGetSamples.bits;
+   monitorBits = alertBits | notifyBits | scriptBits | gpioGetSamples.bits |
+                 patternBits;
 
    return 0;
 }
@@ -12169,6 +15397,13 @@ int gpioStoreScript(char *script)
 
    status = cmdParseScript(script, &s->script, 0);
 
+   if (status == 0)
+   {
+      s->op = scrCompile(&s->script);
+
+      if (s->op == NULL) status = PI_NO_MEMORY;
+   }
+
    if (status == 0)
    {
       s->request   = PI_SCRIPT_HALT;
@@ -12337,6 +15572,10 @@ int gpioDeleteScript(unsigned script_id)
 
       gpioScript[script_id].script.par = NULL;
 
+      free(gpioScript[script_id].op);
+
+      gpioScript[script_id].op = NULL;
+
       gpioScript[script_id].state = PI_SCRIPT_FREE;
 
       return 0;
@@ -13444,6 +16683,71 @@ int gpioCfgNetAddr(int numSockAddr, uint32_t *sockAddr)
 }
 
 
+/* ----------------------------------------------------------------------- */
+
+int gpioCfgAlertDispatch(unsigned threads, unsigned ringSize)
+{
+   DBG(DBG_USER, "threads=%d ringSize=%d", threads, ringSize);
+
+   CHECK_NOT_INITED;
+
+   if (threads > PI_MAX_ALERT_THREADS)
+      SOFT_ERROR(PI_BAD_ALERT_CFG, "bad threads (%d)", threads);
+
+   if ((ringSize < PI_MIN_ALERT_RING) || (ringSize > PI_MAX_ALERT_RING) ||
+       (ringSize & (ringSize - 1)))
+      SOFT_ERROR(PI_BAD_ALERT_CFG, "bad ringSize (%d)", ringSize);
+
+   gpioCfg.alertThreads  = threads;
+   gpioCfg.alertRingSize = ringSize;
+
+   return 0;
+}
+
+
+/* ----------------------------------------------------------------------- */
+
+int gpioCfgSocketServer(unsigned threads, unsigned maxConns)
+{
+   DBG(DBG_USER, "threads=%d maxConns=%d", threads, maxConns);
+
+   CHECK_NOT_INITED;
+
+   if ((threads < PI_MIN_SOCK_THREADS) || (threads > PI_MAX_SOCK_THREADS))
+      SOFT_ERROR(PI_BAD_SOCK_CFG, "bad threads (%d)", threads);
+
+   if ((maxConns < PI_MIN_SOCK_CONNS) || (maxConns > PI_MAX_SOCK_CONNS))
+      SOFT_ERROR(PI_BAD_SOCK_CFG, "bad maxConns (%d)", maxConns);
+
+   gpioCfg.sockThreads  = threads;
+   gpioCfg.sockMaxConns = maxConns;
+
+   return 0;
+}
+
+
+/* ----------------------------------------------------------------------- */
+
+int gpioCfgSocketPath(char *path, int gid)
+{
+   DBG(DBG_USER, "path=%s gid=%d", path ? path : "", gid);
+
+   CHECK_NOT_INITED;
+
+   if (path && (strlen(path) > PI_MAX_SOCKET_PATH))
+      SOFT_ERROR(PI_BAD_SOCK_PATH, "bad path (%s)", path);
+
+   if (gid < -1)
+      SOFT_ERROR(PI_BAD_SOCK_PATH, "bad gid (%d)", gid);
+
+   if (path) strcpy(sockPath, path); else sockPath[0] = 0;
+
+   gpioCfg.sockGid = gid;
+
+   return 0;
+}
+
+
 /* ----------------------------------------------------------------------- */
 
 uint32_t gpioCfgGetInternals(void)
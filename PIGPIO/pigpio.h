@@ -169,6 +169,10 @@ ADVANCED
 gpioGetPWMrealRange        Get underlying PWM range for a GPIO
 
 gpioSetAlertFuncEx         Request a GPIO change callback, extended
+gpioSetAlertBatchFunc      Request batched GPIO change callbacks
+gpioGetAlertDropped        Get changes dropped by a dispatched alert
+gpioSetAlertLatency        Sets the most latency wanted for an alert
+gpioGetLatency             Get a histogram of alert latencies
 
 gpioSetISRFunc             Request a GPIO interrupt callback
 gpioSetISRFuncEx           Request a GPIO interrupt callback, extended
@@ -183,6 +187,12 @@ gpioSetTimerFuncEx         Request a regular timed callback, extended
 
 gpioNotifyOpen             Request a notification handle
 gpioNotifyOpenWithSize     Request a notification handle with sized pipe
+gpioNotifyOpenShm          Request a shared memory notification handle
+gpioNotifyGetEventFd       Get the eventfd of a shared memory notification
+gpioNotifyEncoding         Select the notification stream encoding
+gpioNotifyEdges            Select the edges notified for GPIO
+gpioNotifyGlitch           Sets a glitch filter for a notification
+gpioNotifyLatency          Sets the most latency wanted for a notification
 gpioNotifyBegin            Start notifications for selected GPIO
 gpioNotifyPause            Pause notifications
 gpioNotifyClose            Close a notification
@@ -320,6 +330,8 @@ eventMonitor               Sets the events to monitor
 eventSetFunc               Request an event callback
 eventSetFuncEx             Request an event callback, extended
 eventTrigger               Trigger an event
+eventSetPattern            Sets a level pattern which triggers an event
+eventSetPatternFunc        Request a level pattern callback
 
 CONFIGURATION
 
@@ -332,6 +344,9 @@ gpioCfgInterfaces          Configure user interfaces
 gpioCfgSocketPort          Configure socket port
 gpioCfgMemAlloc            Configure DMA memory allocation mode
 gpioCfgNetAddr             Configure allowed network addresses
+gpioCfgAlertDispatch       Configure alert callback dispatcher threads
+gpioCfgSocketServer        Configure socket worker threads and connections
+gpioCfgSocketPath          Configure the local (Unix domain) socket
 
 gpioCfgInternals           Configure miscellaneous internals (DEPRECATED)
 gpioCfgGetInternals        Get internal configuration settings
@@ -418,6 +433,24 @@ typedef struct
    uint32_t level;
 } gpioReport_t;
 
+#define PI_NOTIFY_SHM_MAGIC   0x4D485350 /* "PSHM" */
+#define PI_NOTIFY_SHM_READERS 8
+#define PI_NOTIFY_SHM_MODE    0666
+#define PI_MIN_NOTIFY_SHM     64
+#define PI_MAX_NOTIFY_SHM     (1<<20)
+
+typedef struct
+{
+   uint32_t magic;    /* PI_NOTIFY_SHM_MAGIC */
+   uint32_t size;     /* number of reports, a power of 2 */
+   uint32_t head;     /* reports written, report[head & (size-1)] is next */
+   uint32_t waiters;  /* consumers waiting for head to change */
+   uint32_t readers;  /* bit per cursor in use */
+   uint32_t cursor[PI_NOTIFY_SHM_READERS]; /* consumer read positions */
+   uint32_t pad[3];
+   gpioReport_t report[];
+} gpioNotifyShm_t;
+
 typedef struct
 {
    uint32_t gpioOn;
@@ -516,6 +549,12 @@ typedef void (*gpioAlertFuncEx_t)  (int      gpio,
                                     uint32_t tick,
                                     void    *userdata);
 
+typedef void (*gpioAlertBatchFunc_t) (int             gpio,
+                                      int             count,
+                                      const uint32_t *tick,
+                                      const uint8_t  *level,
+                                      void           *userdata);
+
 typedef void (*eventFunc_t)        (int      event,
                                     uint32_t tick);
 
@@ -523,6 +562,11 @@ typedef void (*eventFuncEx_t)      (int      event,
                                     uint32_t tick,
                                     void    *userdata);
 
+typedef void (*eventPatternFunc_t) (int      event,
+                                    uint32_t level,
+                                    uint32_t tick,
+                                    void    *userdata);
+
 typedef void (*gpioISRFunc_t)      (int      gpio,
                                     int      level,
                                     uint32_t tick);
@@ -625,6 +669,15 @@ typedef void *(gpioThreadFunc_t) (void *);
 #define PI_NTFY_FLAGS_WDOG     (1 <<5)
 #define PI_NTFY_FLAGS_BIT(x) (((x)<<0)&31)
 
+/* gpioNotifyEncoding */
+
+#define PI_NOTIFY_ENC_RAW   0
+#define PI_NOTIFY_ENC_DELTA 1
+
+#define PI_NTFY_DELTA_KEY   (1 <<7)
+#define PI_NTFY_DELTA_FLAGS (1 <<6)
+#define PI_NTFY_DELTA_LEVEL (1 <<5)
+
 #define PI_WAVE_BLOCKS     4
 #define PI_WAVE_MAX_PULSES (PI_WAVE_BLOCKS * 3000)
 #define PI_WAVE_MAX_CHARS  (PI_WAVE_BLOCKS *  300)
@@ -853,6 +906,36 @@ typedef void *(gpioThreadFunc_t) (void *);
 #define PI_MEM_ALLOC_PAGEMAP 1
 #define PI_MEM_ALLOC_MAILBOX 2
 
+/* gpioCfgAlertDispatch */
+
+#define PI_MAX_ALERT_THREADS 8
+#define PI_MIN_ALERT_RING   16
+#define PI_MAX_ALERT_RING   65536
+
+/* gpioCfgSocketServer */
+
+#define PI_MIN_SOCK_THREADS 1
+#define PI_MAX_SOCK_THREADS 16
+#define PI_MIN_SOCK_CONNS   1
+#define PI_MAX_SOCK_CONNS   4096
+
+/* gpioCfgSocketPath */
+
+#define PI_MAX_SOCKET_PATH 107
+
+/* gpioSetAlertLatency, gpioNotifyLatency */
+
+#define PI_MIN_LATENCY 100
+#define PI_MAX_LATENCY 1000000
+
+/* gpioGetLatency */
+
+#define PI_LATENCY_ALERT  0
+#define PI_LATENCY_NOTIFY 1
+#define PI_LATENCY_SCRIPT 2
+
+#define PI_LATENCY_BINS 24
+
 /* filters */
 
 #define PI_MAX_STEADY  300000
@@ -1463,8 +1546,156 @@ userdata    pointer  Pointer to an arbitrary object
 
 See [*gpioSetAlertFunc*] for further details.
 
-Only one of [*gpioSetAlertFunc*] or [*gpioSetAlertFuncEx*] can be
-registered per GPIO.
+Only one of [*gpioSetAlertFunc*], [*gpioSetAlertFuncEx*] or
+[*gpioSetAlertBatchFunc*] can be registered per GPIO.
+D*/
+
+
+/*F*/
+int gpioSetAlertBatchFunc(
+   unsigned user_gpio, gpioAlertBatchFunc_t f, void *userdata);
+/*D
+Registers a function to be called with all the state changes of the
+specified GPIO found in one pass of the alert thread.
+
+. .
+user_gpio: 0-31
+        f: the callback function
+ userdata: pointer to arbitrary user data
+. .
+
+Returns 0 if OK, otherwise PI_BAD_USER_GPIO.
+
+Instead of one call per level change, as with [*gpioSetAlertFuncEx*],
+the callback is called at most once per pass with the changes in
+time order.  tick[i] and level[i] are the tick and new level of the
+i'th change, level being 0, 1, or 2 (PI_TIMEOUT) as for
+[*gpioSetAlertFuncEx*].  The arrays are only valid during the call.
+
+. .
+Parameter   Value    Meaning
+
+GPIO        0-31     The GPIO which has changed state
+
+count       1-121    The number of entries in tick and level
+
+tick        array    The tick of each change
+
+level       array    The new level of each change
+
+userdata    pointer  Pointer to an arbitrary object
+. .
+
+Changes of different GPIO are not interleaved, each GPIO's batch
+is delivered in turn after the per-change callbacks of the pass.
+
+The callback may be cancelled by passing NULL as the function.
+
+Only one of [*gpioSetAlertFunc*], [*gpioSetAlertFuncEx*] or
+[*gpioSetAlertBatchFunc*] can be registered per GPIO.
+
+...
+void aFunction(int gpio, int count,
+   const uint32_t *tick, const uint8_t *level, void *userdata)
+{
+   int i;
+
+   for (i=0; i<count; i++)
+      printf("GPIO %d became %d at %d", gpio, level[i], tick[i]);
+}
+
+// call aFunction with the changes of GPIO 4
+
+gpioSetAlertBatchFunc(4, aFunction, NULL);
+...
+
+If alert callbacks are dispatched (see [*gpioCfgAlertDispatch*]) the
+callback receives the changes queued since its previous call, so
+count may be up to the configured ring size.
+D*/
+
+
+/*F*/
+int gpioGetAlertDropped(unsigned user_gpio);
+/*D
+Returns the number of changes of a GPIO which were discarded because
+its alert callback fell behind.
+
+. .
+user_gpio: 0-31
+. .
+
+Returns the count if OK, otherwise PI_BAD_USER_GPIO.
+
+Changes are only discarded when alert callbacks are dispatched
+(see [*gpioCfgAlertDispatch*]) and the GPIO's ring is full.  The
+count is not reset when the callback is changed or cancelled.
+D*/
+
+
+/*F*/
+int gpioSetAlertLatency(unsigned user_gpio, unsigned latency);
+/*D
+Sets the most microseconds wanted between a level change of a GPIO
+and the call of its alert function.
+
+. .
+user_gpio: 0-31
+  latency: 0 or 100-1000000
+. .
+
+Returns 0 if OK, otherwise PI_BAD_USER_GPIO or PI_BAD_LATENCY.
+
+The alert thread reads the sampled levels at the interval set by
+[*gpioCfgInternals*] while levels are changing.  When no monitored
+GPIO has changed the interval doubles each time, up to 8 times the
+configured interval, to use less CPU.  A latency shortens the
+interval, and limits its growth, while the GPIO has an alert function.
+
+A latency of 0, the default, accepts the alert thread's interval.
+
+...
+gpioSetAlertFunc(4, aFunction);
+gpioSetAlertLatency(4, 200);
+...
+D*/
+
+
+/*F*/
+int gpioGetLatency(unsigned type, unsigned reset, uint32_t *bins);
+/*D
+Gets a histogram of the microseconds between GPIO level changes being
+sampled and being delivered.
+
+. .
+ type: PI_LATENCY_ALERT, PI_LATENCY_NOTIFY, or PI_LATENCY_SCRIPT
+reset: 0 to keep the counts, otherwise clear them after reading
+ bins: an array of PI_LATENCY_BINS counts
+. .
+
+Returns PI_LATENCY_BINS if OK, otherwise PI_BAD_LATENCY_TYPE.
+
+PI_LATENCY_ALERT counts each alert callback, PI_LATENCY_NOTIFY each
+report delivered to a notification, and PI_LATENCY_SCRIPT each time
+scripts are woken by level changes.
+
+A report is delivered once the notify thread has written it to the
+pipe or socket, or once the alert thread has put it in a shared
+memory ring ([*gpioNotifyOpenShm*]), not when it is queued.
+
+bins[0] counts latencies of 0 and 1 microseconds, and bins[n] counts
+latencies from 2^n to 2^(n+1)-1 microseconds.  The last bin also counts
+anything longer.
+
+...
+uint32_t bins[PI_LATENCY_BINS];
+int i;
+
+gpioGetLatency(PI_LATENCY_ALERT, 0, bins);
+
+for (i=0; i<PI_LATENCY_BINS; i++)
+   if (bins[i]) printf("<%d us: %d\n", 2<<i, bins[i]);
+...
 D*/
 
 
@@ -1608,6 +1839,106 @@ See [*gpioNotifyOpen*] for further details.
 D*/
 
 
+/*F*/
+int gpioNotifyOpenShm(unsigned reports);
+/*D
+This function requests a free notification handle whose reports are
+written to a shared memory ring rather than a pipe.
+
+. .
+reports: 64-1048576, a power of 2, the number of reports in the ring
+. .
+
+Returns a handle greater than or equal to zero if OK,
+otherwise PI_NO_HANDLE, PI_BAD_PARAM, or PI_BAD_PATHNAME.
+
+The ring for handle x is the POSIX shared memory object /pigpiox
+(/dev/shm/pigpiox), a gpioNotifyShm_t header followed by the
+reports.  The alert thread writes reports directly into the ring,
+there is no system call per report or per consumer.
+
+The ring never blocks the writer.  A consumer which falls more than
+size reports behind loses the oldest (seqno shows the gap).
+
+Up to PI_NOTIFY_SHM_READERS consumers may read the ring at once,
+each claiming one of the cursors.
+
+...
+// claim a cursor
+
+do
+{
+   r = __builtin_ctz(~shm->readers);
+   if (r >= PI_NOTIFY_SHM_READERS) return; // all in use
+}
+while (__atomic_fetch_or(&shm->readers, 1<<r, __ATOMIC_SEQ_CST) & (1<<r));
+
+cur = __atomic_load_n(&shm->head, __ATOMIC_ACQUIRE);
+
+while (running)
+{
+   head = __atomic_load_n(&shm->head, __ATOMIC_ACQUIRE);
+
+   if ((head - cur) > shm->size) cur = head - shm->size; // lost some
+
+   for (n=0; cur!=head; n++, cur++)
+      buf[n] = shm->report[cur & (shm->size-1)];
+
+   // the writer may have overwritten the oldest copied reports
+
+   lost = __atomic_load_n(&shm->head, __ATOMIC_ACQUIRE) - (cur - n);
+   if (lost > shm->size) discard the first (lost - shm->size) of buf
+
+   shm->cursor[r] = cur;
+
+   // wait for more
+
+   __atomic_fetch_add(&shm->waiters, 1, __ATOMIC_SEQ_CST);
+   if (__atomic_load_n(&shm->head, __ATOMIC_SEQ_CST) == cur)
+      syscall(SYS_futex, &shm->head, FUTEX_WAIT, cur, NULL, NULL, 0);
+   __atomic_fetch_sub(&shm->waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+__atomic_fetch_and(&shm->readers, ~(1<<r), __ATOMIC_SEQ_CST);
+...
+
+When waiters is non-zero the writer wakes the futex on head and
+signals the handle's eventfd (see [*gpioNotifyGetEventFd*]) after
+each batch of reports.
+
+The cursors are used to count the reports lost by the slowest
+consumer.  The handle is used with [*gpioNotifyBegin*],
+[*gpioNotifyPause*] and [*gpioNotifyClose*] as usual.
+
+A consumer writes readers, waiters, and its cursor, so the object
+is created with mode PI_NOTIFY_SHM_MODE (0666) whatever the umask,
+letting a consumer of any user map it read/write.  Any local user
+can therefore read the reports, as with the notification pipes, and
+disturb other consumers of the ring.  The writer keeps its own copy
+of head and size and only reads the cursors to count lost reports,
+so nothing written to the ring can make it misbehave.  The object
+is recreated by each gpioNotifyOpenShm.
+D*/
+
+
+/*F*/
+int gpioNotifyGetEventFd(unsigned handle);
+/*D
+Returns the eventfd signalled when reports are added to a shared
+memory notification.
+
+. .
+handle: >=0, as returned by [*gpioNotifyOpenShm*]
+. .
+
+Returns the eventfd if OK, otherwise PI_BAD_HANDLE.
+
+This is for consumers in the same process, which may poll the eventfd
+(counting themselves in the ring's waiters while they do) instead of
+waiting on the futex.  The eventfd is closed by [*gpioNotifyClose*].
+D*/
+
+
 /*F*/
 int gpioNotifyBegin(unsigned handle, uint32_t bits);
 /*D
@@ -1690,6 +2021,130 @@ gpioNotifyPause(h);
 D*/
 
 
+/*F*/
+int gpioNotifyEncoding(unsigned handle, unsigned encoding);
+/*D
+This function selects how reports are encoded on a previously opened
+pipe or socket notification handle.
+
+. .
+  handle: >=0, as returned by [*gpioNotifyOpen*]
+encoding: 0-1
+. .
+
+Returns 0 if OK, otherwise PI_BAD_HANDLE or PI_BAD_PARAM.
+
+PI_NOTIFY_ENC_RAW (0), the default, sends each report as a 12 byte
+gpioReport_t.
+
+PI_NOTIFY_ENC_DELTA (1) sends each report as a variable length
+record, typically 2 or 3 bytes when one GPIO changes.  The first
+byte of a record is a header.
+
+If bit 7 (PI_NTFY_DELTA_KEY) is set the record is a keyframe and is
+followed by the seqno (16 bits), flags (16 bits), tick (32 bits) and
+level (32 bits) of the report, all little endian.
+
+Otherwise the report's seqno is one more than the previous report's
+and the header is followed by
+
+the flags (16 bits, little endian) if bit 6 (PI_NTFY_DELTA_FLAGS)
+is set, otherwise the flags are 0,
+
+the XOR of the level with the previous level as a varint if
+bit 5 (PI_NTFY_DELTA_LEVEL) is set, otherwise bits 0-4 of the header
+are the number of the only level bit which changed,
+
+the tick minus the previous tick as a varint.
+
+A varint holds 7 bits per byte, least significant first, with bit 7
+set on every byte but the last.
+
+The stream starts with a keyframe and a keyframe is sent at least
+every 256 records and after any reports are dropped.
+
+The encoding should be selected before [*gpioNotifyBegin*].  Shared
+memory handles always use gpioReport_t.
+D*/
+
+
+/*F*/
+int gpioNotifyEdges(unsigned handle, uint32_t bits, unsigned edge);
+/*D
+This function selects the level changes reported for the GPIO in bits
+on a previously opened notification handle.
+
+. .
+handle: >=0, as returned by [*gpioNotifyOpen*]
+  bits: a bit mask of the GPIO to set
+  edge: RISING_EDGE, FALLING_EDGE, or EITHER_EDGE
+. .
+
+Returns 0 if OK, otherwise PI_BAD_HANDLE or PI_BAD_EDGE.
+
+All edges are reported when a handle is opened.  The setting is kept
+across [*gpioNotifyPause*] and [*gpioNotifyBegin*].
+
+Reports are only generated for the selected edges, other level
+changes are not sent.
+
+A GPIO reported on one edge only shows that edge as a change of its
+level.  The level of a RISING_EDGE GPIO is reported as 0 except in
+the report of a rising edge, the level of a FALLING_EDGE GPIO as 1
+except in the report of a falling edge.
+
+...
+// report GPIO 4 and 17 only when they fall
+
+gpioNotifyEdges(h, (1<<4)|(1<<17), FALLING_EDGE);
+gpioNotifyBegin(h, (1<<4)|(1<<17));
+...
+D*/
+
+
+/*F*/
+int gpioNotifyGlitch(unsigned handle, unsigned steady);
+/*D
+Sets a glitch filter on the level changes reported by a previously
+opened notification handle.
+
+. .
+handle: >=0, as returned by [*gpioNotifyOpen*]
+steady: 0-300000
+. .
+
+Returns 0 if OK, otherwise PI_BAD_HANDLE or PI_BAD_FILTER.
+
+As [*gpioGlitchFilter*] but only for the reports of this handle,
+alerts and other notifications are unaffected.
+
+A level change of a notified GPIO is reported once the level has been
+steady for steady microseconds, with the tick at which the steady
+period ended.  Level changes which do not last are not reported.
+
+Edges selected by [*gpioNotifyEdges*] are checked after the filter.
+
+A steady of 0 removes the filter.
+D*/
+
+
+/*F*/
+int gpioNotifyLatency(unsigned handle, unsigned latency);
+/*D
+Sets the most microseconds wanted between a level change and its
+report on a previously opened notification handle.
+
+. .
+ handle: >=0, as returned by [*gpioNotifyOpen*]
+latency: 0 or 100-1000000
+. .
+
+Returns 0 if OK, otherwise PI_BAD_HANDLE or PI_BAD_LATENCY.
+
+As [*gpioSetAlertLatency*] while the notification is running.
+D*/
+
+
 /*F*/
 int gpioNotifyClose(unsigned handle);
 /*D
@@ -4250,6 +4705,69 @@ Note that other than its id and its tick there is no data associated
 with an event.
 D*/
 
+/*F*/
+int eventSetPattern(unsigned event, uint32_t mask, uint32_t pattern);
+/*D
+This function sets a level pattern which triggers an event.
+
+. .
+  event: 0-31
+   mask: a bit mask of the GPIO in the pattern
+pattern: the levels of the GPIO in mask
+. .
+
+Returns 0 if OK, otherwise PI_BAD_EVENT_ID or PI_BAD_PATTERN.
+
+The event is triggered at each level change after which
+(level & mask) == pattern, i.e. when the pattern starts to match.
+The pattern is checked against every level change of the GPIO in
+mask, not just the last level of each sampling pass.
+
+A pattern which matches when it is set does not trigger the event
+until it has stopped and started matching again.
+
+The event callbacks ([*eventSetFunc*]) and the notification reports
+([*eventMonitor*]) of a pattern event carry the tick of the level
+change which matched, the reports also carry its level.  A level
+pattern callback ([*eventSetPatternFunc*]) is passed both.
+
+One pattern may be set per event.  A mask of 0 removes the pattern.
+
+...
+// event 2 when GPIO 5, 6, and 13 are low with GPIO 19 high
+
+eventSetPattern(2, (1<<5)|(1<<6)|(1<<13)|(1<<19), (1<<19));
+...
+D*/
+
+/*F*/
+int eventSetPatternFunc(
+   unsigned event, eventPatternFunc_t f, void *userdata);
+/*D
+Registers a function to be called (a callback) when the level pattern
+of the specified event matches.
+
+. .
+   event: 0-31
+       f: the callback function
+userdata: pointer to arbitrary user data
+. .
+
+Returns 0 if OK, otherwise PI_BAD_EVENT_ID.
+
+One function may be registered per event.
+
+The function is passed the event, the level of all the GPIO when the
+pattern matched, the tick, and the userdata pointer.
+
+The function is called by the alert thread, or by dispatcher 0 if
+alert callbacks are dispatched (see [*gpioCfgAlertDispatch*]).
+
+The callback may be cancelled by passing NULL as the function.
+
+See [*eventSetPattern*].
+D*/
+
 
 /*F*/
 int shell(char *scriptName, char *scriptString);
@@ -4771,6 +5289,108 @@ numSockAddr: 0-256 (0 means all addresses allowed)
 D*/
 
 
+/*F*/
+int gpioCfgAlertDispatch(unsigned threads, unsigned ringSize);
+/*D
+Selects whether alert callbacks are called by the alert thread or
+by a pool of dispatcher threads.
+
+This function is only effective if called before [*gpioInitialise*].
+
+. .
+ threads: 0-8 (0 means callbacks are called by the alert thread)
+ringSize: 16-65536, a power of 2
+. .
+
+Returns 0 if OK, otherwise PI_BAD_ALERT_CFG.
+
+By default the alert thread calls the [*gpioSetAlertFunc*],
+[*gpioSetAlertFuncEx*] and [*gpioSetAlertBatchFunc*] callbacks
+itself, so a slow callback delays sampling of every GPIO and the
+notifications.
+
+With threads set the alert thread only queues each change (and
+watchdog timeout) on a ring of ringSize entries per GPIO and wakes
+the dispatcher serving that GPIO.  GPIO g is served by dispatcher
+g % threads, so the callbacks of one GPIO are still called in order
+from a single thread, while different GPIO may be called concurrently.
+
+If a GPIO's ring is full the change is discarded and counted, see
+[*gpioGetAlertDropped*].
+
+The level pattern callbacks ([*eventSetPatternFunc*]) and the event
+callbacks of a matched pattern are queued on one more ring of ringSize
+entries and called by dispatcher 0.
+D*/
+
+
+/*F*/
+int gpioCfgSocketServer(unsigned threads, unsigned maxConns);
+/*D
+Configures the threads which serve socket interface connections and
+the most connections accepted at once.
+
+This function is only effective if called before [*gpioInitialise*].
+
+. .
+ threads: 1-16
+maxConns: 1-4096
+. .
+
+Returns 0 if OK, otherwise PI_BAD_SOCK_CFG.
+
+The default is 4 threads and 256 connections.
+
+Connections are watched with epoll and a thread is only used while
+a connection has a command to run, so an idle connection costs a few
+hundred bytes rather than a thread.
+
+threads workers are started with the interface.  A command which
+takes a long time, e.g. a long delay or a slow I2C or serial
+transfer, holds its worker until it completes, so when every worker
+is busy another is started, up to 64 in all.  Workers started this
+way are kept for later use.
+
+A connection over maxConns is closed as soon as it is accepted.
+D*/
+
+
+/*F*/
+int gpioCfgSocketPath(char *path, int gid);
+/*D
+Configures the Unix domain socket on which the socket interface also
+accepts connections from processes on the same machine.
+
+This function is only effective if called before [*gpioInitialise*].
+
+. .
+path: the socket file, or NULL or "" for none
+ gid: -1, or the group whose members may connect
+. .
+
+Returns 0 if OK, otherwise PI_BAD_SOCK_PATH.
+
+The default is no local socket.  /var/run/pigpio.sock is a suitable
+path.
+
+The commands and responses are exactly those of the TCP socket but
+without the TCP/IP overhead, so a local client gets lower latency
+and can send more commands per second.
+
+Root and the user running pigpio may always connect.  If gid is not
+-1 so may members of gid, the file is then created 0660 in group gid,
+otherwise 0600.  Access is also checked against the peer credentials
+of each connection, a user whose primary or supplementary groups
+include gid is a member.
+
+A local connection counts as one from 127.0.0.1 to
+[*gpioCfgNetAddr*], so is refused if addresses are set and that is
+not one of them.
+
+The socket interface must not be disabled, see [*gpioCfgInterfaces*].
+D*/
+
+
 /*F*/
 int gpioCfgInternals(unsigned cfgWhat, unsigned cfgVal);
 /*D
@@ -5121,6 +5741,9 @@ baud::
 The speed of serial communication (I2C, SPI, serial link, waves) in
 bits per second.
 
+*bins::
+An array of PI_LATENCY_BINS latency counts.
+
 bit::
 A value of 0 or 1.
 
@@ -5256,6 +5879,14 @@ FALLING_EDGE 1
 EITHER_EDGE 2
 . .
 
+encoding::0-1
+The encoding of a notification stream.  See [*gpioNotifyEncoding*].
+
+. .
+PI_NOTIFY_ENC_RAW   0
+PI_NOTIFY_ENC_DELTA 1
+. .
+
 event::0-31
 An event is a signal used to inform one or more consumers
 to start an action.
@@ -5271,6 +5902,12 @@ typedef void (*eventFuncEx_t)
    (int event, uint32_t tick, void *userdata);
 . .
 
+eventPatternFunc_t::
+. .
+typedef void (*eventPatternFunc_t)
+   (int event, uint32_t level, uint32_t tick, void *userdata);
+. .
+
 f::
 
 A function.
@@ -5290,6 +5927,9 @@ can be set per GPIO and may be as little as 5Hz or as much as
 40KHz.  The GPIO will be on for a proportion of the time as defined
 by its dutycycle.
 
+gid::
+A group id, or -1 for none.
+
 gpio::
 
 A Broadcom numbered GPIO, in the range 0-53.
@@ -5331,6 +5971,12 @@ typedef void (*eventFuncEx_t)
    (int event, int level, uint32_t tick, void *userdata);
 . .
 
+gpioAlertBatchFunc_t::
+. .
+typedef void (*gpioAlertBatchFunc_t) (int gpio, int count,
+   const uint32_t *tick, const uint8_t *level, void *userdata);
+. .
+
 gpioCfg*::
 
 These functions are only effective if called before [*gpioInitialise*].
@@ -5342,6 +5988,7 @@ These functions are only effective if called before [*gpioInitialise*].
 [*gpioCfgPermissions*] 
 [*gpioCfgInterfaces*] 
 [*gpioCfgSocketPort*] 
+[*gpioCfgSocketPath*] 
 [*gpioCfgMemAlloc*]
 
 gpioGetSamplesFunc_t::
@@ -5466,6 +6113,10 @@ A 32-bit signed value.
 invert::
 A flag used to set normal or inverted bit bang serial data level logic.
 
+latency:: 0, 100-1000000
+The most microseconds wanted between a level change and its alert
+callback or notification report.  0 for no limit.
+
 level::
 The level of a GPIO.  Low or High.
 
@@ -5492,6 +6143,14 @@ lVal::0-4294967295 (Hex 0x0-0xFFFFFFFF, Octal 0-37777777777)
 
 A 32-bit word value.
 
+mask::
+A value used to select GPIO.  If bit n of mask is set then GPIO n is
+selected.
+
+maxConns:: 1-4096
+
+The most socket interface connections accepted at once.
+
 memAllocMode:: 0-2
 
 The DMA memory allocation mode.
@@ -5610,6 +6269,13 @@ typedef struct
 } pi_i2c_msg_t;
 . .
 
+*path::
+The path of a Unix domain socket file.
+
+pattern::
+The levels of the GPIO selected by mask.  If bit n of mask is set
+then bit n of pattern is the level of GPIO n.
+
 port:: 1024-32000
 The port used to bind to the pigpio socket.  Defaults to 8888.
 
@@ -5730,6 +6396,14 @@ typedef struct
 } rawWaveInfo_t;
 . .
 
+reset::
+A flag, 0 or 1.  If set the values are cleared after being read.
+
+reports:: 64-1048576
+
+The number of reports in a shared memory notification ring, a power
+of 2.
+
 *retBuf::
 
 A buffer to hold a number of bytes returned to a used customised function,
@@ -5738,6 +6412,11 @@ retMax::
 
 The maximum number of bytes a user customised function should return.
 
+ringSize:: 16-65536
+
+The number of changes queued per GPIO for a dispatcher thread.
+Must be a power of 2.
+
 *rxBuf::
 
 A pointer to a buffer to receive data.
@@ -5859,6 +6538,11 @@ PI_MAX_WAVE_HALFSTOPBITS 8
 *str::
 An array of characters.
 
+threads:: 0-8, 1-16
+
+The number of alert callback dispatcher threads, 0 for none, or the
+number of socket interface worker threads.
+
 timeout::
 A GPIO level change timeout in milliseconds.
 
@@ -5886,6 +6570,15 @@ PI_TIME_RELATIVE 0
 PI_TIME_ABSOLUTE 1
 . .
 
+type::
+The latency histogram to get.
+
+. .
+PI_LATENCY_ALERT  0
+PI_LATENCY_NOTIFY 1
+PI_LATENCY_SCRIPT 2
+. .
+
 *txBuf::
 
 An array of bytes to transmit.
@@ -6108,6 +6801,19 @@ PARAMS*/
 #define PI_CMD_EVM   115
 #define PI_CMD_EVT   116
 
+#define PI_CMD_NOS   117
+#define PI_CMD_NE    118
+#define PI_CMD_NED   119
+#define PI_CMD_NG    120
+
+#define PI_CMD_EVP   121
+
+#define PI_CMD_NL    122
+
+#define PI_CMD_LH    123
+
+#define PI_CMD_BATCH 124
+
 /*DEF_E*/
 
 /*
@@ -6118,6 +6824,19 @@ that handle will be sent to the socket (rather than a
 
 The socket should be dedicated to receiving notifications
 after this command is issued.
+
+PI CMD_BATCH is sent on the socket interface.  On the pipe
+interface, as with pigs, BATCH runs the rest of the line as one
+batch and prints the results on one line.
+Its extension is a sequence of commands, each a cmdCmd_t
+(cmd, p1, p2, p3) followed by its own p3 byte extension.
+The commands are run in order and the response extension
+holds one 32-bit result per command, so the response value
+is 4 times the number of commands.  Data returned by a
+command (e.g. I2CRD) is not returned within a batch, only
+its result.  The whole batch is refused with PI_BAD_BATCH,
+and no command is run, if a command overruns the extension
+or is itself a BATCH or NOIB.
 */
 
 /* pseudo commands */
@@ -6316,6 +7035,13 @@ after this command is issued.
 #define PI_BAD_SPI_BAUD    -141 // bad SPI baud rate, not 50-500k
 #define PI_NOT_SPI_GPIO    -142 // no bit bang SPI in progress on GPIO
 #define PI_BAD_EVENT_ID    -143 // bad event id
+#define PI_BAD_ALERT_CFG   -144 // bad alert dispatch threads or ring size
+#define PI_BAD_PATTERN     -145 // bad pattern, bits outside mask
+#define PI_BAD_LATENCY     -146 // bad latency, not 0 or 100-1000000
+#define PI_BAD_SOCK_CFG    -147 // bad socket worker threads or connections
+#define PI_BAD_BATCH       -148 // bad batch, overrun or nested command
+#define PI_BAD_SOCK_PATH   -149 // bad socket path or group
+#define PI_BAD_LATENCY_TYPE -150 // bad latency histogram type
 
 #define PI_PIGIF_ERR_0    -2000
 #define PI_PIGIF_ERR_99   -2099
@@ -6347,6 +7073,12 @@ after this command is issued.
 #define PI_DEFAULT_UPDATE_MASK_PI3B        0x0000000FFFFFFCLL
 #define PI_DEFAULT_UPDATE_MASK_COMPUTE     0x00FFFFFFFFFFFFLL
 #define PI_DEFAULT_MEM_ALLOC_MODE          PI_MEM_ALLOC_AUTO
+#define PI_DEFAULT_ALERT_THREADS           0
+#define PI_DEFAULT_ALERT_RING              1024
+#define PI_DEFAULT_SOCK_THREADS            4
+#define PI_DEFAULT_SOCK_CONNS              256
+#define PI_DEFAULT_SOCKET_PATH             ""
+#define PI_DEFAULT_SOCKET_GID              -1
 
 #define PI_DEFAULT_CFG_INTERNALS           0
 
@@ -144,10 +144,19 @@ Advanced
 get_PWM_real_range        Get underlying PWM range for a GPIO
 
 notify_open               Request a notification handle
+notify_open_shm           Request a shared memory notification handle
 notify_begin              Start notifications for selected GPIO
 notify_pause              Pause notifications
+notify_encoding           Set the notification stream encoding
+notify_edges              Select the edges notified for GPIO
+notify_glitch             Set a glitch filter for a notification
+notify_latency            Set the most latency wanted for a notification
 notify_close              Close a notification
 
+get_latency               Get a histogram of daemon latencies
+
+batch_command             Run several commands in one exchange
+
 bb_serial_read_open       Open a GPIO for bit bang serial reads
 bb_serial_read            Read bit bang serial data from  a GPIO
 bb_serial_read_close      Close a GPIO for bit bang serial reads
@@ -273,6 +282,7 @@ Events
 
 event_callback            Sets a callback for an event
 event_trigger             Triggers an event
+event_set_pattern         Sets a level pattern which triggers an event
 wait_for_event            Wait for an event
 
 Custom
@@ -353,6 +363,21 @@ NTFY_FLAGS_ALIVE = (1 << 6)
 NTFY_FLAGS_WDOG  = (1 << 5)
 NTFY_FLAGS_GPIO  = 31
 
+# notification encodings
+
+NOTIFY_ENC_RAW   = 0
+NOTIFY_ENC_DELTA = 1
+
+# latency histograms
+
+LATENCY_ALERT  = 0
+LATENCY_NOTIFY = 1
+LATENCY_SCRIPT = 2
+
+_NTFY_DELTA_KEY   = (1 << 7)
+_NTFY_DELTA_FLAGS = (1 << 6)
+_NTFY_DELTA_LEVEL = (1 << 5)
+
 # wave modes
 
 WAVE_MODE_ONE_SHOT     =0
@@ -392,6 +417,9 @@ EVENT_BSC = 31
 
 _SOCK_CMD_LEN = 16
 
+# most bytes of command data the daemon accepts (CMD_MAX_EXTENSION - 1)
+_SOCK_MAX_EXT = 65535
+
 # pigpio command numbers
 
 _PI_CMD_MODES= 0
@@ -539,6 +567,19 @@ _PI_CMD_BSCX =114
 _PI_CMD_EVM  =115
 _PI_CMD_EVT  =116
 
+_PI_CMD_NOS  =117
+_PI_CMD_NE   =118
+_PI_CMD_NED  =119
+_PI_CMD_NG   =120
+
+_PI_CMD_EVP  =121
+
+_PI_CMD_NL   =122
+
+_PI_CMD_LH   =123
+
+_PI_CMD_BATCH=124
+
 # pigpio error numbers
 
 _PI_INIT_FAILED     =-1
@@ -685,6 +726,13 @@ PI_BAD_SCRIPT_NAME  =-140
 PI_BAD_SPI_BAUD     =-141
 PI_NOT_SPI_GPIO     =-142
 PI_BAD_EVENT_ID     =-143
+PI_BAD_ALERT_CFG    =-144
+PI_BAD_PATTERN      =-145
+PI_BAD_LATENCY      =-146
+PI_BAD_SOCK_CFG     =-147
+PI_BAD_BATCH        =-148
+PI_BAD_SOCK_PATH    =-149
+PI_BAD_LATENCY_TYPE =-150
 
 # pigpio error text
 
@@ -830,6 +878,13 @@ _errors=[
    [PI_BAD_SPI_BAUD      , "bad SPI baud rate, not 50-500k"],
    [PI_NOT_SPI_GPIO      , "no bit bang SPI in progress on GPIO"],
    [PI_BAD_EVENT_ID      , "bad event id"],
+   [PI_BAD_ALERT_CFG     , "bad alert dispatch threads or ring size"],
+   [PI_BAD_PATTERN       , "bad pattern, bits outside mask"],
+   [PI_BAD_LATENCY       , "bad latency, not 0 or 100-1000000"],
+   [PI_BAD_SOCK_CFG      , "bad socket worker threads or connections"],
+   [PI_BAD_BATCH         , "bad batch, overrun or nested command"],
+   [PI_BAD_SOCK_PATH     , "bad socket path or group"],
+   [PI_BAD_LATENCY_TYPE  , "bad latency histogram type"],
 ]
 
 _except_a = "%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%\n{}"
@@ -862,6 +917,17 @@ class _socklock:
       self.s = None
       self.l = threading.Lock()
 
+def _connect(host, port):
+   """
+   Returns a socket connected to the daemon.  A host starting
+   with / is the path of the daemon's local socket.
+   """
+   if host.startswith('/'):
+      s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+      s.connect(host)
+      return s
+   return socket.create_connection((host, port), None)
+
 class error(Exception):
    """pigpio module exception"""
    def __init__(self, value):
@@ -887,6 +953,67 @@ class pulse:
       self.gpio_off = gpio_off
       self.delay = delay
 
+class batch:
+   """
+   A class to collect commands which are sent to the daemon together
+   by [*batch_command*].  Each method queues the command of the pi
+   method of the same name.
+   """
+
+   def __init__(self):
+      """
+      Initialises an empty batch.
+      """
+      self.cmds = []
+
+   def _add(self, cmd, p1=0, p2=0, ext=b""):
+      self.cmds.append((cmd, p1, p2, ext))
+      return self
+
+   def set_mode(self, gpio, mode):
+      return self._add(_PI_CMD_MODES, gpio, mode)
+
+   def set_pull_up_down(self, gpio, pud):
+      return self._add(_PI_CMD_PUD, gpio, pud)
+
+   def read(self, gpio):
+      return self._add(_PI_CMD_READ, gpio)
+
+   def write(self, gpio, level):
+      return self._add(_PI_CMD_WRITE, gpio, level)
+
+   def set_PWM_dutycycle(self, user_gpio, dutycycle):
+      return self._add(_PI_CMD_PWM, user_gpio, int(dutycycle))
+
+   def set_PWM_range(self, user_gpio, range_):
+      return self._add(_PI_CMD_PRS, user_gpio, range_)
+
+   def set_PWM_frequency(self, user_gpio, frequency):
+      return self._add(_PI_CMD_PFS, user_gpio, frequency)
+
+   def set_servo_pulsewidth(self, user_gpio, pulsewidth):
+      return self._add(_PI_CMD_SERVO, user_gpio, int(pulsewidth))
+
+   def hardware_PWM(self, gpio, PWMfreq, PWMduty):
+      return self._add(
+         _PI_CMD_HP, gpio, PWMfreq, struct.pack("I", PWMduty))
+
+   def gpio_trigger(self, user_gpio, pulse_len=10, level=1):
+      return self._add(
+         _PI_CMD_TRIG, user_gpio, pulse_len, struct.pack("I", level))
+
+   def set_watchdog(self, user_gpio, wdog_timeout):
+      return self._add(_PI_CMD_WDOG, user_gpio, int(wdog_timeout))
+
+   def read_bank_1(self):
+      return self._add(_PI_CMD_BR1)
+
+   def clear_bank_1(self, bits):
+      return self._add(_PI_CMD_BC1, bits)
+
+   def set_bank_1(self, bits):
+      return self._add(_PI_CMD_BS1, bits)
+
 def error_text(errnum):
    """
    Returns a text description of a pigpio error.
@@ -1008,6 +1135,59 @@ def _pigpio_command_ext(sl, cmd, p1, p2, p3, extents, rl=True):
    if rl: sl.l.release()
    return res
 
+def _get_varint(buf, pos):
+   """
+   Returns (value, next position) for the varint at buf[pos],
+   (None, pos) if incomplete.
+   """
+   v = 0
+   shift = 0
+   while pos < len(buf):
+      b = buf[pos]
+      pos += 1
+      v |= (b & 0x7F) << shift
+      if not (b & 0x80):
+         return v & 0xFFFFFFFF, pos
+      shift += 7
+   return None, pos
+
+def _delta_decode(state, buf, pos):
+   """
+   Decodes one delta encoded notification record at buf[pos].
+
+   state:= [seqno, tick, level, keyed] updated in place.
+
+   Returns (next position, flags, tick, level) or None if the
+   record is incomplete.
+   """
+   hdr = buf[pos]
+   if hdr & _NTFY_DELTA_KEY:
+      if len(buf) - pos < 13:
+         return None
+      seq, flags, tick, level = struct.unpack_from('<HHII', buf, pos+1)
+      state[0:4] = [seq, tick, level, True]
+      return pos+13, flags, tick, level
+   n = pos + 1
+   flags = 0
+   if hdr & _NTFY_DELTA_FLAGS:
+      if len(buf) - n < 2:
+         return None
+      flags = struct.unpack_from('<H', buf, n)[0]
+      n += 2
+   if hdr & _NTFY_DELTA_LEVEL:
+      changed, n = _get_varint(buf, n)
+      if changed is None:
+         return None
+   else:
+      changed = 1 << (hdr & 0x1F)
+   delta, n = _get_varint(buf, n)
+   if delta is None:
+      return None
+   state[0] = (state[0] + 1) & 0xFFFF
+   state[1] = (state[1] + delta) & 0xFFFFFFFF
+   state[2] ^= changed
+   return n, flags, state[1], state[2]
+
 class _event_ADT:
    """
    An ADT class to hold event callback information.
@@ -1050,12 +1230,16 @@ class _callback_thread(threading.Thread):
       self.go = False
       self.daemon = True
       self.monitor = 0
+      self.rising = 0xFFFFFFFF
+      self.falling = 0xFFFFFFFF
       self.event_bits = 0
       self.callbacks = []
       self.events = []
-      self.sl.s = socket.create_connection((host, port), None)
+      self.sl.s = _connect(host, port)
       self.lastLevel = _pigpio_command(self.sl,  _PI_CMD_BR1, 0, 0)
       self.handle = _u2i(_pigpio_command(self.sl, _PI_CMD_NOIB, 0, 0))
+      self.delta = (_pigpio_command(
+         control, _PI_CMD_NE, self.handle, NOTIFY_ENC_DELTA) == 0)
       self.go = True
       self.start()
 
@@ -1065,9 +1249,31 @@ class _callback_thread(threading.Thread):
          self.go = False
          self.sl.s.send(struct.pack('IIII', _PI_CMD_NC, self.handle, 0, 0))
 
+   def _edges(self):
+      """
+      Has the daemon only send the edges the callbacks want.  Older
+      daemons reject the command and send every edge.
+      """
+      rising = 0
+      falling = 0
+      for c in self.callbacks:
+         if c.edge != FALLING_EDGE:
+            rising |= c.bit
+         if c.edge != RISING_EDGE:
+            falling |= c.bit
+      if rising != self.rising or falling != self.falling:
+         self.rising = rising
+         self.falling = falling
+         for bits, edge in ((rising & falling, EITHER_EDGE),
+                            (rising & ~falling, RISING_EDGE),
+                            (falling & ~rising, FALLING_EDGE)):
+            _pigpio_command_ext(self.control, _PI_CMD_NED,
+               self.handle, bits, 4, [struct.pack("I", edge)])
+
    def append(self, callb):
       """Adds a callback to the notification thread."""
       self.callbacks.append(callb)
+      self._edges()
       self.monitor = self.monitor | callb.bit
       _pigpio_command(self.control, _PI_CMD_NB, self.handle, self.monitor)
 
@@ -1075,6 +1281,7 @@ class _callback_thread(threading.Thread):
       """Removes a callback from the notification thread."""
       if callb in self.callbacks:
          self.callbacks.remove(callb)
+         self._edges()
          newMonitor = 0
          for c in self.callbacks:
             newMonitor |= c.bit
@@ -1105,10 +1312,42 @@ class _callback_thread(threading.Thread):
             _pigpio_command(
                self.control, _PI_CMD_EVM, self.handle, self.event_bits)
 
+   def _dispatch(self, flags, tick, level):
+      """Calls the callbacks interested in one report."""
+      if flags == 0:
+         changed = level ^ self.lastLevel
+         self.lastLevel = level
+         for cb in self.callbacks:
+            if cb.bit & changed:
+               newLevel = 0
+               if cb.bit & level:
+                  newLevel = 1
+               if (cb.edge ^ newLevel):
+                   cb.func(cb.gpio, newLevel, tick)
+      else:
+         if flags & NTFY_FLAGS_WDOG:
+            gpio = flags & NTFY_FLAGS_GPIO
+            for cb in self.callbacks:
+               if cb.gpio == gpio:
+                  cb.func(gpio, TIMEOUT, tick)
+         elif flags & NTFY_FLAGS_EVENT:
+            event = flags & NTFY_FLAGS_GPIO
+            for cb in self.events:
+               if cb.event == event:
+                  cb.func(event, tick)
+
    def run(self):
       """Runs the notification thread."""
 
-      lastLevel = self.lastLevel
+      if self.delta:
+         self._run_delta()
+      else:
+         self._run_raw()
+
+      self.sl.s.close()
+
+   def _run_raw(self):
+      """Reads fixed size 12 byte reports."""
 
       MSG_SIZ = 12
 
@@ -1121,28 +1360,35 @@ class _callback_thread(threading.Thread):
 
          if self.go:
             seq, flags, tick, level = (struct.unpack('HHII', buf))
+            self._dispatch(flags, tick, level)
+
+   def _run_delta(self):
+      """Reads delta encoded reports (see notify_encoding)."""
 
-            if flags == 0:
-               changed = level ^ lastLevel
-               lastLevel = level
-               for cb in self.callbacks:
-                  if cb.bit & changed:
-                     newLevel = 0
-                     if cb.bit & level:
-                        newLevel = 1
-                     if (cb.edge ^ newLevel):
-                         cb.func(cb.gpio, newLevel, tick)
-            else:
-               if flags & NTFY_FLAGS_WDOG:
-                  gpio = flags & NTFY_FLAGS_GPIO
-                  for cb in self.callbacks:
-                     if cb.gpio == gpio:
-                        cb.func(gpio, TIMEOUT, tick)
-               elif flags & NTFY_FLAGS_EVENT:
-                  event = flags & NTFY_FLAGS_GPIO
-                  for cb in self.events:
-                     if cb.event == event:
-                        cb.func(event, tick)
+      state = [0, 0, 0, False]
+      buf = bytearray()
+
+      while self.go:
+
+         data = self.sl.s.recv(4096)
+
+         if not data:
+            break
+
+         buf.extend(data)
+         pos = 0
+
+         while self.go and pos < len(buf):
+            if not state[3] and not (buf[pos] & _NTFY_DELTA_KEY):
+               self.go = False # stream out of step
+               break
+            r = _delta_decode(state, buf, pos)
+            if r is None:
+               break
+            pos, flags, tick, level = r
+            self._dispatch(flags, tick, level)
+
+         del buf[:pos]
 
       self.sl.s.close()
 
@@ -1676,6 +1922,26 @@ class pi():
       """
       return _u2i(_pigpio_command(self.sl, _PI_CMD_NO, 0, 0))
 
+   def notify_open_shm(self, reports):
+      """
+      Returns a notification handle (>=0) whose notifications are
+      written to a shared memory ring.
+
+      reports:= 64-1048576, a power of 2, the size of the ring.
+
+      Like pipes the ring is only accessible from the local machine.
+      Notifications for handle x are written to the shared memory
+      object /pigpiox (/dev/shm/pigpiox), see gpioNotifyOpenShm in
+      pigpio.h for the layout and how to read it.
+
+      ...
+      h = pi.notify_open_shm(1024)
+      if h >= 0:
+         pi.notify_begin(h, 1234)
+      ...
+      """
+      return _u2i(_pigpio_command(self.sl, _PI_CMD_NOS, reports, 0))
+
    def notify_begin(self, handle, bits):
       """
       Starts notifications on a handle.
@@ -1719,6 +1985,103 @@ class pi():
       """
       return _u2i(_pigpio_command(self.sl, _PI_CMD_NB, handle, 0))
 
+   def notify_encoding(self, handle, encoding):
+      """
+      Sets the encoding used for the reports sent on a handle.
+
+        handle:= >=0 (as returned by a prior call to [*notify_open*])
+      encoding:= NOTIFY_ENC_RAW or NOTIFY_ENC_DELTA.
+
+      NOTIFY_ENC_RAW sends the fixed size 12 byte reports.
+
+      NOTIFY_ENC_DELTA sends variable length records holding the
+      changes from the previous report, typically 3 bytes, with a
+      full keyframe at the start of the stream and periodically
+      thereafter.  See gpioNotifyEncoding in pigpio.h for the format.
+
+      The callback thread requests NOTIFY_ENC_DELTA automatically
+      when the daemon supports it.
+
+      ...
+      h = pi.notify_open()
+      if h >= 0:
+         pi.notify_encoding(h, pigpio.NOTIFY_ENC_DELTA)
+      ...
+      """
+      return _u2i(_pigpio_command(self.sl, _PI_CMD_NE, handle, encoding))
+
+   def notify_edges(self, handle, bits, edge):
+      """
+      Selects the level changes notified for the GPIO in bits.
+
+      handle:= >=0 (as returned by a prior call to [*notify_open*])
+        bits:= a 32 bit mask of the GPIO to set.
+        edge:= RISING_EDGE, FALLING_EDGE, or EITHER_EDGE.
+
+      Only the selected edges are notified, all edges are notified
+      when a handle is opened.  A GPIO notified on one edge only
+      shows that edge as a change of its level, its level is
+      reported as the level before the edge except in the report
+      of the edge itself.
+
+      The notifications used by [*callback*] are limited to the
+      edges the callbacks want.
+
+      ...
+      h = pi.notify_open()
+      if h >= 0:
+         pi.notify_edges(h, 1<<4, pigpio.FALLING_EDGE)
+         pi.notify_begin(h, 1<<4)
+      ...
+      """
+      # pigpio message format
+
+      # I p1 handle
+      # I p2 bits
+      # I p3 4
+      ## extension ##
+      # I edge
+      extents = [struct.pack("I", edge)]
+      return _u2i(_pigpio_command_ext(
+         self.sl, _PI_CMD_NED, handle, bits, 4, extents))
+
+   def notify_glitch(self, handle, steady):
+      """
+      Sets a glitch filter on the level changes notified by a handle.
+
+      handle:= >=0 (as returned by a prior call to [*notify_open*])
+      steady:= 0-300000
+
+      As [*set_glitch_filter*] but only for this handle.  A level
+      change is notified once the level has been steady for steady
+      microseconds.
+
+      A steady of 0 removes the filter.
+
+      ...
+      pi.notify_glitch(h, 100)
+      ...
+      """
+      return _u2i(_pigpio_command(self.sl, _PI_CMD_NG, handle, steady))
+
+   def notify_latency(self, handle, latency):
+      """
+      Sets the most microseconds wanted between a level change and
+      its report on a handle.
+
+       handle:= >=0 (as returned by a prior call to [*notify_open*])
+      latency:= 0 or 100-1000000
+
+      The daemon reads the sampled levels less often while they are
+      not changing.  A latency limits the interval while the handle
+      is running.  0, the default, accepts the daemon's interval.
+
+      ...
+      pi.notify_latency(h, 500)
+      ...
+      """
+      return _u2i(_pigpio_command(self.sl, _PI_CMD_NL, handle, latency))
+
    def notify_close(self, handle):
       """
       Stops notifications on a handle and releases the handle for reuse.
@@ -1736,6 +2099,86 @@ class pi():
       """
       return _u2i(_pigpio_command(self.sl, _PI_CMD_NC, handle, 0))
 
+   def batch_command(self, commands):
+      """
+      Sends several commands to the daemon at once.  The daemon runs
+      them in order and returns all their results together, so the
+      commands cost one network round trip rather than one each.
+
+      commands:= a [*batch*] of commands.
+
+      Returns a list of the results, one per command, in the order
+      queued.  A failed command's result is its (negative) error
+      number, no exception is raised for it.  A command which returns
+      data only returns its count.
+
+      The queued commands and their data must fit in 65535 bytes,
+      otherwise an exception is raised (PI_BAD_BATCH) and nothing is
+      sent.
+
+      ...
+      b = pigpio.batch()
+      b.write(4, 1).set_PWM_dutycycle(18, 128).read(17)
+      ok, pwm, level = pi.batch_command(b)
+      ...
+      """
+      ext = bytearray()
+      for cmd, p1, p2, x in commands.cmds:
+         ext.extend(struct.pack('IIII', cmd, p1, p2, len(x)))
+         ext.extend(x)
+      if len(ext) > _SOCK_MAX_EXT:
+         raise error("{}: batch of {} bytes, at most {}".format(
+            error_text(PI_BAD_BATCH), len(ext), _SOCK_MAX_EXT))
+      # Don't raise exception.  Must release lock.
+      bytes = u2i(_pigpio_command_ext(
+         self.sl, _PI_CMD_BATCH, 0, 0, len(ext), [ext], False))
+      if bytes > 0:
+         data = self._rxbuf(bytes)
+         results = list(struct.unpack('{}i'.format(bytes//4), _str(data)))
+      else:
+         results = []
+      self.sl.l.release()
+      if bytes < 0:
+         raise error(error_text(bytes))
+      return results
+
+   def get_latency(self, type, reset=0):
+      """
+      Gets a histogram of the microseconds between GPIO level changes
+      being sampled by the daemon and being delivered.
+
+       type:= LATENCY_ALERT, LATENCY_NOTIFY, or LATENCY_SCRIPT
+      reset:= 0 to keep the counts, otherwise clear them after reading
+
+      Returns a list of counts.  Item 0 counts latencies of 0 and
+      1 microseconds, item n counts latencies from 2**n to
+      2**(n+1)-1 microseconds.  The last item also counts anything
+      longer.
+
+      LATENCY_NOTIFY times each report until it is written to the
+      notification's pipe or socket, or put in its shared memory ring.
+
+      The histograms do not include the network delay to this client.
+
+      ...
+      for i, c in enumerate(pi.get_latency(pigpio.LATENCY_NOTIFY)):
+         if c:
+            print("<{} us: {}".format(2 << i, c))
+      ...
+      """
+      # Don't raise exception.  Must release lock.
+      bytes = u2i(
+         _pigpio_command(self.sl, _PI_CMD_LH, type, reset, False))
+      if bytes > 0:
+         data = self._rxbuf(bytes)
+         bins = list(struct.unpack('{}I'.format(bytes//4), _str(data)))
+      else:
+         bins = []
+      self.sl.l.release()
+      if bytes < 0:
+         raise error(error_text(bytes))
+      return bins
+
    def set_watchdog(self, user_gpio, wdog_timeout):
       """
       Sets a watchdog timeout for a GPIO.
@@ -3458,6 +3901,38 @@ class pi():
       """
       return _u2i(_pigpio_command(self.sl, _PI_CMD_EVT, event, 0))
 
+   def event_set_pattern(self, event, mask, pattern):
+      """
+      This function sets a level pattern which triggers an event.
+
+        event:= 0-31, the event
+         mask:= a 32 bit mask of the GPIO in the pattern
+      pattern:= the levels of the GPIO in mask
+
+      Returns 0 if OK, otherwise PI_BAD_EVENT_ID or PI_BAD_PATTERN.
+
+      The event is triggered at each level change after which
+      (level & mask) == pattern.  An [*event_callback*] is passed
+      the tick of the level change which matched.
+
+      A mask of 0 removes the pattern.
+
+      ...
+      # event 2 when GPIO 5 and 6 are low with GPIO 19 high
+      pi.event_set_pattern(2, (1<<5)|(1<<6)|(1<<19), (1<<19))
+      ...
+      """
+      # pigpio message format
+
+      # I p1 event
+      # I p2 mask
+      # I p3 4
+      ## extension ##
+      # I pattern
+      extents = [struct.pack("I", pattern)]
+      return _u2i(_pigpio_command_ext(
+         self.sl, _PI_CMD_EVP, event, mask, 4, extents))
+
 
    def bsc_xfer(self, bsc_control, data):
       """
@@ -4936,7 +5411,9 @@ class pi():
 
       host:= the host name of the Pi on which the pigpio daemon is
              running.  The default is localhost unless overridden by
-             the PIGPIO_ADDR environment variable.
+             the PIGPIO_ADDR environment variable.  A path, e.g.
+             /var/run/pigpio.sock, connects to the local socket of
+             a daemon on this machine started with -u.
        
       port:= the port number on which the pigpio daemon is listening.
              The default is 8888 unless overridden by the PIGPIO_PORT
@@ -4954,6 +5431,7 @@ class pi():
       pi = pigio.pi()              # use defaults
       pi = pigpio.pi('mypi')       # specify host, default port
       pi = pigpio.pi('mypi', 7777) # specify host and port
+      pi = pigpio.pi('/var/run/pigpio.sock') # local socket
 
       pi = pigpio.pi()             # exit script if no connection
       if not pi.connected:
@@ -4974,10 +5452,11 @@ class pi():
       self._port = port
 
       try:
-         self.sl.s = socket.create_connection((host, port), None)
+         self.sl.s = _connect(host, port)
 
          # Disable the Nagle algorithm.
-         self.sl.s.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+         if not host.startswith('/'):
+            self.sl.s.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
 
          self._notify = _callback_thread(self.sl, host, port)
 
@@ -5244,6 +5723,13 @@ def xref():
    PI_BAD_SPI_BAUD = -141
    PI_NOT_SPI_GPIO = -142
    PI_BAD_EVENT_ID = -143 
+   PI_BAD_ALERT_CFG = -144
+   PI_BAD_PATTERN = -145
+   PI_BAD_LATENCY = -146
+   PI_BAD_SOCK_CFG = -147
+   PI_BAD_BATCH = -148
+   PI_BAD_SOCK_PATH = -149
+   PI_BAD_LATENCY_TYPE = -150
    . .
 
    event:0-31
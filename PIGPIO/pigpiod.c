@@ -32,6 +32,7 @@ This version is for pigpio version 58+
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <pwd.h>
+#include <grp.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -60,6 +61,10 @@ static unsigned DMAprimaryChannel      = PI_DEFAULT_DMA_PRIMARY_CHANNEL;
 static unsigned DMAsecondaryChannel    = PI_DEFAULT_DMA_SECONDARY_CHANNEL;
 static unsigned socketPort             = PI_DEFAULT_SOCKET_PORT;
 static unsigned memAllocMode           = PI_DEFAULT_MEM_ALLOC_MODE;
+static unsigned sockThreads            = PI_DEFAULT_SOCK_THREADS;
+static unsigned sockMaxConns           = PI_DEFAULT_SOCK_CONNS;
+static char    *socketPath             = PI_DEFAULT_SOCKET_PATH;
+static int      socketGid              = PI_DEFAULT_SOCKET_GID;
 static uint64_t updateMask             = -1;
 
 static uint32_t cfgInternals           = PI_DEFAULT_CFG_INTERNALS;
@@ -102,11 +107,15 @@ void usage()
       "   -g,         run in foreground (do not fork),   default disabled\n" \
       "   -k,         disable socket interface,          default enabled\n" \
       "   -l,         localhost socket only              default local+remote\n" \
+      "   -m value,   socket connections, 1-4096,        default 256\n" \
       "   -n IP addr, allow address, name or dotted,     default allow all\n" \
       "   -p value,   socket port, 1024-32000,           default 8888\n" \
       "   -s value,   sample rate, 1, 2, 4, 5, 8, or 10, default 5\n" \
       "   -t value,   clock peripheral, 0=PWM 1=PCM,     default PCM\n" \
+      "   -u path,    local socket file,                 default none\n" \
+      "   -U group,   local socket group, name or id,    default none\n" \
       "   -v, -V,     display pigpio version and exit\n" \
+      "   -w value,   initial socket workers, 1-16,      default 4\n" \
       "   -x mask,    GPIO which may be updated,         default board GPIO\n" \
       "EXAMPLE\n" \
       "sudo pigpiod -s 2 -b 200 -f\n" \
@@ -161,8 +170,10 @@ static void initOpts(int argc, char *argv[])
    int opt, err, i;
    uint32_t addr;
    int64_t mask;
+   struct group *grp;
 
-   while ((opt = getopt(argc, argv, "a:b:c:d:e:fgkln:p:s:t:x:vV")) != -1)
+   while ((opt = getopt(argc, argv, "a:b:c:d:e:fgklm:n:p:s:t:u:U:w:x:vV"))
+          != -1)
    {
       switch (opt)
       {
@@ -217,6 +228,13 @@ static void initOpts(int argc, char *argv[])
             ifFlags |= PI_LOCALHOST_SOCK_IF;
             break; 
 
+         case 'm':
+            i = getNum(optarg, &err);
+            if ((i >= PI_MIN_SOCK_CONNS) && (i <= PI_MAX_SOCK_CONNS))
+               sockMaxConns = i;
+            else fatal("invalid -m option (%d)", i);
+            break;
+
          case 'n':
             addr = checkAddr(optarg);
             if (addr && (numSockNetAddr<MAX_CONNECT_ADDRESSES))
@@ -258,12 +276,35 @@ static void initOpts(int argc, char *argv[])
             else fatal("invalid -t option (%d)", i);
             break;
 
+         case 'u':
+            if (strlen(optarg) <= PI_MAX_SOCKET_PATH) socketPath = optarg;
+            else fatal("invalid -u option (%s)", optarg);
+            break;
+
+         case 'U':
+            grp = getgrnam(optarg);
+            if (grp) socketGid = grp->gr_gid;
+            else
+            {
+               i = getNum(optarg, &err);
+               if ((!err) && (i >= 0)) socketGid = i;
+               else fatal("invalid -U option (%s)", optarg);
+            }
+            break;
+
          case 'v':
          case 'V':
             printf("%d\n", PIGPIO_VERSION);
             exit(EXIT_SUCCESS);
             break;
 
+         case 'w':
+            i = getNum(optarg, &err);
+            if ((i >= PI_MIN_SOCK_THREADS) && (i <= PI_MAX_SOCK_THREADS))
+               sockThreads = i;
+            else fatal("invalid -w option (%d)", i);
+            break;
+
          case 'x':
             mask = getNum(optarg, &err);
             if (!err)
@@ -353,6 +394,10 @@ int main(int argc, char **argv)
 
    gpioCfgSocketPort(socketPort);
 
+   gpioCfgSocketServer(sockThreads, sockMaxConns);
+
+   gpioCfgSocketPath(socketPath, socketGid);
+
    gpioCfgMemAlloc(memAllocMode);
 
    if (updateMaskSet) gpioCfgPermissions(updateMask);
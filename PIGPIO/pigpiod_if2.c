@@ -42,6 +42,8 @@ For more information, please refer to <http://unlicense.org/>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
 #include <netinet/tcp.h>
 #include <sys/select.h>
 
@@ -58,26 +60,42 @@ For more information, please refer to <http://unlicense.org/>
 
 #define MAX_PI 32
 
+#define ASYNC_SLOTS 256 /* most async commands awaiting collection */
+
+#define ASYNC_FREE    0
+#define ASYNC_PENDING 1
+#define ASYNC_DONE    2
+
 typedef void (*CBF_t) ();
 
 struct callback_s
 {
 
-   int id;
+   unsigned id;
    int pi;
    int gpio;
    int edge;
    CBF_t f;
    void * user;
    int ex;
-   callback_t *prev;
-   callback_t *next;
+};
+
+/* the callbacks of a gpio, replaced rather than changed so the
+   notify thread may read it without a lock */
+
+typedef struct cbTable_s cbTable_t;
+
+struct cbTable_s
+{
+   cbTable_t *retired; /* next awaiting the notify thread */
+   int count;
+   callback_t cb[];
 };
 
 struct evtCallback_s
 {
 
-   int id;
+   unsigned id;
    int pi;
    int event;
    CBF_t f;
@@ -87,6 +105,43 @@ struct evtCallback_s
    evtCallback_t *next;
 };
 
+typedef struct
+{
+   int              got;   /* bytes in report */
+   cmdNotifyCodec_t codec;
+   gpioReport_t     report[PI_MAX_REPORTS_PER_READ];
+} notifyBuf_t;
+
+typedef struct
+{
+   int         state;
+   int         id;
+   int         res;
+   uint32_t    cmd;
+   void       *rxBuf;
+   unsigned    rxCount;
+   asyncFunc_t f;
+   void       *userdata;
+   int         keep;  /* result kept for async_wait */
+} asyncSlot_t;
+
+typedef struct
+{
+   int             pi;
+   int             sock;
+   pthread_t       pth;
+   pthread_mutex_t mutex;     /* slots and counts */
+   pthread_cond_t  cond;      /* a slot completed or was freed */
+   pthread_mutex_t sendMutex; /* keeps commands on the wire in id order */
+   uint32_t        sent;      /* commands sent */
+   uint32_t        done;      /* responses received */
+   int             free;      /* slots free */
+   int             failed;
+   int             running;   /* receive thread not yet joined */
+   uint8_t         order[ASYNC_SLOTS]; /* slots in the order sent */
+   asyncSlot_t     slot[ASYNC_SLOTS];
+} asyncLink_t;
+
 /* GLOBALS ---------------------------------------------------------------- */
 
 static int             gPiInUse     [MAX_PI];
@@ -94,22 +149,40 @@ static int             gPiInUse     [MAX_PI];
 static int             gPigCommand  [MAX_PI];
 static int             gPigHandle   [MAX_PI];
 static int             gPigNotify   [MAX_PI];
+static int             gPigEncoding [MAX_PI];
 
 static uint32_t        gEventBits   [MAX_PI];
 static uint32_t        gNotifyBits  [MAX_PI];
+static uint32_t        gRisingBits  [MAX_PI];
+static uint32_t        gFallingBits [MAX_PI];
 static uint32_t        gLastLevel   [MAX_PI];
 
-static pthread_t       *gPthNotify  [MAX_PI];
+static notifyBuf_t     *gNotifyBuf  [MAX_PI];
+
+static unsigned        gNotifyGen   [MAX_PI];
+
+static pthread_t       *gPthNotify = NULL;
+static int             gNotifyEpfd = -1;
+static int             gNotifyPis  = 0;
+static int             gNotifyBusy = 0;
+static pthread_mutex_t gNotifyMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  gNotifyCond  = PTHREAD_COND_INITIALIZER;
 
 static pthread_mutex_t gCmdMutex    [MAX_PI];
 static int             gCancelState [MAX_PI];
 
-static callback_t *gCallBackFirst = 0;
-static callback_t *gCallBackLast  = 0;
+static cbTable_t      *gCallBack    [MAX_PI][32];
+static cbTable_t      *gRetired     [MAX_PI];
+static pthread_mutex_t gCallBackMutex = PTHREAD_MUTEX_INITIALIZER;
 
 static evtCallback_t *geCallBackFirst = 0;
 static evtCallback_t *geCallBackLast  = 0;
 
+static asyncLink_t     *gAsync      [MAX_PI];
+static pthread_mutex_t gAsyncMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread asyncLink_t *gAsyncSelf = NULL; /* a receive thread's link */
+
 /* PRIVATE ---------------------------------------------------------------- */
 
 static void _pml(int pi)
@@ -238,6 +311,7 @@ static int pigpioOpenSocket(char *addr, char *port)
 {
    int sock, err, opt;
    struct addrinfo hints, *res, *rp;
+   struct sockaddr_un local;
    const char *addrStr, *portStr;
 
    if (!addr)
@@ -262,6 +336,30 @@ static int pigpioOpenSocket(char *addr, char *port)
    }
    else portStr = port;
 
+   /* an address starting with / is the daemon's local socket */
+
+   if (addrStr[0] == '/')
+   {
+      if (strlen(addrStr) >= sizeof(local.sun_path))
+         return pigif_bad_getaddrinfo;
+
+      memset(&local, 0, sizeof(local));
+      local.sun_family = AF_UNIX;
+      strcpy(local.sun_path, addrStr);
+
+      sock = socket(AF_UNIX, SOCK_STREAM, 0);
+
+      if (sock == -1) return pigif_bad_socket;
+
+      if (connect(sock, (struct sockaddr *)&local, sizeof(local)) == -1)
+      {
+         close(sock);
+         return pigif_bad_connect;
+      }
+
+      return sock;
+   }
+
    memset (&hints, 0, sizeof (hints));
 
    hints.ai_family   = PF_UNSPEC;
@@ -294,10 +392,11 @@ static int pigpioOpenSocket(char *addr, char *port)
 
 static void dispatch_notification(int pi, gpioReport_t *r)
 {
+   cbTable_t *t;
    callback_t *p;
    evtCallback_t *ep;
    uint32_t changed;
-   int l, g;
+   int i, l, g;
 
 /*
    printf("s=%4x f=%4x t=%10u l=%8x\n",
@@ -310,20 +409,30 @@ static void dispatch_notification(int pi, gpioReport_t *r)
 
       gLastLevel[pi] = r->level;
 
-      p = gCallBackFirst;
+      /* only visit the gpios which changed */
 
-      while (p)
+      while (changed)
       {
-         if (((p->pi) == pi) && (changed & (1<<(p->gpio))))
+         g = __builtin_ctz(changed);
+
+         changed &= (changed - 1);
+
+         t = __atomic_load_n(&gCallBack[pi][g], __ATOMIC_ACQUIRE);
+
+         if (t == NULL) continue;
+
+         if ((r->level) & (1<<g)) l = 1; else l = 0;
+
+         for (i=0; i<t->count; i++)
          {
-            if ((r->level) & (1<<(p->gpio))) l = 1; else l = 0;
+            p = &t->cb[i];
+
             if ((p->edge) ^ l)
             {
-               if (p->ex) (p->f)(pi, p->gpio, l, r->tick, p->user);
-               else       (p->f)(pi, p->gpio, l, r->tick);
+               if (p->ex) (p->f)(pi, g, l, r->tick, p->user);
+               else       (p->f)(pi, g, l, r->tick);
             }
          }
-         p = p->next;
       }
    }
    else
@@ -332,16 +441,14 @@ static void dispatch_notification(int pi, gpioReport_t *r)
       {
          g = (r->flags) & 31;
 
-         p = gCallBackFirst;
+         t = __atomic_load_n(&gCallBack[pi][g], __ATOMIC_ACQUIRE);
 
-         while (p)
+         for (i=0; t && (i<t->count); i++)
          {
-            if (((p->pi) == pi) && ((p->gpio) == g))
-            {
-               if (p->ex) (p->f)(pi, g, PI_TIMEOUT, r->tick, p->user);
-               else       (p->f)(pi, g, PI_TIMEOUT, r->tick);
-            }
-            p = p->next;
+            p = &t->cb[i];
+
+            if (p->ex) (p->f)(pi, g, PI_TIMEOUT, r->tick, p->user);
+            else       (p->f)(pi, g, PI_TIMEOUT, r->tick);
          }
       }
       else if ((r->flags) & PI_NTFY_FLAGS_EVENT)
@@ -363,58 +470,317 @@ static void dispatch_notification(int pi, gpioReport_t *r)
    }
 }
 
+static void retireCallBacks(int pi, cbTable_t *t)
+{
+   /* called with gCallBackMutex held */
+
+   if (t)
+   {
+      t->retired = gRetired[pi];
+      gRetired[pi] = t;
+   }
+}
+
+static void freeCallBacks(int pi)
+{
+   cbTable_t *t, *next;
+
+   /* called with gNotifyMutex held and not during a dispatch */
+
+   pthread_mutex_lock(&gCallBackMutex);
+   t = gRetired[pi];
+   gRetired[pi] = NULL;
+   pthread_mutex_unlock(&gCallBackMutex);
+
+   while (t)
+   {
+      next = t->retired;
+      free(t);
+      t = next;
+   }
+}
+
+static int notifyRead(int pi, gpioReport_t *batch, int *count)
+{
+   notifyBuf_t *nb = gNotifyBuf[pi];
+   uint8_t *buf = (uint8_t *)nb->report;
+   int bytes, room, r, used;
+
+   /*
+   Called by the notify thread, with gNotifyMutex held, when the pi's
+   socket is readable.  The reports are decoded into batch, at most
+   PI_MAX_REPORTS_PER_READ, for dispatch once the mutex is released.
+   Returns 1 while the stream is intact, otherwise the result of
+   the failed read or decode.
+   */
+
+   *count = 0;
+
+   room = sizeof(nb->report) - nb->got;
+
+   /* a compact record may be a single byte, so read no more bytes
+      than there are reports in a batch */
+
+   if ((gPigEncoding[pi] == PI_NOTIFY_ENC_DELTA) &&
+       (room > (PI_MAX_REPORTS_PER_READ - nb->got)))
+      room = PI_MAX_REPORTS_PER_READ - nb->got;
+
+   bytes = recv(gPigNotify[pi], buf+nb->got, room, MSG_DONTWAIT);
+
+   if (bytes < 0)
+   {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+         return 1;
+      return bytes;
+   }
+
+   if (bytes == 0) return 0;
+
+   nb->got += bytes;
+
+   if (gPigEncoding[pi] == PI_NOTIFY_ENC_DELTA)
+   {
+      r = 0;
+
+      while ((used = cmdNotifyDecode(&nb->codec, buf+r, nb->got-r,
+         &batch[*count])) > 0)
+      {
+         (*count)++;
+
+         r += used;
+      }
+
+      if (used < 0) return used;
+
+      /* move any partial record to the start of the buffer */
+
+      nb->got -= r;
+
+      if (nb->got && r) memmove(buf, buf+r, nb->got);
+
+      return 1;
+   }
+
+   r = 0;
+
+   while (nb->got >= (int)sizeof(gpioReport_t))
+   {
+      batch[(*count)++] = nb->report[r];
+
+      r++;
+
+      nb->got -= sizeof(gpioReport_t);
+   }
+
+   /* copy any partial report to start of array */
+
+   if (nb->got && r) nb->report[0] = nb->report[r];
+
+   return 1;
+}
+
 static void *pthNotifyThread(void *x)
 {
-   static int got = 0;
-   int pi;
-   int bytes, r;
-   gpioReport_t report[PI_MAX_REPORTS_PER_READ];
+   struct epoll_event ev[MAX_PI];
+   gpioReport_t *batch;
+   unsigned gen;
+   int i, j, n, pi, res, count, cancelState;
+
+   /* one thread reads the notifications of every connected pi */
+
+   batch = malloc(PI_MAX_REPORTS_PER_READ * sizeof(gpioReport_t));
 
-   pi = *((int*)x);
-   free(x); /* memory allocated in pigpio_start */
+   if (batch == NULL) return NULL;
+
+   pthread_cleanup_push(free, batch);
 
    while (1)
    {
-      bytes = read(gPigNotify[pi], (char*)&report+got, sizeof(report)-got);
+      n = epoll_wait(gNotifyEpfd, ev, MAX_PI, -1);
 
-      if (bytes > 0) got += bytes;
-      else break;
+      pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancelState);
+      pthread_mutex_lock(&gNotifyMutex);
 
-      r = 0;
+      for (i=0; i<n; i++)
+      {
+         pi = ev[i].data.u32;
+
+         /* the pi may have been stopped since epoll_wait returned */
+
+         if (gNotifyBuf[pi] == NULL) continue;
+
+         res = notifyRead(pi, batch, &count);
+
+         if (res <= 0)
+         {
+            fprintf(stderr,
+               "notify thread for pi %d broke with read error %d\n", pi, res);
+
+            epoll_ctl(gNotifyEpfd, EPOLL_CTL_DEL, gPigNotify[pi], NULL);
+         }
+
+         /* callbacks run without the mutex so they may start or stop
+            pis, a stop from another thread waits for the batch */
+
+         gen = gNotifyGen[pi];
+         gNotifyBusy = 1;
+
+         pthread_mutex_unlock(&gNotifyMutex);
+
+         for (j=0; j<count; j++)
+         {
+            /* a callback may have stopped the pi */
 
-      while (got >= sizeof(gpioReport_t))
+            if (gNotifyGen[pi] != gen) break;
+
+            dispatch_notification(pi, &batch[j]);
+         }
+
+         pthread_mutex_lock(&gNotifyMutex);
+
+         gNotifyBusy = 0;
+         pthread_cond_broadcast(&gNotifyCond);
+      }
+
+      for (pi=0; pi<MAX_PI; pi++)
       {
-         dispatch_notification(pi, &report[r]);
+         if (__atomic_load_n(&gRetired[pi], __ATOMIC_RELAXED))
+            freeCallBacks(pi);
+      }
+
+      pthread_mutex_unlock(&gNotifyMutex);
+      pthread_setcancelstate(cancelState, NULL);
+   }
+
+   pthread_cleanup_pop(1);
+
+   return NULL;
+}
+
+static int notifyStart(int pi)
+{
+   struct epoll_event ev;
+   int err = 0;
+
+   pthread_mutex_lock(&gNotifyMutex);
+
+   if (gNotifyEpfd < 0) gNotifyEpfd = epoll_create1(EPOLL_CLOEXEC);
+
+   gNotifyBuf[pi] = malloc(sizeof(notifyBuf_t));
 
-         r++;
+   if ((gNotifyEpfd < 0) || (gNotifyBuf[pi] == NULL)) err = 1;
+   else
+   {
+      gNotifyBuf[pi]->got = 0;
+      gNotifyBuf[pi]->codec.count = -1;
 
-         got -= sizeof(gpioReport_t);
+      memset(&ev, 0, sizeof(ev));
+      ev.events = EPOLLIN;
+      ev.data.u32 = pi;
+
+      if (epoll_ctl(gNotifyEpfd, EPOLL_CTL_ADD, gPigNotify[pi], &ev) < 0)
+         err = 1;
+   }
+
+   if (!err && !gPthNotify)
+   {
+      gPthNotify = start_thread(pthNotifyThread, NULL);
+
+      if (!gPthNotify)
+      {
+         epoll_ctl(gNotifyEpfd, EPOLL_CTL_DEL, gPigNotify[pi], NULL);
+         err = 1;
       }
+   }
 
-      /* copy any partial report to start of array */
-      
-      if (got && r) report[0] = report[r];
+   if (err)
+   {
+      free(gNotifyBuf[pi]);
+      gNotifyBuf[pi] = NULL;
    }
+   else gNotifyPis++;
 
-   fprintf(stderr, "notify thread for pi %d broke with read error %d\n",
-      pi, bytes);
+   pthread_mutex_unlock(&gNotifyMutex);
 
-   while (1) sleep(1);
+   if (err) return pigif_notify_failed;
 
-   return NULL;
+   return 0;
+}
+
+static void notifyStop(int pi)
+{
+   pthread_t *pth = NULL;
+   int self;
+
+   pthread_mutex_lock(&gNotifyMutex);
+
+   /* from a callback the notify thread is mid dispatch, otherwise
+      wait for any dispatch to finish */
+
+   self = gPthNotify && pthread_equal(pthread_self(), *gPthNotify);
+
+   while (gNotifyBusy && !self)
+      pthread_cond_wait(&gNotifyCond, &gNotifyMutex);
+
+   if (gNotifyBuf[pi])
+   {
+      epoll_ctl(gNotifyEpfd, EPOLL_CTL_DEL, gPigNotify[pi], NULL);
+
+      free(gNotifyBuf[pi]);
+      gNotifyBuf[pi] = NULL;
+
+      gNotifyGen[pi]++;
+
+      /* the thread stops with the last pi, unless this is the thread,
+         which then idles until another pi is started */
+
+      if ((--gNotifyPis == 0) && !self)
+      {
+         pth = gPthNotify;
+         gPthNotify = NULL;
+      }
+   }
+
+   /* the thread frees the callbacks it may be dispatching itself */
+
+   if (!self) freeCallBacks(pi);
+
+   pthread_mutex_unlock(&gNotifyMutex);
+
+   if (pth) stop_thread(pth);
 }
 
 static void findNotifyBits(int pi)
 {
-   callback_t *p;
-   uint32_t bits = 0;
+   cbTable_t *t;
+   uint32_t bits = 0, rising = 0, falling = 0;
+   int g, i;
 
-   p = gCallBackFirst;
+   /* called with gCallBackMutex held */
 
-   while (p)
+   for (g=0; g<32; g++)
    {
-      if (p->pi == pi) bits |= (1<<(p->gpio));
-      p = p->next;
+      t = gCallBack[pi][g];
+
+      for (i=0; t && (i<t->count); i++)
+      {
+         bits |= (1<<g);
+         if (t->cb[i].edge != FALLING_EDGE) rising  |= (1<<g);
+         if (t->cb[i].edge != RISING_EDGE)  falling |= (1<<g);
+      }
+   }
+
+   /* have the daemon only send the edges the callbacks want, older
+      daemons reject the command and send every edge */
+
+   if ((rising != gRisingBits[pi]) || (falling != gFallingBits[pi]))
+   {
+      gRisingBits[pi]  = rising;
+      gFallingBits[pi] = falling;
+
+      notify_edges(pi, gPigHandle[pi], rising & falling, EITHER_EDGE);
+      notify_edges(pi, gPigHandle[pi], rising & ~falling, RISING_EDGE);
+      notify_edges(pi, gPigHandle[pi], falling & ~rising, FALLING_EDGE);
    }
 
    if (bits != gNotifyBits[pi])
@@ -434,31 +800,40 @@ static int intCallback(
    int pi, unsigned user_gpio, unsigned edge, void *f, void *user, int ex)
 {
    static int id = 0;
+   cbTable_t *old, *t;
    callback_t *p;
+   int i, n;
+
+   if ((pi < 0) || (pi >= MAX_PI)) return pigif_unconnected_pi;
 
    if ((user_gpio >=0) && (user_gpio < 32) && (edge >=0) && (edge <= 2) && f)
    {
-      /* prevent duplicates */
+      pthread_mutex_lock(&gCallBackMutex);
 
-      p = gCallBackFirst;
+      old = gCallBack[pi][user_gpio];
 
-      while (p)
+      if (old) n = old->count; else n = 0;
+
+      /* prevent duplicates */
+
+      for (i=0; i<n; i++)
       {
-         if ((p->pi   == pi)        &&
-             (p->gpio == user_gpio) &&
-             (p->edge == edge)      &&
-             (p->f    == f))
+         if ((old->cb[i].edge == edge) && (old->cb[i].f == f))
          {
+            pthread_mutex_unlock(&gCallBackMutex);
             return pigif_duplicate_callback;
          }
-         p = p->next;
       }
 
-      p = malloc(sizeof(callback_t));
+      t = malloc(sizeof(cbTable_t) + ((n+1) * sizeof(callback_t)));
 
-      if (p)
+      if (t)
       {
-         if (!gCallBackFirst) gCallBackFirst = p;
+         if (n) memcpy(t->cb, old->cb, n * sizeof(callback_t));
+
+         t->count = n + 1;
+
+         p = &t->cb[n];
 
          p->id = id++;
          p->pi = pi;
@@ -467,17 +842,20 @@ static int intCallback(
          p->f = f;
          p->user = user;
          p->ex = ex;
-         p->next = 0;
-         p->prev = gCallBackLast;
 
-         if (p->prev) (p->prev)->next = p;
-         gCallBackLast = p;
+         __atomic_store_n(&gCallBack[pi][user_gpio], t, __ATOMIC_RELEASE);
+
+         retireCallBacks(pi, old);
 
          findNotifyBits(pi);
 
+         pthread_mutex_unlock(&gCallBackMutex);
+
          return p->id;
       }
 
+      pthread_mutex_unlock(&gCallBackMutex);
+
       return pigif_bad_malloc;
    }
 
@@ -562,7 +940,7 @@ static int intEventCallback(
    return pigif_bad_callback;
 }
 
-static int recvMax(int pi, void *buf, int bufsize, int sent)
+static int recvSockMax(int sock, void *buf, int bufsize, int sent)
 {
    /*
    Copy at most bufSize bytes from the receieved message to
@@ -573,7 +951,7 @@ static int recvMax(int pi, void *buf, int bufsize, int sent)
 
    if (sent < bufsize) count = sent; else count = bufsize;
 
-   if (count) recv(gPigCommand[pi], buf, count, MSG_WAITALL);
+   if (count) recv(sock, buf, count, MSG_WAITALL);
 
    remaining = sent - count;
 
@@ -581,13 +959,297 @@ static int recvMax(int pi, void *buf, int bufsize, int sent)
    {
       fetch = remaining;
       if (fetch > sizeof(scratch)) fetch = sizeof(scratch);
-      recv(gPigCommand[pi], scratch, fetch, MSG_WAITALL);
+      recv(sock, scratch, fetch, MSG_WAITALL);
       remaining -= fetch;
    }
 
    return count;
 }
 
+static int recvMax(int pi, void *buf, int bufsize, int sent)
+{
+   return recvSockMax(gPigCommand[pi], buf, bufsize, sent);
+}
+
+static int asyncHasExt(uint32_t cmd)
+{
+   /* the commands whose response is followed by data */
+
+   switch (cmd)
+   {
+      case PI_CMD_BATCH:
+      case PI_CMD_BI2CZ:
+      case PI_CMD_BSCX:
+      case PI_CMD_BSPIX:
+      case PI_CMD_CF2:
+      case PI_CMD_FL:
+      case PI_CMD_FR:
+      case PI_CMD_I2CPK:
+      case PI_CMD_I2CRD:
+      case PI_CMD_I2CRI:
+      case PI_CMD_I2CRK:
+      case PI_CMD_I2CZ:
+      case PI_CMD_LH:
+      case PI_CMD_PROCP:
+      case PI_CMD_SERR:
+      case PI_CMD_SLR:
+      case PI_CMD_SPIR:
+      case PI_CMD_SPIX:
+         return 1;
+   }
+
+   return 0;
+}
+
+static void asyncComplete(asyncLink_t *link, int res)
+{
+   asyncSlot_t *s;
+   asyncFunc_t f;
+   void *userdata;
+   int id;
+
+   /* responses arrive in the order the commands were sent */
+
+   pthread_mutex_lock(&link->mutex);
+
+   s = &link->slot[link->order[link->done % ASYNC_SLOTS]];
+
+   s->res = res;
+   f = s->f;
+   userdata = s->userdata;
+   id = s->id;
+
+   if (s->keep) s->state = ASYNC_DONE;
+   else
+   {
+      s->state = ASYNC_FREE;
+      link->free++;
+   }
+
+   link->done++;
+
+   pthread_cond_broadcast(&link->cond);
+   pthread_mutex_unlock(&link->mutex);
+
+   if (f) (f)(link->pi, id, res, userdata);
+}
+
+static void *pthAsyncThread(void *x)
+{
+   asyncLink_t *link = x;
+   asyncSlot_t *s;
+   cmdCmd_t cmd;
+   void *rxBuf;
+   unsigned rxCount;
+   int res;
+
+   gAsyncSelf = link;
+
+   while (recv(link->sock, &cmd, sizeof(cmd), MSG_WAITALL) == sizeof(cmd))
+   {
+      pthread_mutex_lock(&link->mutex);
+
+      if (link->done == link->sent)
+      {
+         /* a response to nothing, the link is out of step */
+         pthread_mutex_unlock(&link->mutex);
+         break;
+      }
+
+      s = &link->slot[link->order[link->done % ASYNC_SLOTS]];
+
+      rxBuf = s->rxBuf;
+      rxCount = s->rxCount;
+
+      pthread_mutex_unlock(&link->mutex);
+
+      res = cmd.res;
+
+      if (asyncHasExt(cmd.cmd) && (res > 0))
+         res = recvSockMax(link->sock, rxBuf, rxCount, res);
+
+      asyncComplete(link, res);
+   }
+
+   /* the link has closed, fail whatever is still outstanding */
+
+   pthread_mutex_lock(&link->mutex);
+
+   link->failed = 1;
+
+   while (link->done != link->sent)
+   {
+      pthread_mutex_unlock(&link->mutex);
+      asyncComplete(link, pigif_bad_recv);
+      pthread_mutex_lock(&link->mutex);
+   }
+
+   pthread_cond_broadcast(&link->cond);
+   pthread_mutex_unlock(&link->mutex);
+
+   return NULL;
+}
+
+static int asyncConnect(int pi)
+{
+   struct sockaddr_storage addr;
+   socklen_t len;
+   int sock, opt;
+
+   /* a connection to the same daemon as the command socket */
+
+   len = sizeof(addr);
+
+   if (getpeername(gPigCommand[pi], (struct sockaddr *)&addr, &len) < 0)
+      return -1;
+
+   sock = socket(addr.ss_family, SOCK_STREAM, 0);
+
+   if (sock < 0) return -1;
+
+   /* Disable the Nagle algorithm. */
+   opt = 1;
+   setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (char*)&opt, sizeof(int));
+
+   if (connect(sock, (struct sockaddr *)&addr, len) < 0)
+   {
+      close(sock);
+      return -1;
+   }
+
+   return sock;
+}
+
+static void asyncReopen(asyncLink_t *link)
+{
+   /* a failed link is reconnected by the next command, holding only
+      its send mutex.  Its receive thread has failed everything
+      outstanding and ended, results not yet collected stay in their
+      slots.  Not from the receive thread itself, e.g. a function
+      called as it fails the outstanding. */
+
+   if (gAsyncSelf == link) return;
+
+   pthread_mutex_lock(&link->sendMutex);
+
+   if (link->failed)
+   {
+      if (link->running)
+      {
+         pthread_join(link->pth, NULL);
+         link->running = 0;
+      }
+
+      if (link->sock >= 0) close(link->sock);
+
+      link->sock = asyncConnect(link->pi);
+
+      if (link->sock >= 0)
+      {
+         pthread_mutex_lock(&link->mutex);
+         link->failed = 0;
+         pthread_mutex_unlock(&link->mutex);
+
+         if (pthread_create(&link->pth, NULL, pthAsyncThread, link) == 0)
+            link->running = 1;
+         else
+         {
+            link->failed = 1;
+            close(link->sock);
+            link->sock = -1;
+         }
+      }
+   }
+
+   pthread_mutex_unlock(&link->sendMutex);
+}
+
+static asyncLink_t *asyncLink(int pi)
+{
+   asyncLink_t *link;
+   int sock;
+
+   /* async commands have their own connection, opened to the same
+      daemon as the command socket when first needed.  No connect is
+      made holding gAsyncMutex, which is shared by every pi. */
+
+   pthread_mutex_lock(&gAsyncMutex);
+   link = gAsync[pi];
+   pthread_mutex_unlock(&gAsyncMutex);
+
+   if (link)
+   {
+      if (__atomic_load_n(&link->failed, __ATOMIC_ACQUIRE))
+         asyncReopen(link);
+
+      return link;
+   }
+
+   sock = asyncConnect(pi);
+
+   if (sock < 0) return NULL;
+
+   pthread_mutex_lock(&gAsyncMutex);
+
+   link = gAsync[pi];
+
+   if (link) close(sock); /* another thread connected first */
+   else
+   {
+      link = calloc(1, sizeof(asyncLink_t));
+
+      if (link)
+      {
+         link->pi = pi;
+         link->sock = sock;
+         link->free = ASYNC_SLOTS;
+
+         pthread_mutex_init(&link->mutex, NULL);
+         pthread_mutex_init(&link->sendMutex, NULL);
+         pthread_cond_init(&link->cond, NULL);
+
+         if (pthread_create(&link->pth, NULL, pthAsyncThread, link))
+         {
+            free(link);
+            link = NULL;
+         }
+         else link->running = 1;
+      }
+
+      if (link == NULL) close(sock);
+
+      gAsync[pi] = link;
+   }
+
+   pthread_mutex_unlock(&gAsyncMutex);
+
+   return link;
+}
+
+static void asyncClose(int pi)
+{
+   asyncLink_t *link;
+
+   link = gAsync[pi];
+
+   if (link)
+   {
+      /* wakes the receive thread, which fails anything outstanding */
+
+      if (link->sock >= 0) shutdown(link->sock, SHUT_RDWR);
+      if (link->running) pthread_join(link->pth, NULL);
+      if (link->sock >= 0) close(link->sock);
+
+      pthread_mutex_destroy(&link->mutex);
+      pthread_mutex_destroy(&link->sendMutex);
+      pthread_cond_destroy(&link->cond);
+
+      free(link);
+
+      gAsync[pi] = NULL;
+   }
+}
+
 /* PUBLIC ----------------------------------------------------------------- */
 
 double time_time(void)
@@ -653,6 +1315,10 @@ char *pigpio_error(int errnum)
             return "not connected to Pi";
          case pigif_too_many_pis:
             return "too many connected Pis";
+         case pigif_bad_async:
+            return "bad async command or id";
+         case pigif_async_full:
+            return "too many async results awaiting collection";
 
          default:
             return "unknown error";
@@ -711,7 +1377,6 @@ void stop_thread(pthread_t *pth)
 int pigpio_start(char *addrStr, char *portStr)
 {
    int pi;
-   int *userdata;
 
    if ((!addrStr) || (strlen(addrStr) == 0))
    {
@@ -742,16 +1407,21 @@ int pigpio_start(char *addrStr, char *portStr)
          if (gPigHandle[pi] < 0) return pigif_bad_noib;
          else
          {
-            gLastLevel[pi] = read_bank_1(pi);
+            /* use the compact encoding if the daemon has it */
+
+            if (pigpio_command(pi, PI_CMD_NE, gPigHandle[pi],
+                   PI_NOTIFY_ENC_DELTA, 1) == 0)
+               gPigEncoding[pi] = PI_NOTIFY_ENC_DELTA;
+            else
+               gPigEncoding[pi] = PI_NOTIFY_ENC_RAW;
 
-            /* must be freed by pthNotifyThread */
-            userdata = malloc(sizeof(*userdata));
-            *userdata = pi;
+            gLastLevel[pi] = read_bank_1(pi);
 
-            gPthNotify[pi] = start_thread(pthNotifyThread, userdata);
+            gRisingBits[pi]  = 0xFFFFFFFF;
+            gFallingBits[pi] = 0xFFFFFFFF;
 
-            if (gPthNotify[pi]) return pi;
-            else                return pigif_notify_failed;
+            if (notifyStart(pi) == 0) return pi;
+            else                      return pigif_notify_failed;
 
          }
       }
@@ -764,11 +1434,9 @@ void pigpio_stop(int pi)
 {
    if ((pi < 0) || (pi >= MAX_PI) || !gPiInUse[pi]) return;
 
-   if (gPthNotify[pi])
-   {
-      stop_thread(gPthNotify[pi]);
-      gPthNotify[pi] = 0;
-   }
+   asyncClose(pi);
+
+   notifyStop(pi);
 
    if (gPigCommand[pi] >= 0)
    {
@@ -836,6 +1504,37 @@ int get_servo_pulsewidth(int pi, unsigned user_gpio)
 int notify_open(int pi)
    {return pigpio_command(pi, PI_CMD_NO, 0, 0, 1);}
 
+int notify_open_shm(int pi, unsigned reports)
+   {return pigpio_command(pi, PI_CMD_NOS, reports, 0, 1);}
+
+int notify_encoding(int pi, unsigned handle, unsigned encoding)
+   {return pigpio_command(pi, PI_CMD_NE, handle, encoding, 1);}
+
+int notify_edges(int pi, unsigned handle, uint32_t bits, unsigned edge)
+{
+   gpioExtent_t ext[1];
+
+   /*
+   p1=handle
+   p2=bits
+   p3=4
+   ## extension ##
+   unsigned edge
+   */
+
+   ext[0].size = sizeof(uint32_t);
+   ext[0].ptr = &edge;
+
+   return pigpio_command_ext(
+      pi, PI_CMD_NED, handle, bits, 4, 1, ext, 1);
+}
+
+int notify_glitch(int pi, unsigned handle, unsigned steady)
+   {return pigpio_command(pi, PI_CMD_NG, handle, steady, 1);}
+
+int notify_latency(int pi, unsigned handle, unsigned latency)
+   {return pigpio_command(pi, PI_CMD_NL, handle, latency, 1);}
+
 int notify_begin(int pi, unsigned handle, uint32_t bits)
    {return pigpio_command(pi, PI_CMD_NB, handle, bits, 1);}
 
@@ -845,6 +1544,256 @@ int notify_pause(int pi, unsigned handle)
 int notify_close(int pi, unsigned handle)
    {return pigpio_command(pi, PI_CMD_NC, handle, 0, 1);}
 
+int get_latency(int pi, unsigned type, unsigned reset, uint32_t *bins)
+{
+   int bytes;
+
+   bytes = pigpio_command(pi, PI_CMD_LH, type, reset, 0);
+
+   if (bytes > 0)
+   {
+      bytes = recvMax(pi, bins, PI_LATENCY_BINS*4, bytes);
+   }
+
+   _pmu(pi);
+
+   if (bytes > 0) return bytes / 4;
+
+   return bytes;
+}
+
+int batch_command(int pi, unsigned count, batchCmd_t *cmds, int *results)
+{
+   unsigned i;
+   int bytes;
+   uint32_t *hdr;
+   gpioExtent_t *ext;
+   unsigned size;
+
+   /*
+   p1=0
+   p2=0
+   p3=size
+   ## extension ##
+   for each command
+      uint32_t cmd, p1, p2, size
+      char ext[size]
+   */
+
+   hdr = malloc(count * 16);
+   ext = malloc(count * 2 * sizeof(gpioExtent_t));
+
+   if ((hdr == NULL) || (ext == NULL))
+   {
+      free(hdr);
+      free(ext);
+      return pigif_bad_malloc;
+   }
+
+   size = 0;
+
+   for (i=0; i<count; i++)
+   {
+      hdr[(i*4)+0] = cmds[i].cmd;
+      hdr[(i*4)+1] = cmds[i].p1;
+      hdr[(i*4)+2] = cmds[i].p2;
+      hdr[(i*4)+3] = cmds[i].size;
+
+      ext[i*2].size = 16;
+      ext[i*2].ptr = &hdr[i*4];
+
+      ext[(i*2)+1].size = cmds[i].size;
+      ext[(i*2)+1].ptr = cmds[i].ext;
+
+      size += 16 + cmds[i].size;
+   }
+
+   if (size >= CMD_MAX_EXTENSION)
+   {
+      free(hdr);
+      free(ext);
+      return PI_BAD_BATCH;
+   }
+
+   bytes = pigpio_command_ext
+      (pi, PI_CMD_BATCH, 0, 0, size, count*2, ext, 0);
+
+   free(hdr);
+   free(ext);
+
+   if (bytes > 0)
+   {
+      bytes = recvMax(pi, results, count*4, bytes);
+   }
+
+   _pmu(pi);
+
+   if (bytes > 0) return bytes / 4;
+
+   return bytes;
+}
+
+static int intAsyncCommand(int pi, batchCmd_t *cmd, void *rxBuf,
+   unsigned rxCount, asyncFunc_t f, void *userdata, int keep)
+{
+   asyncLink_t *link;
+   asyncSlot_t *s;
+   cmdCmd_t hdr;
+   struct iovec iov[2];
+   struct msghdr msg;
+   int id, len, i, self;
+
+   if ((pi < 0) || (pi >= MAX_PI) || !gPiInUse[pi])
+      return pigif_unconnected_pi;
+
+   if ((cmd->cmd == PI_CMD_NOIB) || (cmd->size >= CMD_MAX_EXTENSION))
+      return pigif_bad_async;
+
+   link = asyncLink(pi);
+
+   if (link == NULL) return pigif_bad_connect;
+
+   /* from the receive thread, i.e. in a function, it must not wait
+      for a completion only it can deliver, nor for a reopen which
+      joins it */
+
+   self = (gAsyncSelf == link);
+
+   if (self && link->failed) return pigif_bad_send;
+
+   /* if the window is full wait for a command in flight to complete,
+      results awaiting async_wait won't be freed by waiting here.
+      The send mutex isn't held while waiting, so a function may
+      send meanwhile. */
+
+   while (1)
+   {
+      pthread_mutex_lock(&link->mutex);
+
+      while ((link->free == 0) && (link->done != link->sent) &&
+             !link->failed && !self)
+         pthread_cond_wait(&link->cond, &link->mutex);
+
+      pthread_mutex_unlock(&link->mutex);
+
+      pthread_mutex_lock(&link->sendMutex);
+      pthread_mutex_lock(&link->mutex);
+
+      if ((link->free > 0) || (link->done == link->sent) ||
+          link->failed || self) break;
+
+      /* another sender took the slot */
+
+      pthread_mutex_unlock(&link->mutex);
+      pthread_mutex_unlock(&link->sendMutex);
+   }
+
+   if (link->failed || (link->free == 0))
+   {
+      pthread_mutex_unlock(&link->mutex);
+      pthread_mutex_unlock(&link->sendMutex);
+      return link->failed ? pigif_bad_send : pigif_async_full;
+   }
+
+   for (i=0; i<ASYNC_SLOTS; i++)
+   {
+      if (link->slot[i].state == ASYNC_FREE) break;
+   }
+
+   /* the slot is in the low bits of the id */
+
+   id = ((link->sent & 0x7FFFFF) << 8) | i;
+
+   s = &link->slot[i];
+
+   s->state = ASYNC_PENDING;
+   s->id = id;
+   s->cmd = cmd->cmd;
+   s->rxBuf = rxBuf;
+   s->rxCount = rxBuf ? rxCount : 0;
+   s->f = f;
+   s->userdata = userdata;
+   s->keep = keep;
+
+   link->order[link->sent % ASYNC_SLOTS] = i;
+
+   link->free--;
+   link->sent++;
+
+   pthread_mutex_unlock(&link->mutex);
+
+   hdr.cmd = cmd->cmd;
+   hdr.p1  = cmd->p1;
+   hdr.p2  = cmd->p2;
+   hdr.p3  = cmd->size;
+
+   iov[0].iov_base = &hdr;
+   iov[0].iov_len  = sizeof(hdr);
+   iov[1].iov_base = cmd->ext;
+   iov[1].iov_len  = cmd->size;
+
+   memset(&msg, 0, sizeof(msg));
+   msg.msg_iov = iov;
+   msg.msg_iovlen = 2;
+
+   len = sizeof(hdr) + cmd->size;
+
+   /* a failed send closes the link, the command then completes
+      with pigif_bad_recv like any other outstanding */
+
+   if (sendmsg(link->sock, &msg, MSG_NOSIGNAL) != len)
+      shutdown(link->sock, SHUT_RDWR);
+
+   pthread_mutex_unlock(&link->sendMutex);
+
+   return id;
+}
+
+int async_command(int pi, batchCmd_t *cmd, void *rxBuf, unsigned rxCount)
+   {return intAsyncCommand(pi, cmd, rxBuf, rxCount, NULL, NULL, 1);}
+
+int async_command_func(int pi, batchCmd_t *cmd, void *rxBuf, unsigned rxCount,
+   asyncFunc_t f, void *userdata)
+   {return intAsyncCommand(pi, cmd, rxBuf, rxCount, f, userdata, 0);}
+
+int async_wait(int pi, int id)
+{
+   asyncLink_t *link;
+   asyncSlot_t *s;
+   int res;
+
+   if ((pi < 0) || (pi >= MAX_PI) || !gPiInUse[pi])
+      return pigif_unconnected_pi;
+
+   link = gAsync[pi];
+
+   if ((link == NULL) || (id < 0)) return pigif_bad_async;
+
+   pthread_mutex_lock(&link->mutex);
+
+   s = &link->slot[id & (ASYNC_SLOTS-1)];
+
+   if ((s->id != id) || (s->state == ASYNC_FREE) || !s->keep)
+   {
+      pthread_mutex_unlock(&link->mutex);
+      return pigif_bad_async;
+   }
+
+   while (s->state == ASYNC_PENDING)
+      pthread_cond_wait(&link->cond, &link->mutex);
+
+   res = s->res;
+
+   s->state = ASYNC_FREE;
+
+   link->free++;
+
+   pthread_cond_broadcast(&link->cond);
+   pthread_mutex_unlock(&link->mutex);
+
+   return res;
+}
+
 int set_watchdog(int pi, unsigned user_gpio, unsigned timeout)
    {return pigpio_command(pi, PI_CMD_WDOG, user_gpio, timeout, 1);}
 
@@ -1949,31 +2898,60 @@ int callback_ex(
 
 int callback_cancel(unsigned id)
 {
-   callback_t *p;
-   int pi;
+   cbTable_t *old, *t;
+   int pi, g, i, n;
 
-   p = gCallBackFirst;
+   pthread_mutex_lock(&gCallBackMutex);
 
-   while (p)
+   for (pi=0; pi<MAX_PI; pi++)
    {
-      if (p->id == id)
+      for (g=0; g<32; g++)
       {
-         pi = p->pi;
+         old = gCallBack[pi][g];
 
-         if (p->prev) {p->prev->next = p->next;}
-         else         {gCallBackFirst = p->next;}
+         if (old == NULL) continue;
 
-         if (p->next) {p->next->prev = p->prev;}
-         else         {gCallBackLast = p->prev;}
+         for (i=0; i<old->count; i++)
+         {
+            if (old->cb[i].id == id) break;
+         }
+
+         if (i == old->count) continue;
+
+         n = old->count - 1;
+
+         t = NULL;
 
-         free(p);
+         if (n)
+         {
+            t = malloc(sizeof(cbTable_t) + (n * sizeof(callback_t)));
+
+            if (t == NULL)
+            {
+               pthread_mutex_unlock(&gCallBackMutex);
+               return pigif_bad_malloc;
+            }
+
+            memcpy(t->cb, old->cb, i * sizeof(callback_t));
+            memcpy(t->cb+i, old->cb+i+1, (n-i) * sizeof(callback_t));
+
+            t->count = n;
+         }
+
+         __atomic_store_n(&gCallBack[pi][g], t, __ATOMIC_RELEASE);
+
+         retireCallBacks(pi, old);
 
          findNotifyBits(pi);
 
+         pthread_mutex_unlock(&gCallBackMutex);
+
          return 0;
       }
-      p = p->next;
    }
+
+   pthread_mutex_unlock(&gCallBackMutex);
+
    return pigif_callback_not_found;
 }
 
@@ -2110,3 +3088,23 @@ int wait_for_event(int pi, unsigned event, double timeout)
 int event_trigger(int pi, unsigned event)
    {return pigpio_command(pi, PI_CMD_EVM, event, 0, 1);}
 
+int event_set_pattern(
+   int pi, unsigned event, uint32_t mask, uint32_t pattern)
+{
+   gpioExtent_t ext[1];
+
+   /*
+   p1=event
+   p2=mask
+   p3=4
+   ## extension ##
+   uint32_t pattern
+   */
+
+   ext[0].size = sizeof(uint32_t);
+   ext[0].ptr = &pattern;
+
+   return pigpio_command_ext(
+      pi, PI_CMD_EVP, event, mask, 4, 1, ext, 1);
+}
+
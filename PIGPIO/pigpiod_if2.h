@@ -154,10 +154,23 @@ ADVANCED
 get_PWM_real_range         Get underlying PWM range for a GPIO
 
 notify_open                Request a notification handle
+notify_open_shm            Request a shared memory notification handle
+notify_encoding            Select the notification stream encoding
+notify_edges               Select the edges notified for GPIO
+notify_glitch              Sets a glitch filter for a notification
+notify_latency             Sets the most latency wanted for a notification
 notify_begin               Start notifications for selected GPIO
 notify_pause               Pause notifications
 notify_close               Close a notification
 
+get_latency                Get a histogram of daemon latencies
+
+batch_command              Run several commands in one exchange
+
+async_command              Send a command without waiting for its result
+async_command_func         Send a command with a completion callback
+async_wait                 Wait for the result of an async command
+
 bb_serial_read_open        Opens a GPIO for bit bang serial reads
 bb_serial_read             Reads bit bang serial data from a GPIO
 bb_serial_read_close       Closes a GPIO for bit bang serial reads
@@ -289,6 +302,7 @@ event_callback            Sets a callback for an event
 event_callback_ex         Sets a callback for an event, extended
 event_callback_cancel     Cancel an event callback
 event_trigger             Triggers an event
+event_set_pattern         Sets a level pattern which triggers an event
 wait_for_event            Wait for an event
 
 CUSTOM
@@ -331,6 +345,18 @@ typedef void (*evtCBFuncEx_t)
 
 typedef struct evtCallback_s evtCallback_t;
 
+typedef struct
+{
+   unsigned cmd;  /* PI_CMD_... */
+   unsigned p1;
+   unsigned p2;
+   unsigned size; /* bytes at ext */
+   void    *ext;
+} batchCmd_t;
+
+typedef void (*asyncFunc_t)
+   (int pi, int id, int res, void *userdata);
+
 /*F*/
 double time_time(void);
 /*D
@@ -417,6 +443,11 @@ Returns an integer value greater than or equal to zero if OK.
 
 This value is passed to the GPIO routines to specify the Pi
 to be operated on.
+
+An addrStr starting with / is the path of the daemon's local socket,
+e.g. /var/run/pigpio.sock if started with -u /var/run/pigpio.sock,
+and portStr is then ignored.  A local
+socket avoids the TCP/IP overhead for a daemon on the same machine.
 D*/
 
 /*F*/
@@ -778,6 +809,113 @@ E.g. if the function returns 15 then the notifications must be
 read from /dev/pigpio15.
 D*/
 
+/*F*/
+int notify_open_shm(int pi, unsigned reports);
+/*D
+Get a free notification handle whose notifications are written to
+a shared memory ring.
+
+. .
+     pi: >=0 (as returned by [*pigpio_start*]).
+reports: 64-1048576, a power of 2, the size of the ring.
+. .
+
+Returns a handle greater than or equal to zero if OK,
+otherwise PI_NO_HANDLE, PI_BAD_PARAM, or PI_BAD_PATHNAME.
+
+Like pipes the ring is only accessible from the local machine.
+Notifications for handle x are written to the shared memory object
+/pigpiox (/dev/shm/pigpiox), see gpioNotifyOpenShm in pigpio.h for
+the layout and how to read it.
+D*/
+
+/*F*/
+int notify_encoding(int pi, unsigned handle, unsigned encoding);
+/*D
+Select how notifications are encoded on a previously opened handle.
+
+. .
+      pi: >=0 (as returned by [*pigpio_start*]).
+  handle: 0-31 (as returned by [*notify_open*])
+encoding: 0-1
+. .
+
+Returns 0 if OK, otherwise PI_BAD_HANDLE or PI_BAD_PARAM.
+
+PI_NOTIFY_ENC_RAW (0), the default, writes 12 byte reports.
+PI_NOTIFY_ENC_DELTA (1) writes variable length records, typically
+2 or 3 bytes per level change, see gpioNotifyEncoding in pigpio.h
+for the format.  pig2vcd -d reads the delta encoding.
+
+Select the encoding before [*notify_begin*].
+
+The notifications used by [*callback*] are delta encoded when the
+daemon supports it.
+D*/
+
+/*F*/
+int notify_edges(int pi, unsigned handle, uint32_t bits, unsigned edge);
+/*D
+Select the level changes notified for the GPIO in bits on a
+previously opened handle.
+
+. .
+    pi: >=0 (as returned by [*pigpio_start*]).
+handle: 0-31 (as returned by [*notify_open*])
+  bits: a mask of the GPIO to set.
+  edge: RISING_EDGE, FALLING_EDGE, or EITHER_EDGE.
+. .
+
+Returns 0 if OK, otherwise PI_BAD_HANDLE or PI_BAD_EDGE.
+
+Only the selected edges are notified, all edges are notified when a
+handle is opened.  A GPIO notified on one edge only shows that edge
+as a change of its level, its level is reported as the level before
+the edge except in the report of the edge itself.
+
+The notifications used by [*callback*] are limited to the edges the
+callbacks want.
+D*/
+
+/*F*/
+int notify_glitch(int pi, unsigned handle, unsigned steady);
+/*D
+Sets a glitch filter on the level changes notified by a previously
+opened handle.
+
+. .
+    pi: >=0 (as returned by [*pigpio_start*]).
+handle: 0-31 (as returned by [*notify_open*])
+steady: 0-300000
+. .
+
+Returns 0 if OK, otherwise PI_BAD_HANDLE or PI_BAD_FILTER.
+
+As [*set_glitch_filter*] but only for this handle.  A level change is
+notified once the level has been steady for steady microseconds.
+
+A steady of 0 removes the filter.
+D*/
+
+/*F*/
+int notify_latency(int pi, unsigned handle, unsigned latency);
+/*D
+Sets the most microseconds wanted between a level change and its
+report on a previously opened handle.
+
+. .
+     pi: >=0 (as returned by [*pigpio_start*]).
+ handle: 0-31 (as returned by [*notify_open*])
+latency: 0 or 100-1000000
+. .
+
+Returns 0 if OK, otherwise PI_BAD_HANDLE or PI_BAD_LATENCY.
+
+The daemon reads the sampled levels less often while they are not
+changing.  A latency limits the interval while the handle is running.
+0, the default, accepts the daemon's interval.
+D*/
+
 /*F*/
 int notify_begin(int pi, unsigned handle, uint32_t bits);
 /*D
@@ -859,6 +997,169 @@ handle: 0-31 (as returned by [*notify_open*])
 Returns 0 if OK, otherwise PI_BAD_HANDLE.
 D*/
 
+/*F*/
+int get_latency(int pi, unsigned type, unsigned reset, uint32_t *bins);
+/*D
+Gets a histogram of the microseconds between GPIO level changes being
+sampled by the daemon and being delivered.
+
+. .
+   pi: >=0 (as returned by [*pigpio_start*]).
+ type: PI_LATENCY_ALERT, PI_LATENCY_NOTIFY, or PI_LATENCY_SCRIPT
+reset: 0 to keep the counts, otherwise clear them after reading
+ bins: an array of PI_LATENCY_BINS counts
+. .
+
+Returns PI_LATENCY_BINS if OK, otherwise PI_BAD_LATENCY_TYPE.
+
+bins[0] counts latencies of 0 and 1 microseconds, and bins[n] counts
+latencies from 2^n to 2^(n+1)-1 microseconds.  The last bin also counts
+anything longer.
+
+The histograms cover the daemon's own callbacks, notifications, and
+scripts.  They do not include the network delay to this client.
+D*/
+
+/*F*/
+int batch_command(int pi, unsigned count, batchCmd_t *cmds, int *results);
+/*D
+Sends several commands to the daemon at once.  The daemon runs them
+in order and returns all their results together, so the commands
+cost one network round trip rather than one each.
+
+. .
+     pi: >=0 (as returned by [*pigpio_start*]).
+  count: the number of commands
+   cmds: an array of count commands
+results: an array to receive count results
+. .
+
+Returns the number of results if OK, otherwise PI_BAD_BATCH.
+
+Each command is given as the PI_CMD_... socket command number and its
+parameters, see pigpio.h.  A command which takes an extension, e.g.
+PI_CMD_HP, points ext at size bytes, otherwise size is 0.
+
+results[n] is set to what the function would have returned for
+cmds[n].  A command which returns data, e.g. PI_CMD_I2CRD, only
+returns its count.  The commands, with their extensions, must total
+less than 64K bytes.
+
+...
+batchCmd_t cmds[3]=
+{
+   {PI_CMD_WRITE, 4, 1, 0, NULL},
+   {PI_CMD_PWM, 18, 128, 0, NULL},
+   {PI_CMD_READ, 17, 0, 0, NULL},
+};
+int results[3];
+
+if (batch_command(pi, 3, cmds, results) == 3)
+   printf("GPIO 17 is %d\n", results[2]);
+...
+D*/
+
+/*F*/
+int async_command(int pi, batchCmd_t *cmd, void *rxBuf, unsigned rxCount);
+/*D
+Sends a command to the daemon and returns without waiting for its
+result.
+
+. .
+     pi: >=0 (as returned by [*pigpio_start*]).
+    cmd: the command, see [*batch_command*]
+  rxBuf: a buffer for any data the command returns, or NULL
+rxCount: the size of rxBuf
+. .
+
+Returns an id (>=0) for [*async_wait*] if OK, otherwise pigif_bad_async,
+pigif_bad_connect, pigif_bad_send, or pigif_async_full.
+
+The async commands of a Pi share a second connection to the daemon
+which is opened on first use.  A thread receives the results as
+they arrive, so any number of commands may be on the link at once and
+several threads may keep it busy.  The daemon runs the commands of
+the connection in the order they were sent.
+
+cmd and its extension may be reused as soon as the function returns.
+rxBuf must remain valid until the command has completed.
+
+Every id must be collected with [*async_wait*].  At most 256 commands
+may be in flight or waiting to be collected.  A further command waits
+for one in flight to complete, or returns pigif_async_full if all 256
+are results waiting for [*async_wait*].
+
+If the connection fails the commands outstanding complete with
+pigif_bad_recv and the next async command reconnects.  Results not
+yet collected may still be collected.
+
+PI_CMD_NOIB may not be sent this way.
+
+...
+batchCmd_t on = {PI_CMD_WRITE, 4, 1, 0, NULL};
+batchCmd_t rd = {PI_CMD_READ, 17, 0, 0, NULL};
+int id1, id2;
+
+id1 = async_command(pi, &on, NULL, 0);
+id2 = async_command(pi, &rd, NULL, 0);
+
+// do something else
+
+async_wait(pi, id1);
+printf("GPIO 17 is %d\n", async_wait(pi, id2));
+...
+D*/
+
+/*F*/
+int async_command_func(int pi, batchCmd_t *cmd, void *rxBuf, unsigned rxCount,
+   asyncFunc_t f, void *userdata);
+/*D
+As [*async_command*] but f is called with the result when the command
+completes.
+
+. .
+      pi: >=0 (as returned by [*pigpio_start*]).
+     cmd: the command, see [*batch_command*]
+   rxBuf: a buffer for any data the command returns, or NULL
+ rxCount: the size of rxBuf
+       f: the function to call, or NULL
+userdata: a pointer to arbitrary user data
+. .
+
+Returns an id (>=0) if OK, otherwise pigif_bad_async,
+pigif_bad_connect, pigif_bad_send, or pigif_async_full.
+
+f is called by the receive thread, in the order the commands were
+sent, and should return promptly.  The id is only for matching the
+call of f, it may not be passed to [*async_wait*].  f may issue
+async commands, but as it can't wait for the receive thread one
+which finds no free slot returns pigif_async_full, and one after
+the connection has failed returns pigif_bad_send.
+
+If f is NULL the result is discarded, which suits commands such as
+PI_CMD_WRITE whose result is not needed.  Either way the command's
+slot is freed as soon as it completes, so such commands need never
+be collected.
+D*/
+
+/*F*/
+int async_wait(int pi, int id);
+/*D
+Waits for an async command to complete.
+
+. .
+pi: >=0 (as returned by [*pigpio_start*]).
+id: >=0 (as returned by [*async_command*])
+. .
+
+Returns what the synchronous function would have returned for the
+command, or pigif_bad_async if id is not awaiting collection.
+
+A command returning data returns the number of bytes copied to its
+rxBuf.  If the connection fails, commands still outstanding return
+pigif_bad_recv.
+D*/
+
 /*F*/
 int set_watchdog(int pi, unsigned user_gpio, unsigned timeout);
 /*D
@@ -3276,6 +3577,11 @@ tick        32 bit   The number of microseconds since boot
                      WARNING: this wraps around from
                      4294967295 to 0 roughly every 72 minutes
 . .
+
+Callbacks for every Pi are called by one notification thread, which
+holds no lock while calling them.  A callback may call any function,
+including [*pigpio_stop*] and [*pigpio_start*].  Once [*pigpio_stop*]
+returns no further callbacks are made for that Pi.
 D*/
 
 /*F*/
@@ -3602,6 +3908,29 @@ Note that other than its id and its tick there is no data associated
 with an event.
 D*/
 
+/*F*/
+int event_set_pattern(
+   int pi, unsigned event, uint32_t mask, uint32_t pattern);
+/*D
+This function sets a level pattern which triggers an event.
+
+. .
+     pi: >=0 (as returned by [*pigpio_start*]).
+  event: 0-31.
+   mask: a bit mask of the GPIO in the pattern.
+pattern: the levels of the GPIO in mask.
+. .
+
+Returns 0 if OK, otherwise PI_BAD_EVENT_ID or PI_BAD_PATTERN.
+
+The event is triggered at each level change after which
+(level & mask) == pattern.  An [*event_callback*] is passed the tick
+of the level change which matched, a notification report of the
+event also carries its level.
+
+A mask of 0 removes the pattern.
+D*/
+
 /*PARAMS
 
 active :: 0-1000000
@@ -3631,10 +3960,19 @@ The count of bytes passed to a user customised function.
 A pointer to an array of bytes passed to a user customised function.
 Its meaning and content is defined by the customiser.
 
+asyncFunc_t::
+. .
+typedef void (*asyncFunc_t)
+   (int pi, int id, int res, void *userdata);
+. .
+
 baud::
 The speed of serial communication (I2C, SPI, serial link, waves) in
 bits per second.
 
+*bins::
+An array of PI_LATENCY_BINS latency counts.
+
 bit::
 A value of 0 or 1.
 
@@ -3672,6 +4010,23 @@ The size in bytes of a buffer.
 bVal::0-255 (Hex 0x0-0xFF, Octal 0-0377)
 An 8-bit byte value.
 
+*cmd::
+A [*batchCmd_t*] command.
+
+*cmds::
+An array of [*batchCmd_t*] commands.
+
+. .
+typedef struct
+{
+   unsigned cmd;  // PI_CMD_...
+   unsigned p1;
+   unsigned p2;
+   unsigned size; // bytes at ext
+   void    *ext;
+} batchCmd_t;
+. .
+
 callback_id::
 A value >=0, as returned by a call to a callback function, one of
 
@@ -3735,6 +4090,14 @@ FALLING_EDGE 1
 EITHER_EDGE. 2
 . .
 
+encoding::0-1
+The encoding of a notification stream.
+
+. .
+PI_NOTIFY_ENC_RAW   0
+PI_NOTIFY_ENC_DELTA 1
+. .
+
 errnum::
 A negative number indicating a function call failed and the nature
 of the error.
@@ -3839,6 +4202,9 @@ Flags which modify an I2C open command.  None are currently defined.
 i2c_reg:: 0-255
 A register of an I2C device.
 
+id::
+A value >=0, as returned by [*async_command*].
+
 *inBuf::
 A buffer used to pass data to a function.
 
@@ -3854,6 +4220,10 @@ A 32-bit signed value.
 invert::
 A flag used to set normal or inverted bit bang serial data level logic.
 
+latency:: 0, 100-1000000
+The most microseconds wanted between a level change and its
+notification report.  0 for no limit.
+
 level::
 The level of a GPIO.  Low or High.
 
@@ -3875,6 +4245,10 @@ reported as PI_TIMEOUT.  See [*set_watchdog*].
 PI_TIMEOUT 2
 . .
 
+mask::
+A value used to select GPIO.  If bit n of mask is set then GPIO n is
+selected.
+
 MISO::
 The GPIO used for the MISO signal when bit banging SPI.
 
@@ -3956,6 +4330,10 @@ high and low levels.
 *param::
 An array of script parameters.
 
+pattern::
+The levels of the GPIO selected by mask.  If bit n of mask is set
+then bit n of pattern is the level of GPIO n.
+
 pi::
 An integer defining a connected Pi.  The value is returned by
 [*pigpio_start*] upon success.
@@ -4018,6 +4396,13 @@ PI_MIN_DUTYCYCLE_RANGE 25
 PI_MAX_DUTYCYCLE_RANGE 40000
 . .
 
+reports::64-1048576
+The number of reports in a shared memory notification ring, a power
+of 2.
+
+reset::
+A flag, 0 or 1.  If set the values are cleared after being read.
+
 *retBuf::
 A buffer to hold a number of bytes returned to a used customised function,
 
@@ -4028,6 +4413,9 @@ The maximum number of bytes a user customised function should return.
 *rxBuf::
 A pointer to a buffer to receive data.
 
+rxCount::
+The number of bytes rxBuf can hold.
+
 SCL::
 The user GPIO to use for the clock when bit banging I2C.
 
@@ -4113,6 +4501,15 @@ PI_MAX_WDOG_TIMEOUT 60000
 *txBuf::
 An array of bytes to transmit.
 
+type::
+The latency histogram to get.
+
+. .
+PI_LATENCY_ALERT  0
+PI_LATENCY_NOTIFY 1
+PI_LATENCY_SCRIPT 2
+. .
+
 uint32_t::0-0-4,294,967,295 (Hex 0x0-0xFFFFFFFF)
 A 32-bit unsigned value.
 
@@ -4192,6 +4589,8 @@ typedef enum
    pigif_callback_not_found = -2010,
    pigif_unconnected_pi     = -2011,
    pigif_too_many_pis       = -2012,
+   pigif_bad_async          = -2013,
+   pigif_async_full         = -2014,
 } pigifError_t;
 
 /*DEF_E*/
@@ -36,6 +36,7 @@ This version is for pigpio version 56+
 #include <ctype.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <sys/types.h>
 #include <netdb.h>
 #include <arpa/inet.h>
@@ -100,6 +101,7 @@ static int openSocket(void)
 {
    int sock, err;
    struct addrinfo hints, *res, *rp;
+   struct sockaddr_un local;
    const char *addrStr, *portStr;
 
    portStr = getenv(PI_ENVPORT);
@@ -110,6 +112,29 @@ static int openSocket(void)
 
    if (!addrStr) addrStr = PI_DEFAULT_SOCKET_ADDR_STR;
 
+   /* an address starting with / is the daemon's local socket */
+
+   if (addrStr[0] == '/')
+   {
+      if (strlen(addrStr) >= sizeof(local.sun_path)) return SOCKET_OPEN_FAILED;
+
+      memset(&local, 0, sizeof(local));
+      local.sun_family = AF_UNIX;
+      strcpy(local.sun_path, addrStr);
+
+      sock = socket(AF_UNIX, SOCK_STREAM, 0);
+
+      if (sock == -1) return SOCKET_OPEN_FAILED;
+
+      if (connect(sock, (struct sockaddr *)&local, sizeof(local)) == -1)
+      {
+         close(sock);
+         return SOCKET_OPEN_FAILED;
+      }
+
+      return sock;
+   }
+
    memset (&hints, 0, sizeof (hints));
 
    hints.ai_family   = PF_UNSPEC;
@@ -251,7 +276,66 @@ void print_result(int sock, int rv, cmdCmd_t cmd)
          printf("\n");
          break;
 
+      case 9: /* LH */
+         printf("%d", r);
+         if (r < 0) fatal("ERROR: %s", cmdErrStr(r));
+         p = (uint32_t *)response_buf;
+         for (i=0; i<r/4; i++) printf(" %u", p[i]);
+         printf("\n");
+         break;
+
+      case 10: /* BATCH */
+         if (r < 0)
+         {
+            printf("%d\n", r);
+            fatal("ERROR: %s", cmdErrStr(r));
+         }
+         p = (uint32_t *)response_buf;
+         for (i=0; i<r/4; i++) printf("%s%d", i ? " " : "", (int)p[i]);
+         printf("\n");
+         break;
+
+   }
+}
+
+static unsigned batchParse(cmdCtlParse_t *ctl, int len, char *ext)
+{
+   static char v[CMD_MAX_EXTENSION];
+   uint32_t p[CMD_P_ARR];
+   unsigned size;
+   int idx;
+
+   /* the rest of the command line is sent as one batch, each
+      command as its header followed by its extension */
+
+   size = 0;
+
+   while (ctl->eaten < len)
+   {
+      idx = cmdParse(command_buf, p, CMD_MAX_EXTENSION, v, ctl);
+
+      if (idx < 0)
+      {
+         if (idx == CMD_UNKNOWN_CMD)
+            fatal("%s? unknown command, pigs h for help", cmdStr());
+         else
+            fatal("%s: bad parameter, pigs h for help", cmdStr());
+      }
+
+      if ((p[0] >= PI_CMD_SCRIPT) || (p[0] == PI_CMD_HELP) ||
+          (p[0] == PI_CMD_PARSE)  || (p[0] == PI_CMD_BATCH))
+         fatal("%s not allowed in a batch", cmdInfo[idx].name);
+
+      if ((size + 16 + p[3]) >= CMD_MAX_EXTENSION)
+         fatal("batch too long, at most %d bytes", CMD_MAX_EXTENSION-1);
+
+      memcpy(ext+size, p, 16);
+      memcpy(ext+size+16, v, p[3]);
+
+      size += 16 + p[3];
    }
+
+   return size;
 }
 
 void get_extensions(int sock, int command, int res)
@@ -269,11 +353,13 @@ void get_extensions(int sock, int command, int res)
       case PI_CMD_I2CRI:
       case PI_CMD_I2CRK:
       case PI_CMD_I2CZ:
+      case PI_CMD_LH:
       case PI_CMD_PROCP:
       case PI_CMD_SERR:
       case PI_CMD_SLR:
       case PI_CMD_SPIX:
       case PI_CMD_SPIR:
+      case PI_CMD_BATCH:
 
          if (res > 0)
          {
@@ -335,6 +421,8 @@ int main(int argc , char *argv[])
             }
             else
             {
+               if (command == PI_CMD_BATCH) p[3] = batchParse(&ctl, len, v);
+
                cmd.cmd = command;
                cmd.p1 = p[1];
                cmd.p2 = p[2];
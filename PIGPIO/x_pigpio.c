@@ -22,6 +22,7 @@ sudo ./x_pigpio
 #include <unistd.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 
 #include "pigpio.h"
 
@@ -89,6 +90,12 @@ void t2cb(int gpio, int level, uint32_t tick)
    t2_count++;
 }
 
+void t2cbb(int gpio, int count,
+   const uint32_t *tick, const uint8_t *level, void *userdata)
+{
+   t2_count += count;
+}
+
 void t2()
 {
    int dc, f, r, rr, oc;
@@ -154,6 +161,17 @@ void t2()
    rr = gpioGetPWMrealRange(GPIO);
    CHECK(2, 13, rr, 200, 0, "get PWM real range");
 
+   gpioPWM(GPIO, 1000);
+   gpioSetAlertBatchFunc(GPIO, t2cbb, NULL);
+
+   time_sleep(0.5);
+   oc = t2_count;
+   time_sleep(2);
+   f = t2_count - oc;
+   CHECK(2, 14, f, 4000, 1, "batch callback");
+
+   gpioSetAlertFunc(GPIO, NULL);
+
    gpioPWM(GPIO, 0);
 }
 
@@ -852,6 +870,149 @@ void tc()
    CHECK(12, 99, e, 0, 0, "spiClose");
 }
 
+void td()
+{
+   int s, e;
+   uint32_t p[10];
+   double start, secs;
+
+   /*
+   bit-bang with no delays, 6 instructions per loop, tags are not executed
+   p0 number of loops
+   p1 GPIO
+   */
+   char *script="\
+   ld p9 p0\
+   tag 0\
+   w p1 1\
+   w p1 0\
+   r p1\
+   jz 1\
+   tag 1\
+   dcr p9\
+   jp 0";
+
+   printf("Script speed tests.\n");
+
+   s = gpioStoreScript(script);
+
+   while (1)
+   {
+      /* loop until script initialised */
+      time_sleep(0.1);
+      e = gpioScriptStatus(s, p);
+      if (e != PI_SCRIPT_INITING) break;
+   }
+
+   p[0] = 200000;
+   p[1] = GPIO;
+
+   start = time_time();
+
+   gpioRunScript(s, 2, p);
+
+   while (1)
+   {
+      e = gpioScriptStatus(s, p);
+      if (e != PI_SCRIPT_RUNNING) break;
+      time_sleep(0.01);
+   }
+
+   secs = time_time() - start;
+
+   CHECK(13, 1, p[9], -1, 0, "run script");
+
+   printf("%.0f script instructions per second\n", (200000 * 6) / secs);
+
+   e = gpioDeleteScript(s);
+   CHECK(13, 2, e, 0, 0, "delete script");
+
+   /* a register given as a bare number is that variable, e.g. 5 is v5 */
+
+   script="\
+   ld 5 10 inr 5 dcr 5 dcr 5\
+   lda 100 sta 3 push 3 pop 4\
+   ld 6 1 rl 6 4 rr 6 2 x 5 6\
+   lda 7 xa 4\
+   ld p0 v5 ld p1 v6 ld p2 v4 ld p3 v3 sta p4";
+
+   s = gpioStoreScript(script);
+
+   while (1)
+   {
+      /* loop until script initialised */
+      time_sleep(0.1);
+      e = gpioScriptStatus(s, p);
+      if (e != PI_SCRIPT_INITING) break;
+   }
+
+   gpioRunScript(s, 0, p);
+
+   while (1)
+   {
+      e = gpioScriptStatus(s, p);
+      if (e != PI_SCRIPT_RUNNING) break;
+      time_sleep(0.01);
+   }
+
+   CHECK(13, 3, ((p[0] == 4) && (p[1] == 9) && (p[2] == 7) &&
+                 (p[3] == 100) && (p[4] == 100)), 1, 0, "script registers");
+
+   e = gpioDeleteScript(s);
+   CHECK(13, 4, e, 0, 0, "delete script");
+}
+
+void tecbf(int gpio, int level, uint32_t tick)
+{
+}
+
+void te()
+{
+   int g, i, n;
+   int filtered[3]={1, 8, 32};
+   double samples, base, cpu;
+   clock_t start;
+
+   /*
+   process CPU time for 2 seconds of samples with the noise filter
+   on 1, 8, and 32 GPIO, less the time with it off
+   */
+
+   printf("Noise filter speed tests.\n");
+
+   gpioPWM(GPIO, 128); /* level changes to filter */
+
+   for (g=0; g<=PI_MAX_USER_GPIO; g++) gpioSetAlertFunc(g, tecbf);
+
+   samples = 2.0 * 1E6 / PI_DEFAULT_CLK_MICROS;
+
+   start = clock();
+   time_sleep(2.0);
+   base = clock() - start;
+
+   for (i=0; i<3; i++)
+   {
+      n = filtered[i];
+
+      /* GPIO first so every run filters the GPIO which changes */
+
+      for (g=0; g<n; g++) gpioNoiseFilter((GPIO+g)%32, 50, 500);
+
+      start = clock();
+      time_sleep(2.0);
+      cpu = clock() - start;
+
+      printf("%2d GPIO %.1f ns per sample\n", n,
+         ((cpu - base) * 1E9 / CLOCKS_PER_SEC) / samples);
+
+      for (g=0; g<n; g++) gpioNoiseFilter((GPIO+g)%32, 0, 0);
+   }
+
+   for (g=0; g<=PI_MAX_USER_GPIO; g++) gpioSetAlertFunc(g, NULL);
+
+   gpioPWM(GPIO, 0);
+}
+
 int main(int argc, char *argv[])
 {
    int i, t, c, status;
@@ -896,6 +1057,8 @@ int main(int argc, char *argv[])
    if (strchr(test, 'a')) ta();
    if (strchr(test, 'b')) tb();
    if (strchr(test, 'c')) tc();
+   if (strchr(test, 'd')) td();
+   if (strchr(test, 'e')) te();
 
    gpioTerminate();
 
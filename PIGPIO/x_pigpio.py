@@ -12,6 +12,7 @@
 #************************************************************
 
 import sys
+import os
 import time
 import struct
 
@@ -966,6 +967,267 @@ def td():
 
    tdcb.cancel()
 
+def te():
+
+   print("Notification option tests.")
+
+   pi.set_PWM_frequency(GPIO, 0)
+   pi.set_PWM_dutycycle(GPIO, 0)
+   pi.set_PWM_range(GPIO, 100)
+
+   # shared memory ring, header is magic, size, head
+
+   h = pi.notify_open_shm(64)
+   CHECK(14, 1, h>=0, 1, 0, "notify open shm")
+
+   try:
+      f = open("/dev/shm/pigpio"+ str(h), "rb")
+   except IOError:
+      f = None
+
+   e = 0
+   if f is not None:
+      magic, size, head = struct.unpack('III', f.read(12))
+      if magic == 0x4D485350 and size == 64:
+         e = 1
+   CHECK(14, 2, e, 1, 0, "shm ring header")
+
+   e = pi.notify_begin(h, (1<<GPIO))
+   CHECK(14, 3, e, 0, 0, "notify begin")
+
+   pi.set_PWM_dutycycle(GPIO, 50)
+   time.sleep(2)
+   pi.set_PWM_dutycycle(GPIO, 0)
+
+   pi.notify_pause(h)
+
+   head = 0
+   if f is not None:
+      f.seek(0)
+      magic, size, head = struct.unpack('III', f.read(12))
+      f.close()
+   CHECK(14, 4, head, 40, 10, "shm ring reports")
+
+   e = pi.notify_close(h)
+   CHECK(14, 5, e, 0, 0, "notify close")
+
+   # delta encoded pipe, starts with a keyframe and is smaller than
+   # the 12 bytes per report of the raw encoding
+
+   h = pi.notify_open()
+
+   try:
+      f = open("/dev/pigpio"+ str(h), "rb")
+   except IOError:
+      f = None
+
+   pigpio.exceptions = False
+   e = pi.notify_encoding(h, 2)
+   pigpio.exceptions = True
+   CHECK(14, 6, e, pigpio.PI_BAD_PARAM, 0, "notify encoding bad")
+
+   e = pi.notify_encoding(h, pigpio.NOTIFY_ENC_DELTA)
+   CHECK(14, 7, e, 0, 0, "notify encoding delta")
+
+   pi.notify_begin(h, (1<<GPIO))
+
+   pi.set_PWM_dutycycle(GPIO, 50)
+   time.sleep(2)
+   pi.set_PWM_dutycycle(GPIO, 0)
+
+   pi.notify_close(h)
+
+   data = b""
+   if f is not None:
+      data = f.read()
+      f.close()
+
+   CHECK(14, 8, len(data) > 0 and (bytearray(data)[0] & 0x80) != 0, 1, 0,
+      "delta keyframe")
+
+   CHECK(14, 9, 13 < len(data) < (40 * 12 // 2), 1, 0,
+      "delta smaller than raw")
+
+   # rising edges only, then a glitch filter longer than the pulses
+
+   h = pi.notify_open()
+
+   try:
+      f = os.open("/dev/pigpio"+ str(h), os.O_RDONLY|os.O_NONBLOCK)
+   except OSError:
+      f = None
+
+   pigpio.exceptions = False
+   e = pi.notify_edges(h, (1<<GPIO), 3)
+   pigpio.exceptions = True
+   CHECK(14, 10, e, pigpio._PI_BAD_EDGE, 0, "notify edges bad")
+
+   e = pi.notify_edges(h, (1<<GPIO), pigpio.RISING_EDGE)
+   CHECK(14, 11, e, 0, 0, "notify edges rising")
+
+   pi.notify_begin(h, (1<<GPIO))
+
+   pi.set_PWM_dutycycle(GPIO, 50)
+   time.sleep(2)
+   pi.set_PWM_dutycycle(GPIO, 0)
+
+   pi.notify_pause(h)
+   time.sleep(0.1)
+
+   n = 0
+   if f is not None:
+      try:
+         n = len(os.read(f, 1024))
+      except OSError:
+         pass
+   CHECK(14, 12, n // 12, 20, 50, "notify edges reports")
+
+   pigpio.exceptions = False
+   e = pi.notify_glitch(h, 300001)
+   pigpio.exceptions = True
+   CHECK(14, 13, e, pigpio.PI_BAD_FILTER, 0, "notify glitch bad")
+
+   e = pi.notify_glitch(h, 100000)
+   CHECK(14, 14, e, 0, 0, "notify glitch")
+
+   pi.notify_begin(h, (1<<GPIO))
+
+   pi.set_PWM_dutycycle(GPIO, 50)
+   time.sleep(2)
+   pi.set_PWM_dutycycle(GPIO, 0)
+
+   pi.notify_pause(h)
+   time.sleep(0.1)
+
+   n = 0
+   if f is not None:
+      try:
+         n = len(os.read(f, 1024))
+      except OSError:
+         pass
+      os.close(f)
+   CHECK(14, 15, n // 12 < 3, 1, 0, "notify glitch reports")
+
+   pi.notify_close(h)
+
+   # a level pattern event fires each time GPIO goes high
+
+   pigpio.exceptions = False
+   e = pi.event_set_pattern(2, 0, (1<<GPIO))
+   pigpio.exceptions = True
+   CHECK(14, 16, e, pigpio.PI_BAD_PATTERN, 0, "event set pattern bad")
+
+   cb = pi.event_callback(2)
+
+   e = pi.event_set_pattern(2, (1<<GPIO), (1<<GPIO))
+   CHECK(14, 17, e, 0, 0, "event set pattern")
+
+   cb.reset_tally()
+
+   pi.set_PWM_dutycycle(GPIO, 50)
+   time.sleep(2)
+   pi.set_PWM_dutycycle(GPIO, 0)
+
+   time.sleep(0.1)
+   CHECK(14, 18, cb.tally(), 20, 50, "event pattern matches")
+
+   e = pi.event_set_pattern(2, 0, 0)
+   CHECK(14, 19, e, 0, 0, "event clear pattern")
+
+   cb.cancel()
+
+   # a change is reported well within the latency asked for
+
+   h = pi.notify_open()
+
+   try:
+      f = os.open("/dev/pigpio"+ str(h), os.O_RDONLY|os.O_NONBLOCK)
+   except OSError:
+      f = None
+
+   pigpio.exceptions = False
+   e = pi.notify_latency(h, 50)
+   pigpio.exceptions = True
+   CHECK(14, 20, e, pigpio.PI_BAD_LATENCY, 0, "notify latency bad")
+
+   e = pi.notify_latency(h, 1000)
+   CHECK(14, 21, e, 0, 0, "notify latency")
+
+   pi.notify_begin(h, (1<<GPIO))
+
+   pi.write(GPIO, 1)
+   time.sleep(0.05)
+   pi.write(GPIO, 0)
+
+   n = 0
+   if f is not None:
+      try:
+         n = len(os.read(f, 1024))
+      except OSError:
+         pass
+      os.close(f)
+   CHECK(14, 22, n >= 12, 1, 0, "notify latency report")
+
+   pi.notify_close(h)
+
+   # the notify histogram counts each report once it is written
+
+   try:
+      pi.get_latency(3)
+      e = 0
+   except pigpio.error as err:
+      e = err.value == pigpio.error_text(pigpio.PI_BAD_LATENCY_TYPE)
+   CHECK(14, 23, e, 1, 0, "get latency bad")
+
+   bins = pi.get_latency(pigpio.LATENCY_NOTIFY, 1)
+   CHECK(14, 24, len(bins), 24, 0, "get latency reset")
+
+   h = pi.notify_open()
+
+   try:
+      f = open("/dev/pigpio"+ str(h), "rb")
+   except IOError:
+      f = None
+
+   pi.notify_begin(h, (1<<GPIO))
+
+   pi.set_PWM_dutycycle(GPIO, 50)
+   time.sleep(2)
+   pi.set_PWM_dutycycle(GPIO, 0)
+
+   pi.notify_close(h)
+
+   if f is not None:
+      f.read()
+      f.close()
+
+   bins = pi.get_latency(pigpio.LATENCY_NOTIFY)
+   CHECK(14, 25, sum(bins), 40, 10, "get latency notify")
+
+   # several commands in one round trip, results in order
+
+   b = pigpio.batch()
+   b.write(GPIO, 1).read(GPIO).write(GPIO, 0).read(GPIO)
+
+   r = pi.batch_command(b)
+   CHECK(14, 26, len(r), 4, 0, "batch command")
+
+   CHECK(14, 27, r == [0, 1, 0, 0], 1, 0, "batch results")
+
+   b = pigpio.batch()
+   for i in range(4096):
+      b.read(GPIO)
+
+   try:
+      pi.batch_command(b)
+      e = 0
+   except pigpio.error:
+      e = 1
+   CHECK(14, 28, e, 1, 0, "batch too long")
+
+   v = pi.read(GPIO)
+   CHECK(14, 29, v, 0, 0, "batch too long, link ok")
+
 if len(sys.argv) > 1:
    tests = ""
    for C in sys.argv[1]:
@@ -974,7 +1236,7 @@ if len(sys.argv) > 1:
          tests += c
 
 else:
-   tests = "0123456789d"
+   tests = "0123456789de"
 
 pi = pigpio.pi()
 
@@ -995,6 +1257,7 @@ if pi.connected:
    if 'b' in tests: tb()
    if 'c' in tests: tc()
    if 'd' in tests: td()
+   if 'e' in tests: te()
 
 pi.stop()
 
@@ -832,6 +832,309 @@ void tc(int pi)
    CHECK(12, 99, e, 0, 0, "spi close");
 }
 
+int td_count=0;
+
+void tdcbf(int pi, unsigned event, uint32_t tick)
+{
+   td_count++;
+}
+
+int td_async_count=0, td_async_res=-1;
+
+void tdasyncf(int pi, int id, int res, void *userdata)
+{
+   td_async_count++;
+   td_async_res = res;
+}
+
+void td(int pi)
+{
+   int h, e, f, n, b, id, res[4];
+   uint32_t hdr[3], bins[PI_LATENCY_BINS];
+   batchCmd_t cmds[4]=
+   {
+      {PI_CMD_WRITE, GPIO, 1, 0, NULL},
+      {PI_CMD_READ,  GPIO, 0, 0, NULL},
+      {PI_CMD_WRITE, GPIO, 0, 0, NULL},
+      {PI_CMD_READ,  GPIO, 0, 0, NULL},
+   };
+   char p[32];
+   unsigned char buf[1024];
+
+   printf("Notification option tests.\n");
+
+   set_PWM_frequency(pi, GPIO, 0);
+   set_PWM_dutycycle(pi, GPIO, 0);
+   set_PWM_range(pi, GPIO, 100);
+
+   /* shared memory ring, header is magic, size, head */
+
+   h = notify_open_shm(pi, 64);
+   CHECK(13, 1, (h >= 0), 1, 0, "notify open shm");
+
+   sprintf(p, "/dev/shm/pigpio%d", h);
+   f = open(p, O_RDONLY);
+
+   e = 0;
+   if ((f >= 0) && (read(f, hdr, 12) == 12))
+   {
+      if ((hdr[0] == PI_NOTIFY_SHM_MAGIC) && (hdr[1] == 64)) e = 1;
+   }
+   CHECK(13, 2, e, 1, 0, "shm ring header");
+
+   e = notify_begin(pi, h, (1<<GPIO));
+   CHECK(13, 3, e, 0, 0, "notify begin");
+
+   set_PWM_dutycycle(pi, GPIO, 50);
+   time_sleep(2);
+   set_PWM_dutycycle(pi, GPIO, 0);
+
+   notify_pause(pi, h);
+
+   hdr[2] = 0;
+   if (f >= 0)
+   {
+      lseek(f, 0, SEEK_SET);
+      if (read(f, hdr, 12) != 12) hdr[2] = 0;
+      close(f);
+   }
+   CHECK(13, 4, hdr[2], 40, 10, "shm ring reports");
+
+   e = notify_close(pi, h);
+   CHECK(13, 5, e, 0, 0, "notify close");
+
+   /* delta encoded pipe, starts with a keyframe and is smaller than
+      the 12 bytes per report of the raw encoding */
+
+   h = notify_open(pi);
+
+   sprintf(p, "/dev/pigpio%d", h);
+   f = open(p, O_RDONLY);
+
+   e = notify_encoding(pi, h, 2);
+   CHECK(13, 6, e, PI_BAD_PARAM, 0, "notify encoding bad");
+
+   e = notify_encoding(pi, h, PI_NOTIFY_ENC_DELTA);
+   CHECK(13, 7, e, 0, 0, "notify encoding delta");
+
+   notify_begin(pi, h, (1<<GPIO));
+
+   set_PWM_dutycycle(pi, GPIO, 50);
+   time_sleep(2);
+   set_PWM_dutycycle(pi, GPIO, 0);
+
+   notify_close(pi, h);
+
+   n = 0;
+   if (f >= 0)
+   {
+      while ((b = read(f, buf+n, sizeof(buf)-n)) > 0) n += b;
+      close(f);
+   }
+
+   CHECK(13, 8, ((n > 0) && (buf[0] & PI_NTFY_DELTA_KEY)), 1, 0,
+      "delta keyframe");
+
+   CHECK(13, 9, ((n > 13) && (n < (40 * 12 / 2))), 1, 0,
+      "delta smaller than raw");
+
+   /* rising edges only, then a glitch filter longer than the pulses */
+
+   h = notify_open(pi);
+
+   sprintf(p, "/dev/pigpio%d", h);
+   f = open(p, O_RDONLY);
+
+   e = notify_edges(pi, h, (1<<GPIO), 3);
+   CHECK(13, 10, e, PI_BAD_EDGE, 0, "notify edges bad");
+
+   e = notify_edges(pi, h, (1<<GPIO), RISING_EDGE);
+   CHECK(13, 11, e, 0, 0, "notify edges rising");
+
+   notify_begin(pi, h, (1<<GPIO));
+
+   set_PWM_dutycycle(pi, GPIO, 50);
+   time_sleep(2);
+   set_PWM_dutycycle(pi, GPIO, 0);
+
+   notify_pause(pi, h);
+   time_sleep(0.1);
+
+   n = 0;
+   if (f >= 0)
+   {
+      fcntl(f, F_SETFL, O_NONBLOCK);
+      while ((b = read(f, buf+n, sizeof(buf)-n)) > 0) n += b;
+      fcntl(f, F_SETFL, 0);
+   }
+   CHECK(13, 12, n/12, 20, 50, "notify edges reports");
+
+   e = notify_glitch(pi, h, PI_MAX_STEADY+1);
+   CHECK(13, 13, e, PI_BAD_FILTER, 0, "notify glitch bad");
+
+   e = notify_glitch(pi, h, 100000);
+   CHECK(13, 14, e, 0, 0, "notify glitch");
+
+   notify_begin(pi, h, (1<<GPIO));
+
+   set_PWM_dutycycle(pi, GPIO, 50);
+   time_sleep(2);
+   set_PWM_dutycycle(pi, GPIO, 0);
+
+   notify_close(pi, h);
+
+   n = 0;
+   if (f >= 0)
+   {
+      while ((b = read(f, buf+n, sizeof(buf)-n)) > 0) n += b;
+      close(f);
+   }
+   CHECK(13, 15, (n/12 < 3), 1, 0, "notify glitch reports");
+
+   /* a level pattern event fires each time GPIO goes high */
+
+   e = event_set_pattern(pi, 2, 0, (1<<GPIO));
+   CHECK(13, 16, e, PI_BAD_PATTERN, 0, "event set pattern bad");
+
+   id = event_callback(pi, 2, tdcbf);
+
+   e = event_set_pattern(pi, 2, (1<<GPIO), (1<<GPIO));
+   CHECK(13, 17, e, 0, 0, "event set pattern");
+
+   td_count = 0;
+
+   set_PWM_dutycycle(pi, GPIO, 50);
+   time_sleep(2);
+   set_PWM_dutycycle(pi, GPIO, 0);
+
+   time_sleep(0.1);
+   CHECK(13, 18, td_count, 20, 50, "event pattern matches");
+
+   e = event_set_pattern(pi, 2, 0, 0);
+   CHECK(13, 19, e, 0, 0, "event clear pattern");
+
+   event_callback_cancel(id);
+
+   /* a change is reported well within the latency asked for */
+
+   h = notify_open(pi);
+
+   sprintf(p, "/dev/pigpio%d", h);
+   f = open(p, O_RDONLY|O_NONBLOCK);
+
+   e = notify_latency(pi, h, 50);
+   CHECK(13, 20, e, PI_BAD_LATENCY, 0, "notify latency bad");
+
+   e = notify_latency(pi, h, 1000);
+   CHECK(13, 21, e, 0, 0, "notify latency");
+
+   notify_begin(pi, h, (1<<GPIO));
+
+   gpio_write(pi, GPIO, 1);
+   time_sleep(0.05);
+   gpio_write(pi, GPIO, 0);
+
+   n = 0;
+   if (f >= 0)
+   {
+      while ((b = read(f, buf+n, sizeof(buf)-n)) > 0) n += b;
+      close(f);
+   }
+   CHECK(13, 22, (n >= 12), 1, 0, "notify latency report");
+
+   notify_close(pi, h);
+
+   /* the notify histogram counts each report once it is written */
+
+   e = get_latency(pi, 3, 0, bins);
+   CHECK(13, 23, e, PI_BAD_LATENCY_TYPE, 0, "get latency bad");
+
+   e = get_latency(pi, PI_LATENCY_NOTIFY, 1, bins);
+   CHECK(13, 24, e, PI_LATENCY_BINS, 0, "get latency reset");
+
+   h = notify_open(pi);
+
+   sprintf(p, "/dev/pigpio%d", h);
+   f = open(p, O_RDONLY);
+
+   notify_begin(pi, h, (1<<GPIO));
+
+   set_PWM_dutycycle(pi, GPIO, 50);
+   time_sleep(2);
+   set_PWM_dutycycle(pi, GPIO, 0);
+
+   notify_close(pi, h);
+
+   if (f >= 0)
+   {
+      while (read(f, buf, sizeof(buf)) > 0);
+      close(f);
+   }
+
+   get_latency(pi, PI_LATENCY_NOTIFY, 0, bins);
+
+   n = 0;
+   for (b=0; b<PI_LATENCY_BINS; b++) n += bins[b];
+   CHECK(13, 25, n, 40, 10, "get latency notify");
+
+   /* several commands in one round trip, results in order */
+
+   e = batch_command(pi, 4, cmds, res);
+   CHECK(13, 26, e, 4, 0, "batch command");
+
+   CHECK(13, 27, ((res[0] == 0) && (res[1] == 1) &&
+                  (res[2] == 0) && (res[3] == 0)), 1, 0, "batch results");
+
+   cmds[1].cmd = PI_CMD_BATCH;
+
+   e = batch_command(pi, 4, cmds, res);
+   CHECK(13, 28, e, PI_BAD_BATCH, 0, "batch nested");
+
+   cmds[1].cmd  = PI_CMD_READ;
+   cmds[1].size = 65536;
+   cmds[1].ext  = buf;
+
+   e = batch_command(pi, 4, cmds, res);
+   CHECK(13, 29, e, PI_BAD_BATCH, 0, "batch too long");
+
+   /* async commands, collected or with a function */
+
+   cmds[1].size = 0;
+   cmds[1].ext  = NULL;
+
+   id = async_command(pi, &cmds[0], NULL, 0);
+   e = async_wait(pi, id);
+   CHECK(13, 30, e, 0, 0, "async command/wait");
+
+   id = async_command(pi, &cmds[1], NULL, 0);
+   e = async_wait(pi, id);
+   CHECK(13, 31, e, 1, 0, "async read");
+
+   e = async_wait(pi, id);
+   CHECK(13, 32, e, pigif_bad_async, 0, "async wait twice");
+
+   id = async_command_func(pi, &cmds[3], NULL, 0, tdasyncf, NULL);
+   time_sleep(0.2);
+   CHECK(13, 33, ((td_async_count == 1) && (td_async_res == 1)), 1, 0,
+      "async function");
+
+   e = async_wait(pi, id);
+   CHECK(13, 34, e, pigif_bad_async, 0, "async wait function id");
+
+   /* discarded results free their slots, more than a window full */
+
+   n = 0;
+   for (b=0; b<300; b++)
+   {
+      if (async_command_func(pi, &cmds[b&1], NULL, 0, NULL, NULL) >= 0) n++;
+   }
+   CHECK(13, 35, n, 300, 0, "async discard");
+
+   id = async_command(pi, &cmds[3], NULL, 0);
+   e = async_wait(pi, id);
+   CHECK(13, 36, e, 1, 0, "async after discard");
+}
+
 
 int main(int argc, char *argv[])
 {
@@ -854,7 +1157,7 @@ int main(int argc, char *argv[])
          }
       }
    }
-   else strcat(test, "0123456789");
+   else strcat(test, "0123456789d");
 
    pi = pigpio_start(0, 0);
 
@@ -879,6 +1182,7 @@ int main(int argc, char *argv[])
    if (strchr(test, 'a')) ta(pi);
    if (strchr(test, 'b')) tb(pi);
    if (strchr(test, 'c')) tc(pi);
+   if (strchr(test, 'd')) td(pi);
 
    pigpio_stop(pi);
 
@@ -2,6 +2,12 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <stdint.h>
+
+#include <sys/mman.h>
 
 #include <pigpio.h>
 #include <sys/time.h>
@@ -35,9 +41,52 @@ sudo ./freq_count_1  4 7 8 9 10 23 24 -r2
 Monitor gpios 4, 7, 8, and 9, report once a second, sample rate 1us,
 generate 2us edges (4us square wave, 250000 highs per second).
 sudo ./freq_count_1  4 7 8 9 -r 10 -s 1 -p 2
+
+CONFIGURATION
+
+With -c the segment map and display list are read from a file.
+Send SIGHUP to re-read it without restarting; the decode tables are
+rebuilt off the alert thread and swapped in atomically.  Displays
+whose digit lines and segment map did not change keep their state.
+
+# segment lines, DP g f e d c b a
+segments 17 27 22 5 6 13 19 26
+# digit strobe lines, most significant digit first
+display 21 20 16
+display 25 24 23
+
+Alphanumeric displays are declared with a 14- or 16-segment map:
+
+segments14 DP a b c d e f g1 g2 h j k l m n
+segments16 DP a1 a2 b c d1 d2 e f g1 g2 h j k l m n
+
+where h j k are the upper diagonals/vertical left to right and l m n
+the lower ones.  Each display line uses the segment map declared last
+before it.  Alphanumeric displays decode the printable ASCII set and
+report "text" alongside "val" (null unless the text is a number).
+
+WARM RESTART
+
+With -m the per-display state (last confirmed value, repeat count,
+strobe period and a tick-to-wall mapping) is checkpointed to a small
+memory-mapped file on every refresh.  On start a recent checkpoint is
+restored and the first fresh frame that matches the checkpointed value
+confirms it, instead of waiting for the usual run of matching frames.
 */
 
 #define MAX_GPIOS 32
+#define MAX_DISPLAYS 8
+#define MAX_DIGITS 8
+#define MAX_SEGMENTS 16 // segment lines per digit, DP not included
+#define MAX_TEXT (MAX_DIGITS*2+1) // a glyph and a '.' per digit
+
+#define SEG_7  7
+#define SEG_14 14
+#define SEG_16 16
+
+#define SNAP_MAGIC   0x52445353 // "SSDR"
+#define SNAP_VERSION 2
+#define SNAP_MAX_AGE 30 // seconds, older checkpoints are ignored
 
 #define OPT_P_MIN 1
 #define OPT_P_MAX 1000
@@ -60,16 +109,32 @@ static int g_digits[MAX_GPIOS];
 // a b c d e f g DP
 //static int g_segments[] = {26, 19, 13, 6, 5, 22, 27, 17};
 // DP g f e d c b a
-static int g_segments[] =   {17, 27, 22, 5, 6, 13, 19, 26}; //TODO: make this configurable
+static int g_segments[] =   {17, 27, 22, 5, 6, 13, 19, 26}; // default, see -c
 static int seg_patterns[10]; // 0 1 2 3 4 5 6 7 8 9
-static int seg_bitpattern_digit_mask;
-static int seg_bitpattern_fp_mask;
-static int digit_bitpatterns[10]; // 0 1 2 3 4 5 6 7 8 9
+
+// Printable ASCII from ' ' in the 14-segment order a b c d e f g1 g2 h j k l m n
+// (bit 0 = a). 16-segment glyphs are derived by splitting a and d.
+static const uint16_t font14[95] = {
+  0x0000, 0x0006, 0x0220, 0x12CE, 0x12ED, 0x0C24, 0x235D, 0x0400, // ' ' '!' '"' '#' '$' '%' '&' '''
+  0x2400, 0x0900, 0x3FC0, 0x12C0, 0x0800, 0x00C0, 0x0000, 0x0C00, // '(' ')' '*' '+' ',' '-' '.' '/'
+  0x0C3F, 0x0006, 0x00DB, 0x008F, 0x00E6, 0x2069, 0x00FD, 0x0007, // '0' '1' '2' '3' '4' '5' '6' '7'
+  0x00FF, 0x00EF, 0x1200, 0x0A00, 0x2400, 0x00C8, 0x0900, 0x1083, // '8' '9' ':' ';' '<' '=' '>' '?'
+  0x02BB, 0x00F7, 0x128F, 0x0039, 0x120F, 0x00F9, 0x0071, 0x00BD, // '@' 'A' 'B' 'C' 'D' 'E' 'F' 'G'
+  0x00F6, 0x1209, 0x001E, 0x2470, 0x0038, 0x0536, 0x2136, 0x003F, // 'H' 'I' 'J' 'K' 'L' 'M' 'N' 'O'
+  0x00F3, 0x203F, 0x20F3, 0x00ED, 0x1201, 0x003E, 0x0C30, 0x2836, // 'P' 'Q' 'R' 'S' 'T' 'U' 'V' 'W'
+  0x2D00, 0x1500, 0x0C09, 0x0039, 0x2100, 0x000F, 0x0C03, 0x0008, // 'X' 'Y' 'Z' '[' '\' ']' '^' '_'
+  0x0100, 0x1058, 0x2078, 0x00D8, 0x088E, 0x0858, 0x0071, 0x048E, // '`' 'a' 'b' 'c' 'd' 'e' 'f' 'g'
+  0x1070, 0x1000, 0x000E, 0x3600, 0x0030, 0x10D4, 0x1050, 0x00DC, // 'h' 'i' 'j' 'k' 'l' 'm' 'n' 'o'
+  0x0170, 0x0486, 0x0050, 0x2088, 0x0078, 0x001C, 0x2004, 0x2814, // 'p' 'q' 'r' 's' 't' 'u' 'v' 'w'
+  0x28C0, 0x200C, 0x0848, 0x0949, 0x1200, 0x2489, 0x0520, // 'x' 'y' 'z' '{' '|' '}' '~'
+};
 
 static int g_opt_p = OPT_P_DEF;
 static int g_opt_r = OPT_R_DEF;
 static int g_opt_s = OPT_S_DEF;
 static int g_opt_t = 0;
+static char *g_opt_c = NULL;
+static char *g_opt_m = NULL;
 
 static char error_msgs[5][50] = {
   {""},
@@ -83,7 +148,8 @@ typedef struct EightSegment {
   int is_null;
   int is_collapsed;
   int is_out_of_sync;
-  int digit;
+  int digit; // -1 if glyph is not a digit
+  char glyph;
   int fp;
 } s_8segment;
 
@@ -93,10 +159,72 @@ typedef struct SSD {
   int gpio_bitmask;
   s_8segment digits[8];
   float val;
+  int is_numeric; // val is meaningful, otherwise only text is
+  char text[MAX_TEXT];
   int repeat;
   int error; // 1: uninitialized, 2: collapsed, 3: unconfirmed, 4: out-of-sync
+  int warm; // val was restored from a checkpoint, one matching frame confirms it
+  uint32_t last_tick; // tick of the last strobe of the last digit
+  uint32_t period; // strobe period estimate in micros, 0 if unknown
 } s_ssd;
 
+// On-disk checkpoint, see WARM RESTART above. seq is odd while the main
+// loop is writing so a torn record is never restored.
+typedef struct SnapDisplay {
+  int size;
+  int gpio[MAX_DIGITS];
+  float val;
+  int is_numeric;
+  char text[MAX_TEXT];
+  int repeat;
+  int error;
+  uint32_t period;
+} s_snap_display;
+
+typedef struct Snapshot {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t seq;
+  uint32_t tick; // gpioTick() at wall_usec
+  int64_t wall_usec;
+  int num_displays;
+  s_snap_display display[MAX_DISPLAYS];
+} s_snapshot;
+
+// A compiled segment map. gather[] turns the four bytes of a level word
+// into the glyph index (bit k = segment k lit), glyph[] turns that into
+// a character (0: not a known glyph), so decoding is five table loads
+// regardless of the segment count.
+typedef struct SegMap {
+  int kind; // SEG_7, SEG_14 or SEG_16
+  int dp;
+  int lines[MAX_SEGMENTS];
+  unsigned int seg_bitpattern_digit_mask;
+  unsigned int seg_bitpattern_fp_mask;
+  uint16_t gather[4][256];
+  char glyph[]; // 1<<kind entries
+} s_segmap;
+
+// Everything edges() needs, compiled once per (re)load and published
+// through g_config.  The alert thread only ever reads a config; the main
+// loop builds a new one and swaps the pointer.
+typedef struct SSDConfig {
+  int num_segmaps;
+  s_segmap *segmap[MAX_DISPLAYS];
+  int num_displays;
+  s_ssd *display[MAX_DISPLAYS];
+  const s_segmap *display_segmap[MAX_DISPLAYS];
+  int owned[MAX_DISPLAYS]; // display is freed with this config (main thread only)
+  signed char gpio_display[MAX_GPIOS]; // -1: not a digit line
+  signed char gpio_digit[MAX_GPIOS];
+  unsigned int gpio_mask; // all digit lines
+} s_ssd_config;
+
+static s_ssd_config *g_config;  // current, read lock-free by edges()
+static s_ssd_config *g_retired; // previous, freed after a grace period
+static volatile sig_atomic_t g_reload = 0;
+static s_snapshot *g_snapshot;
+
 void usage()
 {
    fprintf
@@ -106,6 +234,8 @@ void usage()
       "   -p value, sets pulses every p micros, %d-%d, TESTING only\n" \
       "   -r value, sets refresh period in deciseconds, %d-%d, default %d\n" \
       "   -s value, sets sampling rate in micros, %d-%d, default %d\n" \
+      "   -c file, reads segment map and displays from file, SIGHUP reloads\n" \
+      "   -m file, checkpoints display state to file and resumes from it\n" \
       "\nEXAMPLE\n" \
       "sudo ./freq_count_1 4 7 -r2 -s2\n" \
       "Monitor gpios 4 and 7.  Refresh every 0.2 seconds.  Sample rate 2 micros.\n" \
@@ -138,7 +268,7 @@ static int initOpts(int argc, char *argv[])
 {
    int i, opt;
 
-   while ((opt = getopt(argc, argv, "p:r:s:")) != -1)
+   while ((opt = getopt(argc, argv, "p:r:s:c:m:")) != -1)
    {
       i = -1;
 
@@ -166,6 +296,14 @@ static int initOpts(int argc, char *argv[])
             else fatal(1, "invalid -s option (%d)", i);
             break;
 
+         case 'c':
+            g_opt_c = optarg;
+            break;
+
+         case 'm':
+            g_opt_m = optarg;
+            break;
+
         default: /* '?' */
            usage();
            exit(-1);
@@ -185,35 +323,34 @@ char* itob(char* buf, int val, int size){
   return buf;
 }
 
-void to_digit(unsigned int bits_0_31, int gpio, s_8segment* seg)
+void to_digit(const s_segmap* map, unsigned int bits_0_31, int gpio, s_8segment* seg)
 {
-  int i;
-  char buf[32];
+  unsigned int idx;
+  char glyph;
 
-//printf("%s\n", itob(buf, bits_0_31, 32), i);
-//printf("%s\n", itob(buf, bits_0_31 & seg_bitpattern_digit_mask, 32), i);
+  idx = bits_0_31 & map->seg_bitpattern_digit_mask;
+  idx = map->gather[0][idx & 0xff] | map->gather[1][(idx >> 8) & 0xff] |
+        map->gather[2][(idx >> 16) & 0xff] | map->gather[3][idx >> 24];
 
-  if (0 == (bits_0_31 & seg_bitpattern_digit_mask)) {
-    seg->is_null = 1;
+  seg->is_null = (idx == 0);
+  seg->is_collapsed = 0;
+  if (seg->is_null) {
     seg->digit = 0;
+    seg->glyph = ' ';
   } else {
-    seg->is_null = 0;
-    seg->is_collapsed = 1;
-    for (i=0; i<10; i++) {
-      if (digit_bitpatterns[i] == (bits_0_31 & seg_bitpattern_digit_mask)) {
-        seg->is_collapsed = 0;
-        seg->digit = i;
-        break;
-      }
-    }
+    glyph = map->glyph[idx];
+    seg->is_collapsed = (glyph == 0);
+    seg->digit = (glyph >= '0' && glyph <= '9') ? glyph - '0' : -1;
+    seg->glyph = glyph;
   }
-  seg->fp = (bits_0_31 & seg_bitpattern_fp_mask) != 0;
+  seg->fp = (bits_0_31 & map->seg_bitpattern_fp_mask) != 0;
 }
 
 void eval_ssd(s_ssd* ssd)
 {
-  int i, j, digit, digits, factor;
+  int i, j, n, digit, digits, factor, is_numeric;
   float next_val;
+  char next_text[MAX_TEXT];
 
   //if (ssd->reset == 1) {
   //  //return 1;
@@ -231,6 +368,8 @@ void eval_ssd(s_ssd* ssd)
   //  end
 
   digits = 0;
+  n = 0;
+  is_numeric = 1;
   for (i=0; i < ssd->size; i++) {
     if (ssd->digits[i].is_out_of_sync) {
       if (ssd->error == 1) {
@@ -252,7 +391,14 @@ void eval_ssd(s_ssd* ssd)
       }
       return;
     }
+    next_text[n++] = ssd->digits[i].glyph;
+    if (ssd->digits[i].fp) next_text[n++] = '.';
+
     digit = ssd->digits[i].digit;
+    if (digit < 0) {
+      is_numeric = 0;
+      continue;
+    }
 //printf("%d\n", ssd->gpio[i]);
 //printf("%d\n", digit);
     for (j=0; j < (ssd->size-i-1); j++) {
@@ -260,7 +406,8 @@ void eval_ssd(s_ssd* ssd)
     }
     digits += digit;
   }
-  next_val = (float) digits;
+  next_text[n] = '\0';
+  next_val = is_numeric ? (float) digits : 0;
   for (i=0; i < ssd->size; i++) {
     if (ssd->digits[i].fp) {
       for (j=i; j < (ssd->size-1); j++) {
@@ -274,102 +421,558 @@ void eval_ssd(s_ssd* ssd)
     ssd->error = 3;
   }
 
-  if (ssd->val == next_val) {
+  // Frames are compared as text: for numeric displays that is the value
+  // plus its decimal point, for alphanumeric ones the only reading there is.
+  if (strcmp(ssd->text, next_text) == 0) {
     if (ssd->repeat < 50)
       ssd->repeat++;
 
-    if (ssd->error == 3 && ssd->repeat > 5) { //TODO: This TH should be configurable
+    if (ssd->error == 3 && (ssd->repeat > 5 || ssd->warm)) { //TODO: This TH should be configurable
       ssd->error = 0;
     }
   } else {
     ssd->repeat = 0;
     ssd->error = 3;
     ssd->val = next_val;
+    ssd->is_numeric = is_numeric;
+    memcpy(ssd->text, next_text, n + 1);
   }
+  ssd->warm = 0;
 
   return;
 }
 
-void edges(int gpio, int level, uint32_t tick, void *_ssd)
+void edges(int gpio, int level, uint32_t tick, void *userdata)
 {
-   int i;
-   char *buf;
+   int i, d;
    unsigned int bits_0_31, gpio_other_triggers;
-   s_ssd *ssd = (s_ssd*)_ssd;
+   s_ssd *ssd;
+   const s_segmap *map;
+   const s_ssd_config *cfg;
 
    // TODO: Make this configurable to support both Cathode/Anode LEDs
    /* only record high to low edges */
    if (level == 1) return;
 
-   //if (g_reset_counts)
-   //{
-   //   g_reset_counts = 0;
-   //   for (g=0; g<MAX_GPIOS; g++) g_pulse_count[g] = 0;
-   //}
+   // Load the config once so the whole edge is decoded against one
+   // generation even if the main loop swaps in a new one meanwhile.
+   cfg = __atomic_load_n(&g_config, __ATOMIC_ACQUIRE);
 
    // Experimental
    // 1000 (1ms) => 1 digit shifted
    // gpioSleep(PI_TIME_RELATIVE, 0, 1);
 
+   d = cfg->gpio_display[gpio];
+   if (d < 0) return; // line dropped by a reload, callback not yet cancelled
+
+   ssd = cfg->display[d];
+   map = cfg->display_segmap[d];
+   i = cfg->gpio_digit[gpio];
+
    bits_0_31 = gpioRead_Bits_0_31();
-   for (i=0; i<ssd->size; i++) {
-     if (ssd->gpio[i] == gpio) {
-//printf("[%d, %d]\n", i, gpio);
-
-       // should be LOW
-       //seg->is_out_of_sync = ((1<<gpio) & bits_0_31) != 0; // TODO: make this configurable
-       gpio_other_triggers = ssd->gpio_bitmask & ~(1<<gpio);
-       //printf(" %d \n", gpio_other_triggers);
-       // Other gpios should be HIGH
-       ssd->digits[i].is_out_of_sync = (gpio_other_triggers & ~bits_0_31) != 0;
-       to_digit(bits_0_31, gpio, &ssd->digits[i]);
-
-       break;
-     }
-   }
 
-   if (gpio == ssd->gpio[ssd->size-1]) {
+   // should be LOW
+   //seg->is_out_of_sync = ((1<<gpio) & bits_0_31) != 0; // TODO: make this configurable
+   gpio_other_triggers = ssd->gpio_bitmask & ~(1<<gpio);
+   // Other gpios should be HIGH
+   ssd->digits[i].is_out_of_sync = (gpio_other_triggers & ~bits_0_31) != 0;
+   to_digit(map, bits_0_31, gpio, &ssd->digits[i]);
+
+   if (i == ssd->size-1) {
+     if (ssd->last_tick != 0) {
+       if (ssd->period == 0) ssd->period = tick - ssd->last_tick;
+       else ssd->period += ((int)(tick - ssd->last_tick) - (int)ssd->period) / 8;
+     }
+     ssd->last_tick = tick;
      eval_ssd(ssd);
    }
-   //printf("[%d, %d, %d]\n", gpio, seg->digit, seg->fp);
-   //buf = itob(bits_0_31, 32);
-   //printf(" %s \n", buf);
 }
 
-// Note that gpioSetAlertFuncEx internally do polling around 1kHz that means
-// it may have ~ms delays (which may cause trouble in our case)
-// TODO: Rather than using gpioSetAlertFuncEx, build it's own busy loop polling
-void ssd_setup(s_ssd* ssd, int size, int* gpio)
+s_ssd* ssd_new(int size, int* gpio)
 {
   int i;
-  int mode = PI_INPUT;
+  s_ssd *ssd;
+
+  ssd = calloc(1, sizeof(s_ssd));
+  if (ssd == NULL) return NULL;
 
-  ssd->gpio_bitmask = 0;
   ssd->size = size;
   for (i=0; i<size; i++) {
     ssd->gpio[i] = gpio[i];
     ssd->gpio_bitmask |= 1<<gpio[i];
-    gpioSetAlertFuncEx(gpio[i], edges, ssd);
-    gpioSetMode(gpio[i], mode);
-    ssd->error = 1;
-    ssd->repeat = 0;
   }
+  ssd->error = 1;
+  ssd->repeat = 0;
+
+  return ssd;
+}
+
+void config_free(s_ssd_config* cfg)
+{
+  int i;
+
+  if (cfg == NULL) return;
+
+  for (i=0; i<cfg->num_displays; i++) {
+    if (cfg->owned[i]) free(cfg->display[i]);
+  }
+  for (i=0; i<cfg->num_segmaps; i++) {
+    free(cfg->segmap[i]);
+  }
+  free(cfg);
+}
+
+int config_add_display(s_ssd_config* cfg, const s_segmap* map, int size, int* gpio)
+{
+  if (cfg->num_displays >= MAX_DISPLAYS) return -1;
+
+  cfg->display[cfg->num_displays] = ssd_new(size, gpio);
+  if (cfg->display[cfg->num_displays] == NULL) return -1;
+
+  cfg->display_segmap[cfg->num_displays] = map;
+  cfg->owned[cfg->num_displays] = 1;
+  cfg->num_displays++;
+
+  return 0;
+}
+
+// Moves segment a to a1+a2 and d to d1+d2.
+static unsigned int font14_to_16(unsigned int v)
+{
+  return ((v & 0x01) ? 0x03 : 0) | ((v & 0x06) << 1) | ((v & 0x08) ? 0x30 : 0) |
+         ((v & 0x3FF0) << 2);
+}
+
+// Digits take precedence over letters and letters over punctuation where
+// two characters share a glyph (e.g. '1' and '!', 'C' and '[').
+static int glyph_rank(int c)
+{
+  if (c >= '0' && c <= '9') return 0;
+  if (c >= 'A' && c <= 'Z') return 1;
+  return 2;
+}
+
+// gpio: the segments line as written, DP first. Returns NULL on error.
+s_segmap* segmap_new(int kind, const int* gpio)
+{
+  int i, j, k, rank;
+  unsigned int idx;
+  s_segmap *map;
+  char str_seg_pattern[8+1];
+  char str_digit_bitpattern[32+1];
+
+  map = calloc(1, sizeof(s_segmap) + (1<<kind));
+  if (map == NULL) return NULL;
+
+  map->kind = kind;
+  map->dp = gpio[0];
+  map->seg_bitpattern_fp_mask = 1<<gpio[0];
+  for (k=0; k<kind; k++) {
+    map->lines[k] = gpio[k+1];
+    if (map->seg_bitpattern_digit_mask & (1<<gpio[k+1])) {
+      fprintf(stderr, "gpio %d used more than once\n", gpio[k+1]);
+      free(map);
+      return NULL;
+    }
+    map->seg_bitpattern_digit_mask |= 1<<gpio[k+1];
+  }
+  if (map->seg_bitpattern_digit_mask & map->seg_bitpattern_fp_mask) {
+    fprintf(stderr, "gpio %d used more than once\n", gpio[0]);
+    free(map);
+    return NULL;
+  }
+
+  for (i=0; i<4; i++) {
+    for (j=0; j<256; j++) {
+      for (k=0; k<kind; k++) {
+        if ((map->lines[k] >> 3) == i && (j & (1<<(map->lines[k] & 7))))
+          map->gather[i][j] |= 1<<k;
+      }
+    }
+  }
+
+  if (kind == SEG_7) {
+    // seg_patterns are a b c d e f g DP, bit 0 is DP, segments line is DP g f e d c b a
+    for (i=0; i<10; i++) {
+      map->glyph[seg_patterns[i] >> 1] = '0' + i;
+    }
+
+    fprintf(stderr, "seg_bitpattern_digit_mask: %s (gpio: 0-27)\n", itob(str_digit_bitpattern, map->seg_bitpattern_digit_mask, 27));
+    fprintf(stderr, "seg_bitpattern_fp_mask:    %s (gpio: 0-27)\n", itob(str_digit_bitpattern, map->seg_bitpattern_fp_mask, 27));
+    for (i=0; i<10; i++) // 0 1 2 3 4 5 6 7 8 9
+    {
+      idx = 0;
+      for (k=0; k<kind; k++) {
+        if ((seg_patterns[i] >> 1) & (1<<k)) idx |= 1<<map->lines[k];
+      }
+
+      fprintf(stderr, "[%d]", i);
+      fprintf(stderr, " %s (abcdefg.) =>", itob(str_seg_pattern, seg_patterns[i], 8));
+      fprintf(stderr, " %s (gpio: 0-27)\n", itob(str_digit_bitpattern, idx, 27));
+    }
+  } else {
+    for (rank=0; rank<3; rank++) {
+      for (i=0; i<95; i++) {
+        if (glyph_rank(' ' + i) != rank) continue;
+
+        idx = (kind == SEG_16) ? font14_to_16(font14[i]) : font14[i];
+        if (idx != 0 && map->glyph[idx] == 0) map->glyph[idx] = ' ' + i;
+      }
+    }
+
+    fprintf(stderr, "%d-segment map, segment mask %s (gpio: 0-27)\n", kind,
+            itob(str_digit_bitpattern, map->seg_bitpattern_digit_mask, 27));
+  }
+
+  return map;
+}
+
+static int segmap_equal(const s_segmap* a, const s_segmap* b)
+{
+  return a->kind == b->kind && a->dp == b->dp &&
+         memcmp(a->lines, b->lines, a->kind * sizeof(int)) == 0;
+}
+
+// Builds the gpio to display/digit lookup edges() decodes with. Returns
+// -1 if a digit line is used twice or is also a segment line.
+int config_compile(s_ssd_config* cfg)
+{
+  int i, j, g;
+  unsigned int seg_mask = 0;
+
+  for (i=0; i<cfg->num_segmaps; i++) {
+    seg_mask |= cfg->segmap[i]->seg_bitpattern_digit_mask | cfg->segmap[i]->seg_bitpattern_fp_mask;
+  }
+
+  memset(cfg->gpio_display, -1, sizeof(cfg->gpio_display));
+  memset(cfg->gpio_digit, -1, sizeof(cfg->gpio_digit));
+  cfg->gpio_mask = 0;
+  for (i=0; i<cfg->num_displays; i++) {
+    for (j=0; j<cfg->display[i]->size; j++) {
+      g = cfg->display[i]->gpio[j];
+
+      if ((cfg->gpio_mask & (1<<g)) || (seg_mask & (1<<g))) {
+        fprintf(stderr, "gpio %d used more than once\n", g);
+        return -1;
+      }
+      cfg->gpio_display[g] = i;
+      cfg->gpio_digit[g] = j;
+      cfg->gpio_mask |= 1<<g;
+    }
+  }
+
+  return 0;
+}
+
+static s_segmap* config_add_segmap(s_ssd_config* cfg, int kind, const int* gpio)
+{
+  s_segmap *map;
+
+  if (cfg->num_segmaps >= MAX_DISPLAYS) return NULL;
+
+  map = segmap_new(kind, gpio);
+  if (map != NULL) cfg->segmap[cfg->num_segmaps++] = map;
+
+  return map;
+}
+
+static int parse_gpios(char *tok, int* gpio, int max)
+{
+  int n = 0;
+  char *end;
+  long g;
+
+  for (; tok != NULL; tok = strtok(NULL, " \t\r\n")) {
+    g = strtol(tok, &end, 10);
+    if (*end != '\0' || g < 0 || g >= MAX_GPIOS || n >= max) return -1;
+    gpio[n++] = g;
+  }
+  return n;
+}
+
+// Reads the config file (see CONFIGURATION above), or the built-in
+// defaults when path is NULL. Returns NULL and logs on error.
+s_ssd_config* config_load(const char *path)
+{
+  FILE *f;
+  char line[256], *tok;
+  int gpio[MAX_SEGMENTS+1];
+  int n, kind, lineno = 0;
+  s_ssd_config *cfg;
+  s_segmap *map = NULL;
+
+  int v_gpio[] = {21, 20, 16};
+  int a_gpio[] = {25, 24, 23};
+
+  cfg = calloc(1, sizeof(s_ssd_config));
+  if (cfg == NULL) return NULL;
+
+  if (path == NULL) {
+    map = config_add_segmap(cfg, SEG_7, g_segments);
+    if (map == NULL) {
+      config_free(cfg);
+      return NULL;
+    }
+    config_add_display(cfg, map, 3, v_gpio);
+    config_add_display(cfg, map, 3, a_gpio);
+  } else {
+    f = fopen(path, "r");
+    if (f == NULL) {
+      fprintf(stderr, "%s: cannot open\n", path);
+      free(cfg);
+      return NULL;
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+      lineno++;
+      if ((tok = strchr(line, '#')) != NULL) *tok = '\0';
+      if ((tok = strtok(line, " \t\r\n")) == NULL) continue;
+
+      if (strncmp(tok, "segments", 8) == 0) {
+        if (strcmp(tok + 8, "") == 0) kind = SEG_7;
+        else if (strcmp(tok + 8, "14") == 0) kind = SEG_14;
+        else if (strcmp(tok + 8, "16") == 0) kind = SEG_16;
+        else goto bad_line;
+
+        n = parse_gpios(strtok(NULL, " \t\r\n"), gpio, kind + 1);
+        if (n != kind + 1) goto bad_line;
+        map = config_add_segmap(cfg, kind, gpio);
+        if (map == NULL) goto bad_line;
+      } else if (strcmp(tok, "display") == 0) {
+        if (map == NULL) map = config_add_segmap(cfg, SEG_7, g_segments);
+        n = parse_gpios(strtok(NULL, " \t\r\n"), gpio, MAX_DIGITS);
+        if (n < 1 || map == NULL || config_add_display(cfg, map, n, gpio) < 0) goto bad_line;
+      } else {
+        goto bad_line;
+      }
+    }
+    fclose(f);
+  }
+
+  if (config_compile(cfg) < 0) {
+    config_free(cfg);
+    return NULL;
+  }
+
+  return cfg;
+
+bad_line:
+  fprintf(stderr, "%s:%d: invalid line\n", path, lineno);
+  fclose(f);
+  config_free(cfg);
+  return NULL;
+}
+
+// Hands over the state of every display in cur that is unchanged in
+// next (same digit lines, same segment map), so its value and repeat
+// counter survive the reload.
+void config_adopt(s_ssd_config* next, s_ssd_config* cur)
+{
+  int i, j;
+  s_ssd *a, *b;
+
+  for (i=0; i<next->num_displays; i++) {
+    a = next->display[i];
+    for (j=0; j<cur->num_displays; j++) {
+      b = cur->display[j];
+      if (cur->owned[j] && a->size == b->size &&
+          segmap_equal(next->display_segmap[i], cur->display_segmap[j]) &&
+          memcmp(a->gpio, b->gpio, a->size * sizeof(int)) == 0) {
+        free(a);
+        next->display[i] = b;
+        cur->owned[j] = 0;
+        break;
+      }
+    }
+  }
+}
+
+// Note that gpioSetAlertFuncEx internally do polling around 1kHz that means
+// it may have ~ms delays (which may cause trouble in our case)
+// TODO: Rather than using gpioSetAlertFuncEx, build it's own busy loop polling
+void config_apply(s_ssd_config* next, s_ssd_config* cur)
+{
+  int g;
+  unsigned int added, removed;
+
+  added   = next->gpio_mask & ~(cur ? cur->gpio_mask : 0);
+  removed = (cur ? cur->gpio_mask : 0) & ~next->gpio_mask;
+
+  for (g=0; g<MAX_GPIOS; g++) {
+    if (added & (1<<g)) {
+      gpioSetMode(g, PI_INPUT);
+      gpioSetAlertFuncEx(g, edges, NULL);
+    }
+    if (removed & (1<<g)) {
+      gpioSetAlertFunc(g, NULL);
+    }
+  }
+}
+
+// Runs on the main thread only. The swap is a single pointer store; the
+// old generation stays readable until the next refresh tick, by which
+// time any edges() call that loaded it has long returned (callbacks run
+// for microseconds, the refresh period is at least 100ms).
+void config_reload(void)
+{
+  s_ssd_config *next, *cur = g_config;
+
+  next = config_load(g_opt_c);
+  if (next == NULL) {
+    fprintf(stderr, "reload failed, keeping current configuration\n");
+    return;
+  }
+
+  config_adopt(next, cur);
+
+  __atomic_store_n(&g_config, next, __ATOMIC_RELEASE);
+  config_apply(next, cur);
+
+  config_free(g_retired);
+  g_retired = cur;
+}
+
+// Maps the checkpoint file, creating it if needed. Returns NULL (and
+// runs without checkpoints) on error.
+s_snapshot* snapshot_open(const char *path)
+{
+  int fd;
+  void *p;
+
+  fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "%s: cannot open\n", path);
+    return NULL;
+  }
+
+  if (ftruncate(fd, sizeof(s_snapshot)) < 0) {
+    fprintf(stderr, "%s: cannot resize\n", path);
+    close(fd);
+    return NULL;
+  }
+
+  p = mmap(NULL, sizeof(s_snapshot), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (p == MAP_FAILED) {
+    fprintf(stderr, "%s: cannot map\n", path);
+    return NULL;
+  }
+
+  return p;
+}
+
+static int64_t wall_usec(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+// Restores every display of cfg that appears in the checkpoint with the
+// same digit lines. Must run before config_apply() starts the callbacks.
+void snapshot_restore(const s_snapshot* snap, s_ssd_config* cfg)
+{
+  int i, j;
+  int64_t age, drift;
+  s_ssd *ssd;
+  const s_snap_display *sd;
+
+  if (snap->magic != SNAP_MAGIC || snap->version != SNAP_VERSION || (snap->seq & 1)) return;
+
+  age = wall_usec() - snap->wall_usec;
+  if (age < 0 || age > SNAP_MAX_AGE * 1000000LL) {
+    fprintf(stderr, "checkpoint too old (%lld s), starting cold\n", (long long)(age / 1000000));
+    return;
+  }
+
+  // The system timer keeps running across a restart but not a reboot.
+  drift = (int64_t)(int32_t)(gpioTick() - (snap->tick + (uint32_t)age));
+  if (drift < -1000000 || drift > 1000000) {
+    fprintf(stderr, "tick-to-wall mapping changed, starting cold\n");
+    return;
+  }
+
+  for (i=0; i<cfg->num_displays; i++) {
+    ssd = cfg->display[i];
+    for (j=0; j<snap->num_displays && j<MAX_DISPLAYS; j++) {
+      sd = &snap->display[j];
+      if (sd->size == ssd->size && memcmp(sd->gpio, ssd->gpio, ssd->size * sizeof(int)) == 0) {
+        ssd->period = sd->period;
+        if (sd->error == 0) {
+          ssd->val = sd->val;
+          ssd->is_numeric = sd->is_numeric;
+          memcpy(ssd->text, sd->text, sizeof(ssd->text));
+          ssd->text[MAX_TEXT-1] = '\0';
+          ssd->repeat = sd->repeat;
+          ssd->error = 3;
+          ssd->warm = 1;
+        }
+        fprintf(stderr, "display %d resumed (error %d)\n", i, sd->error);
+        break;
+      }
+    }
+  }
+}
+
+void snapshot_save(s_snapshot* snap, const s_ssd_config* cfg)
+{
+  int i;
+  s_ssd *ssd;
+  s_snap_display *sd;
+
+  snap->seq |= 1;
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  snap->magic = SNAP_MAGIC;
+  snap->version = SNAP_VERSION;
+  snap->tick = gpioTick();
+  snap->wall_usec = wall_usec();
+  snap->num_displays = cfg->num_displays;
+  for (i=0; i<cfg->num_displays; i++) {
+    ssd = cfg->display[i];
+    sd = &snap->display[i];
+    sd->size = ssd->size;
+    memcpy(sd->gpio, ssd->gpio, sizeof(sd->gpio));
+    sd->val = ssd->val;
+    sd->is_numeric = ssd->is_numeric;
+    memcpy(sd->text, ssd->text, sizeof(sd->text));
+    sd->repeat = ssd->repeat;
+    sd->error = ssd->error;
+    sd->period = ssd->period;
+  }
+
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  snap->seq++;
+
+  msync(snap, sizeof(s_snapshot), MS_ASYNC);
+}
+
+void print_json_text(const char *text)
+{
+  putchar('"');
+  for (; *text; text++) {
+    if (*text == '"' || *text == '\\') putchar('\\');
+    putchar(*text);
+  }
+  putchar('"');
+}
+
+void sighup(int signum)
+{
+   g_reload = 1;
 }
 
 int main(int argc, char *argv[])
 {
-   int i, j, rest, g, wave_id, mode;
+   int i, rest, g, wave_id, mode;
    gpioPulse_t pulse[2];
    int count[MAX_GPIOS];
-   char str_seg_pattern[8];
-   char str_digit_bitpattern[32];
    struct timeval my_time;
    double unix_ts;
 
-   s_ssd display[2];
-
-   int v_gpio[] = {21, 20, 16};
-   int a_gpio[] = {25, 24, 23};
+   s_ssd_config *cfg;
 
    int error;
    float val;
@@ -404,31 +1007,8 @@ int main(int argc, char *argv[])
    seg_patterns[8] = strtol("11111110", NULL, 2);
    seg_patterns[9] = strtol("11110110", NULL, 2);
 
-   // TODO: Build segments config from argv
-   seg_bitpattern_digit_mask = 0;
-   for (j=7; j>0; j--) // a b c d e f g
-   {
-     seg_bitpattern_digit_mask = seg_bitpattern_digit_mask | (1<<(g_segments[j]));
-   }
-   fprintf(stderr, "seg_bitpattern_digit_mask: %s (gpio: 0-27)\n", itob(str_digit_bitpattern, seg_bitpattern_digit_mask, 27));
-
-   seg_bitpattern_fp_mask = 1<<(g_segments[0]);
-   fprintf(stderr, "seg_bitpattern_fp_mask:    %s (gpio: 0-27)\n", itob(str_digit_bitpattern, seg_bitpattern_fp_mask, 27));
-   for (i=0; i<10; i++) // 0 1 2 3 4 5 6 7 8 9
-   {
-     digit_bitpatterns[i] = 0;
-     for (j=7; j>=0; j--) // a b c d e f g DP
-     {
-       if ((seg_patterns[i] & (1<<j)) != 0)
-       {
-          digit_bitpatterns[i] = digit_bitpatterns[i] | (1<<(g_segments[j]));
-       }
-     }
-
-     fprintf(stderr, "[%d]", i);
-     fprintf(stderr, " %s (abcdefg.) =>", itob(str_seg_pattern, seg_patterns[i], 8));
-     fprintf(stderr, " %s (gpio: 0-27)\n", itob(str_digit_bitpattern, digit_bitpatterns[i], 27));
-   }
+   g_config = config_load(g_opt_c);
+   if (g_config == NULL) fatal(0, "invalid configuration");
 
    //if (!g_num_gpios) fatal(1, "At least one gpio must be specified");
 
@@ -441,6 +1021,13 @@ int main(int argc, char *argv[])
 
    if (gpioInitialise()<0) return 1;
 
+   gpioSetSignalFunc(SIGHUP, sighup);
+
+   if (g_opt_m != NULL) {
+     g_snapshot = snapshot_open(g_opt_m);
+     if (g_snapshot != NULL) snapshot_restore(g_snapshot, g_config);
+   }
+
    //gpioWaveClear();
 
    //pulse[0].gpioOn  = g_mask;
@@ -458,8 +1045,7 @@ int main(int argc, char *argv[])
    /* monitor g_digits level changes */
 
    //for (i=0; i<g_num_gpios; i++) gpioSetAlertFunc(g_digits[i], edges);
-   ssd_setup(&display[0], 3, v_gpio);
-   ssd_setup(&display[1], 3, a_gpio);
+   config_apply(g_config, NULL);
 
 
    //mode = PI_INPUT;
@@ -478,29 +1064,45 @@ int main(int argc, char *argv[])
 
       //g_reset_counts = 1;
 
+      config_free(g_retired);
+      g_retired = NULL;
+
+      if (g_reload) {
+        g_reload = 0;
+        config_reload();
+      }
+      cfg = g_config;
+
       gettimeofday(&my_time, NULL);
       unix_ts = my_time.tv_sec + my_time.tv_usec/1000000.0;
 
       printf("{\"time\":%f,", unix_ts);
 
       printf("{\"displays\":[");
-      for (i=0; i<2; i++)
+      for (i=0; i<cfg->num_displays; i++)
       {
+         s_ssd *display = cfg->display[i];
+
          printf("{");
          printf("\"idx\":%d,", i);
-         if (display[i].error == 0) {
-           printf("\"val\":%f", display[i].val);
+         if (display->error == 0) {
+           if (display->is_numeric) printf("\"val\":%f,", display->val);
+           else printf("\"val\":null,");
+           printf("\"text\":");
+           print_json_text(display->text);
          } else {
-           printf("\"val\":null,\"error\":%d,\"error_msg\":\"%s\"", display[i].error, error_msgs[display[i].error]);
+           printf("\"val\":null,\"error\":%d,\"error_msg\":\"%s\"", display->error, error_msgs[display->error]);
          }
          printf("}");
 
-         if (i!=1) printf(",");
+         if (i!=cfg->num_displays-1) printf(",");
       }
       printf("]}");
 
       printf("}\n");
 
+      if (g_snapshot != NULL) snapshot_save(g_snapshot, cfg);
+
       gpioDelay(g_opt_r * 100000);
    }
 